@@ -0,0 +1,308 @@
+#include "Bvh.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+// Centroid bins per axis tried for every split
+static const int SAH_BINS = 16;
+// Traversal stack entries; a tree whose leaves are at most STACK_SIZE - 1 levels below the root never needs more,
+// since each level above the current node leaves at most one sibling on the stack
+static const int STACK_SIZE = 64;
+
+void RayPacket::set(int lane, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+	originX[lane] = origin.x;
+	originY[lane] = origin.y;
+	originZ[lane] = origin.z;
+	directionX[lane] = direction.x;
+	directionY[lane] = direction.y;
+	directionZ[lane] = direction.z;
+	tMax[lane] = maxDistance;
+	triangle[lane] = -1;
+	u[lane] = v[lane] = 0.0f;
+}
+
+// a zero direction would turn into NaN slabs, so an inactive lane still gets a valid ray
+void RayPacket::disable(int lane) {
+	set(lane, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+}
+
+Bvh::Bvh() {
+	maxLeafSize = 8;
+}
+
+static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	glm::vec3 extent = boundsMax - boundsMin;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void Bvh::build(const std::vector<BvhTriangle>& input) {
+	int count = (int)input.size();
+	centroids.resize(count);
+	boundsMins.resize(count);
+	boundsMaxs.resize(count);
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++) {
+		const BvhTriangle& t = input[i];
+		glm::vec3 v1 = t.v0 + t.edge1, v2 = t.v0 + t.edge2;
+		boundsMins[i] = glm::min(t.v0, glm::min(v1, v2));
+		boundsMaxs[i] = glm::max(t.v0, glm::max(v1, v2));
+		centroids[i] = (boundsMins[i] + boundsMaxs[i]) * 0.5f;
+		order[i] = i;
+	}
+
+	nodes.clear();
+	nodes.reserve(std::max(1, 2 * count));
+	nodes.push_back(BvhNode());
+	subdivide(0, 0, count, 0, order);
+
+	triangles.resize(count);
+	triangleIds = order;
+	for (int i = 0; i < count; i++) {
+		triangles[i] = input[order[i]];
+	}
+	centroids.clear();
+	boundsMins.clear();
+	boundsMaxs.clear();
+}
+
+/* Split [first, first + count) of order at the cheapest centroid bin boundary of any axis, or make a leaf
+   when no split is cheaper than testing every triangle or the node is as deep as traversal can go */
+void Bvh::subdivide(int node, int first, int count, int depth, std::vector<int>& order) {
+	glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY), centroidMin(INFINITY), centroidMax(-INFINITY);
+	for (int i = first; i < first + count; i++) {
+		int t = order[i];
+		boundsMin = glm::min(boundsMin, boundsMins[t]);
+		boundsMax = glm::max(boundsMax, boundsMaxs[t]);
+		centroidMin = glm::min(centroidMin, centroids[t]);
+		centroidMax = glm::max(centroidMax, centroids[t]);
+	}
+	nodes[node].boundsMin = boundsMin;
+	nodes[node].boundsMax = boundsMax;
+	nodes[node].first = first;
+	nodes[node].count = count;
+	if (count <= 2 || depth >= STACK_SIZE - 1) {
+		return;
+	}
+
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = (float)count * surfaceArea(boundsMin, boundsMax);
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		float scale = SAH_BINS / extent;
+		int binCounts[SAH_BINS] = {};
+		glm::vec3 binMins[SAH_BINS], binMaxs[SAH_BINS];
+		std::fill(binMins, binMins + SAH_BINS, glm::vec3(INFINITY));
+		std::fill(binMaxs, binMaxs + SAH_BINS, glm::vec3(-INFINITY));
+		for (int i = first; i < first + count; i++) {
+			int t = order[i];
+			int bin = std::min(SAH_BINS - 1, (int)((centroids[t][axis] - centroidMin[axis]) * scale));
+			binCounts[bin]++;
+			binMins[bin] = glm::min(binMins[bin], boundsMins[t]);
+			binMaxs[bin] = glm::max(binMaxs[bin], boundsMaxs[t]);
+		}
+		// sweep from the right to know the cost of every right side, then from the left
+		float rightAreas[SAH_BINS];
+		int rightCounts[SAH_BINS];
+		glm::vec3 sweepMin(INFINITY), sweepMax(-INFINITY);
+		int sweepCount = 0;
+		for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			rightAreas[bin] = sweepCount ? surfaceArea(sweepMin, sweepMax) : 0.0f;
+			rightCounts[bin] = sweepCount;
+		}
+		sweepMin = glm::vec3(INFINITY);
+		sweepMax = glm::vec3(-INFINITY);
+		sweepCount = 0;
+		for (int bin = 0; bin < SAH_BINS - 1; bin++) {
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			if (sweepCount == 0 || rightCounts[bin + 1] == 0) {
+				continue;
+			}
+			float cost = sweepCount * surfaceArea(sweepMin, sweepMax) + rightCounts[bin + 1] * rightAreas[bin + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = bin + 1;
+			}
+		}
+	}
+	if (bestAxis < 0) {
+		// large leaves only remain when every centroid coincides
+		return;
+	}
+	if (count <= maxLeafSize && bestCost >= (float)count * surfaceArea(boundsMin, boundsMax)) {
+		return;
+	}
+
+	float scale = SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	int* middle = std::partition(order.data() + first, order.data() + first + count, [&](int t) {
+		return std::min(SAH_BINS - 1, (int)((centroids[t][bestAxis] - centroidMin[bestAxis]) * scale)) < bestSplit;
+	});
+	int leftCount = (int)(middle - (order.data() + first));
+	int left = (int)nodes.size();
+	nodes.push_back(BvhNode());
+	nodes.push_back(BvhNode());
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	subdivide(left, first, leftCount, depth + 1, order);
+	subdivide(left + 1, first + leftCount, count - leftCount, depth + 1, order);
+}
+
+namespace {
+
+// Packet data loaded into registers once per traversal
+struct PacketLanes {
+	__m128 originX, originY, originZ;
+	__m128 directionX, directionY, directionZ;
+	__m128 inverseX, inverseY, inverseZ;
+	__m128 tMax;
+	__m128i triangle;
+	__m128 u, v;
+
+	PacketLanes(const RayPacket& packet) {
+		__m128 one = _mm_set1_ps(1.0f);
+		originX = _mm_load_ps(packet.originX);
+		originY = _mm_load_ps(packet.originY);
+		originZ = _mm_load_ps(packet.originZ);
+		directionX = _mm_load_ps(packet.directionX);
+		directionY = _mm_load_ps(packet.directionY);
+		directionZ = _mm_load_ps(packet.directionZ);
+		inverseX = _mm_div_ps(one, directionX);
+		inverseY = _mm_div_ps(one, directionY);
+		inverseZ = _mm_div_ps(one, directionZ);
+		tMax = _mm_load_ps(packet.tMax);
+		triangle = _mm_load_si128((const __m128i*)packet.triangle);
+		u = _mm_load_ps(packet.u);
+		v = _mm_load_ps(packet.v);
+	}
+};
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* Slab test of the four rays against a node's box; nearest receives the entry distances */
+inline __m128 hitBox(const BvhNode& node, const PacketLanes& p, __m128& nearest) {
+	__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), p.originX), p.inverseX);
+	__m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), p.originX), p.inverseX);
+	__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), p.originY), p.inverseY);
+	__m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), p.originY), p.inverseY);
+	__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), p.originZ), p.inverseZ);
+	__m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), p.originZ), p.inverseZ);
+	__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_max_ps(_mm_min_ps(z1, z2), _mm_setzero_ps()));
+	__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_min_ps(_mm_max_ps(z1, z2), p.tMax));
+	nearest = enter;
+	return _mm_cmple_ps(enter, exit);
+}
+
+/* Moller-Trumbore for one triangle and four rays, both faces; returns the lanes with a closer hit */
+inline __m128 hitTriangle(const BvhTriangle& t, const PacketLanes& p, __m128& distance, __m128& u, __m128& v) {
+	__m128 e1x = _mm_set1_ps(t.edge1.x), e1y = _mm_set1_ps(t.edge1.y), e1z = _mm_set1_ps(t.edge1.z);
+	__m128 e2x = _mm_set1_ps(t.edge2.x), e2y = _mm_set1_ps(t.edge2.y), e2z = _mm_set1_ps(t.edge2.z);
+	__m128 px = _mm_sub_ps(_mm_mul_ps(p.directionY, e2z), _mm_mul_ps(p.directionZ, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(p.directionZ, e2x), _mm_mul_ps(p.directionX, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(p.directionX, e2y), _mm_mul_ps(p.directionY, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	__m128 tx = _mm_sub_ps(p.originX, _mm_set1_ps(t.v0.x));
+	__m128 ty = _mm_sub_ps(p.originY, _mm_set1_ps(t.v0.y));
+	__m128 tz = _mm_sub_ps(p.originZ, _mm_set1_ps(t.v0.z));
+	u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDet);
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p.directionX, qx), _mm_mul_ps(p.directionY, qy)), _mm_mul_ps(p.directionZ, qz)), inverseDet);
+	distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 hit = _mm_and_ps(_mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f)), _mm_cmpge_ps(u, zero));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(distance, zero));
+	return _mm_and_ps(hit, _mm_cmplt_ps(distance, p.tMax));
+}
+
+/* Depth-first traversal visiting the nearer child first; anyHit stops a lane at its first hit */
+template <bool anyHit>
+int traverse(const Bvh& bvh, RayPacket& packet) {
+	if (bvh.nodes.empty() || bvh.triangles.empty()) {
+		return 0;
+	}
+	PacketLanes p(packet);
+	int active = _mm_movemask_ps(_mm_cmpgt_ps(p.tMax, _mm_setzero_ps()));
+	int blocked = 0;
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	__m128 nearest;
+	if (!active || !_mm_movemask_ps(hitBox(bvh.nodes[0], p, nearest))) {
+		return 0;
+	}
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BvhNode& node = bvh.nodes[stack[--stackSize]];
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				__m128 distance, u, v;
+				__m128 hit = hitTriangle(bvh.triangles[i], p, distance, u, v);
+				int hitMask = _mm_movemask_ps(hit);
+				if (!hitMask) {
+					continue;
+				}
+				p.tMax = select(hit, anyHit ? _mm_set1_ps(-1.0f) : distance, p.tMax);
+				p.triangle = _mm_castps_si128(select(hit, _mm_castsi128_ps(_mm_set1_epi32(bvh.triangleIds[i])), _mm_castsi128_ps(p.triangle)));
+				p.u = select(hit, u, p.u);
+				p.v = select(hit, v, p.v);
+				if (anyHit) {
+					blocked |= hitMask;
+					if (blocked == active) {
+						stackSize = 0;
+						break;
+					}
+				}
+			}
+			continue;
+		}
+
+		__m128 nearLeft, nearRight;
+		int left = _mm_movemask_ps(hitBox(bvh.nodes[node.first], p, nearLeft));
+		int right = _mm_movemask_ps(hitBox(bvh.nodes[node.first + 1], p, nearRight));
+		if (left && right) {
+			// the child some ray enters first goes on top
+			int leftCloser = _mm_movemask_ps(_mm_cmple_ps(nearLeft, nearRight)) & left & right;
+			bool leftOnTop = leftCloser != 0;
+			// build() bounds the depth, so this always fits
+			assert(stackSize + 2 <= STACK_SIZE);
+			stack[stackSize++] = leftOnTop ? node.first + 1 : node.first;
+			stack[stackSize++] = leftOnTop ? node.first : node.first + 1;
+		}
+		else if (left || right) {
+			stack[stackSize++] = left ? node.first : node.first + 1;
+		}
+	}
+
+	_mm_store_ps(packet.tMax, p.tMax);
+	_mm_store_si128((__m128i*)packet.triangle, p.triangle);
+	_mm_store_ps(packet.u, p.u);
+	_mm_store_ps(packet.v, p.v);
+	return blocked;
+}
+
+}
+
+void Bvh::intersect(RayPacket& packet) const {
+	traverse<false>(*this, packet);
+}
+
+int Bvh::occluded(RayPacket& packet) const {
+	return traverse<true>(*this, packet);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Triangle stored for intersection: one corner and the two edges leaving it
+struct BvhTriangle {
+	glm::vec3 v0;
+	glm::vec3 edge1;
+	glm::vec3 edge2;
+};
+
+// 32 bytes; inner nodes have count 0 and their children at first and first + 1
+struct BvhNode {
+	glm::vec3 boundsMin;
+	int first;
+	glm::vec3 boundsMax;
+	int count;
+};
+
+// Four rays traced together, one per SSE lane. Lanes with tMax <= 0 are inactive.
+struct alignas(16) RayPacket {
+	float originX[4], originY[4], originZ[4];
+	float directionX[4], directionY[4], directionZ[4];
+	float tMax[4];
+	int triangle[4];     /* closest hit, an index into the triangles given to build(), or -1 */
+	float u[4], v[4];    /* barycentric weights of corners 1 and 2 at the hit */
+
+	void set(int lane, const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+	void disable(int lane);
+};
+
+// Bounding volume hierarchy over world-space triangles, split with the binned surface area heuristic
+class Bvh {
+public:
+	std::vector<BvhNode> nodes;
+	std::vector<BvhTriangle> triangles;  /* in leaf order */
+	std::vector<int> triangleIds;        /* index each leaf triangle had in build() */
+	int maxLeafSize;                     /* leaves never hold more triangles unless they cannot be split */
+
+	Bvh();
+	void build(const std::vector<BvhTriangle>& input);
+	// closest hit of every active lane, shrinking its tMax
+	void intersect(RayPacket& packet) const;
+	// bit mask of the active lanes blocked before their tMax; blocked lanes are disabled
+	int occluded(RayPacket& packet) const;
+private:
+	std::vector<glm::vec3> centroids;
+	std::vector<glm::vec3> boundsMins, boundsMaxs;
+	void subdivide(int node, int first, int count, int depth, std::vector<int>& order);
+};
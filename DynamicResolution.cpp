@@ -0,0 +1,68 @@
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution() {
+	enabled = false;
+	targetMs = 14.0f;
+	minScale = 0.5f;
+	maxScale = 1.0f;
+	scaleStep = 0.05f;
+	deadband = 0.05f;
+	kp = 0.1f;
+	ki = 0.02f;
+	kd = 0.02f;
+	cooldownFrames = 30;
+	smoothing = 0.2f;
+	reset();
+}
+
+void DynamicResolution::reset() {
+	scale = maxScale;
+	desired = maxScale;
+	smoothedMs = 0.0;
+	lastError = 0.0f;
+	previousError = 0.0f;
+	framesSinceChange = 0;
+}
+
+/* Feed the GPU time of a finished frame and pick the scale for the next one */
+void DynamicResolution::update(double frameMs) {
+	framesSinceChange++;
+	if (!enabled) {
+		scale = maxScale;
+		return;
+	}
+	if (frameMs <= 0.0) {
+		return;
+	}
+	smoothedMs = smoothedMs > 0.0 ? smoothedMs + smoothing * (frameMs - smoothedMs) : frameMs;
+
+	// Positive error is headroom, negative means over budget
+	float error = (float)((targetMs - smoothedMs) / targetMs);
+	if (std::fabs(error) < deadband) {
+		error = 0.0f;
+	}
+	// Incremental PID: the change in scale rather than the scale itself, so clamping it cannot wind up
+	float output = kp * (error - lastError) + ki * error + kd * (error - 2.0f * lastError + previousError);
+	previousError = lastError;
+	lastError = error;
+	desired = std::min(maxScale, std::max(minScale, desired + output));
+
+	float quantized = std::min(maxScale, std::max(minScale, std::floor(desired / scaleStep + 0.5f) * scaleStep));
+	// GPU times arrive GPU_TIMER_LATENCY frames late, so even drops wait that long to see their effect
+	if ((quantized < scale && framesSinceChange > GPU_TIMER_LATENCY) || (quantized > scale && framesSinceChange >= cooldownFrames)) {
+		scale = quantized;
+		framesSinceChange = 0;
+	}
+}
+
+int DynamicResolution::scaledWidth(int fullWidth) const {
+	return std::max(1, (int)(fullWidth * scale + 0.5f));
+}
+
+int DynamicResolution::scaledHeight(int fullHeight) const {
+	return std::max(1, (int)(fullHeight * scale + 0.5f));
+}
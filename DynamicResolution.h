@@ -0,0 +1,29 @@
+#pragma once
+
+// Picks the scene render scale each frame so the measured GPU frame time holds a target.
+// A PID controller drives a desired scale; the applied scale only moves in whole steps, drops
+// right away when over budget and grows back only after a cooldown, so it does not oscillate.
+class DynamicResolution {
+public:
+	bool enabled;
+	float targetMs;            /* GPU frame time to hold */
+	float minScale, maxScale;  /* fraction of the window resolution per axis */
+	float scaleStep;           /* applied scale is a multiple of this */
+	float deadband;            /* relative error ignored around the target (hysteresis) */
+	float kp, ki, kd;          /* gains on the relative error, in scale units */
+	int cooldownFrames;        /* frames to wait after a change before growing again */
+	float smoothing;           /* weight of a new sample in the frame time average */
+	float scale;               /* scale applied this frame */
+	double smoothedMs;
+
+	DynamicResolution();
+	void update(double frameMs);
+	int scaledWidth(int fullWidth) const;
+	int scaledHeight(int fullHeight) const;
+	void reset();
+private:
+	float desired;
+	float lastError;
+	float previousError;
+	int framesSinceChange;
+};
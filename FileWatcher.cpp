@@ -0,0 +1,108 @@
+#include "FileWatcher.h"
+
+#include <iostream>
+#include <set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+FileWatcher::FileWatcher() : scanInterval(500), inotifyFd(-1) {
+	lastScan = std::chrono::steady_clock::now();
+#ifdef __linux__
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0) {
+		std::cout << "WARNING::FILE_WATCHER::INOTIFY_UNAVAILABLE, falling back to polling" << std::endl;
+	}
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	if (inotifyFd >= 0) {
+		close(inotifyFd);
+	}
+#endif
+}
+
+std::string FileWatcher::normalize(const std::string& path) {
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	return (error ? std::filesystem::path(path) : absolute).lexically_normal().string();
+}
+
+void FileWatcher::watch(const std::string& path) {
+	std::string key = normalize(path);
+	if (watched.count(key)) {
+		return;
+	}
+	watched[key] = path;
+
+	std::error_code error;
+	timestamps[key] = std::filesystem::last_write_time(key, error);
+
+#ifdef __linux__
+	if (inotifyFd >= 0) {
+		// Watch the directory rather than the file: editors often save by writing a new file and renaming it
+		std::string directory = std::filesystem::path(key).parent_path().string();
+		for (const auto& entry : watchDirectories) {
+			if (entry.second == directory) {
+				return;
+			}
+		}
+		int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd >= 0) {
+			watchDirectories[wd] = directory;
+		}
+	}
+#endif
+}
+
+std::vector<std::string> FileWatcher::poll() {
+#ifdef __linux__
+	if (inotifyFd >= 0) {
+		std::set<std::string> changed;
+		alignas(inotify_event) char buffer[4096];
+		for (;;) {
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				break;
+			}
+			for (char* p = buffer; p < buffer + length; ) {
+				inotify_event* event = (inotify_event*)p;
+				p += sizeof(inotify_event) + event->len;
+				auto directory = watchDirectories.find(event->wd);
+				if (directory == watchDirectories.end() || event->len == 0) {
+					continue;
+				}
+				auto file = watched.find(directory->second + "/" + event->name);
+				if (file != watched.end()) {
+					changed.insert(file->second);
+				}
+			}
+		}
+		return std::vector<std::string>(changed.begin(), changed.end());
+	}
+#endif
+	return pollTimestamps();
+}
+
+std::vector<std::string> FileWatcher::pollTimestamps() {
+	std::vector<std::string> changed;
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastScan < scanInterval) {
+		return changed;
+	}
+	lastScan = now;
+	for (auto& entry : timestamps) {
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(entry.first, error);
+		if (!error && time != entry.second) {
+			entry.second = time;
+			changed.push_back(watched[entry.first]);
+		}
+	}
+	return changed;
+}
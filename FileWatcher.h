@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <chrono>
+
+// Reports files that were written since the last poll. Uses inotify on Linux; elsewhere it compares
+// modification times at most every scanInterval.
+class FileWatcher {
+public:
+	std::chrono::milliseconds scanInterval;   /* polling fallback only */
+
+	FileWatcher();
+	~FileWatcher();
+	void watch(const std::string& path);
+	// paths (as passed to watch) that changed; never blocks
+	std::vector<std::string> poll();
+private:
+	std::unordered_map<std::string, std::string> watched;   /* normalized absolute path -> path given to watch */
+	std::unordered_map<std::string, std::filesystem::file_time_type> timestamps;
+	std::chrono::steady_clock::time_point lastScan;
+	int inotifyFd;                                            /* -1 when inotify is unavailable */
+	std::unordered_map<int, std::string> watchDirectories;   /* inotify watch descriptor -> directory */
+	static std::string normalize(const std::string& path);
+	std::vector<std::string> pollTimestamps();
+};
@@ -0,0 +1,114 @@
+#include "FramePacer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+FramePacer::FramePacer() {
+	swapInterval = 1;
+	targetFps = 0.0;
+	spinMs = 2.0;
+	maxDeltaSeconds = 0.1;
+	deltaSeconds = 0.0;
+	started = false;
+	presentedOnce = false;
+	intervals.assign(FRAME_PACING_HISTORY, 0.0f);
+	nextInterval = 0;
+	intervalCount = 0;
+#ifdef _WIN32
+	// The default 15.6 ms scheduler tick would make every sleep overshoot the deadline
+	timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::applySwapInterval() {
+	int interval = swapInterval;
+	if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+		std::cout << "Adaptive vsync not supported, using vsync" << std::endl;
+		interval = 1;
+	}
+	glfwSwapInterval(interval);
+}
+
+void FramePacer::beginFrame() {
+	Clock::time_point now = Clock::now();
+	if (targetFps > 0.0 && started) {
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+		nextDeadline += period;
+		if (now > nextDeadline + period) {
+			// Too far behind to catch up without a burst of frames; restart the schedule from now
+			nextDeadline = now;
+		}
+		Clock::duration spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinMs));
+		if (nextDeadline - now > spin) {
+			std::this_thread::sleep_for(nextDeadline - now - spin);
+		}
+		while (Clock::now() < nextDeadline) {
+			std::this_thread::yield();
+		}
+		now = Clock::now();
+	}
+	else {
+		nextDeadline = now;
+	}
+
+	deltaSeconds = started ? std::min(std::chrono::duration<double>(now - lastFrameStart).count(), maxDeltaSeconds) : 0.0;
+	lastFrameStart = now;
+	started = true;
+}
+
+void FramePacer::presented() {
+	Clock::time_point now = Clock::now();
+	if (presentedOnce) {
+		intervals[nextInterval] = (float)std::chrono::duration<double, std::milli>(now - lastPresent).count();
+		nextInterval = (nextInterval + 1) % FRAME_PACING_HISTORY;
+		intervalCount = std::min(intervalCount + 1, FRAME_PACING_HISTORY);
+	}
+	lastPresent = now;
+	presentedOnce = true;
+}
+
+FramePacingStats FramePacer::stats() const {
+	FramePacingStats result = { intervalCount, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	if (intervalCount == 0) {
+		return result;
+	}
+	std::vector<float> sorted(intervals.begin(), intervals.begin() + intervalCount);
+	std::sort(sorted.begin(), sorted.end());
+
+	double sum = 0.0, squares = 0.0;
+	for (float ms : sorted) {
+		sum += ms;
+		squares += (double)ms * ms;
+	}
+	result.meanMs = sum / intervalCount;
+	result.jitterMs = std::sqrt(std::max(0.0, squares / intervalCount - result.meanMs * result.meanMs));
+	// nearest-rank percentiles
+	auto percentile = [&](double p) { return (double)sorted[std::min(intervalCount - 1, (int)std::ceil(p * intervalCount) - 1)]; };
+	result.p50Ms = percentile(0.50);
+	result.p95Ms = percentile(0.95);
+	result.p99Ms = percentile(0.99);
+	result.maxMs = sorted.back();
+	return result;
+}
+
+void FramePacer::resetStats() {
+	nextInterval = 0;
+	intervalCount = 0;
+	presentedOnce = false;
+}
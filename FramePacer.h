@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+// Present-to-present intervals kept for the statistics
+const int FRAME_PACING_HISTORY = 4096;
+
+struct FramePacingStats {
+	int frames;
+	double meanMs;
+	double jitterMs;           /* standard deviation of the present-to-present interval */
+	double p50Ms, p95Ms, p99Ms;
+	double maxMs;
+};
+
+// Controls how frames are presented: swap interval (vsync, off or adaptive), an optional frame limiter
+// that sleeps most of the wait and spins the rest for precision, the frame delta animation should use,
+// and statistics on the present-to-present interval
+class FramePacer {
+public:
+	int swapInterval;          /* 1 = vsync, 0 = off, -1 = adaptive (tears instead of waiting when late) */
+	double targetFps;          /* frame limiter rate, 0 for none */
+	double spinMs;             /* the limiter sleeps until this close to the deadline, then spins */
+	double maxDeltaSeconds;    /* cap on deltaSeconds so a hitch does not jump the animation */
+	double deltaSeconds;       /* time between the starts of the last two frames */
+
+	FramePacer();
+	~FramePacer();
+	/* apply swapInterval to the current context; adaptive falls back to vsync when unsupported */
+	void applySwapInterval();
+	/* wait for the limiter, then measure the frame delta; call at the top of the frame */
+	void beginFrame();
+	/* record the present time; call right after glfwSwapBuffers */
+	void presented();
+	FramePacingStats stats() const;
+	void resetStats();
+private:
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point lastFrameStart;
+	Clock::time_point nextDeadline;
+	Clock::time_point lastPresent;
+	bool started;
+	bool presentedOnce;
+	std::vector<float> intervals;          /* ring of the last FRAME_PACING_HISTORY intervals in ms */
+	int nextInterval;
+	int intervalCount;
+};
@@ -0,0 +1,16 @@
+#include "FullscreenPass.h"
+#include "GLState.h"
+
+FullscreenPass::FullscreenPass() {
+	glGenVertexArrays(1, &VAO);
+}
+
+void FullscreenPass::draw() {
+	glState.bindVertexArray(VAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void FullscreenPass::deleteBuffers() {
+	glDeleteVertexArrays(1, &VAO);
+	glState.vertexArrayDeleted(VAO);
+}
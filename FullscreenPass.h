@@ -0,0 +1,13 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Draws one triangle covering the viewport; the vertex shader derives positions from gl_VertexID
+class FullscreenPass {
+public:
+	FullscreenPass();
+	void draw();
+	void deleteBuffers();
+private:
+	unsigned int VAO;                      /* empty, but core profile needs one bound to draw */
+};
@@ -0,0 +1,55 @@
+#include "GLExtensions.h"
+
+#include <cstring>
+
+GLExtensions glExt = {};
+
+bool hasGLExtension(const char* name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool versionAtLeast(int major, int minor) {
+	return glExt.majorVersion > major || (glExt.majorVersion == major && glExt.minorVersion >= minor);
+}
+
+void loadGLExtensions(GLADloadproc load) {
+	glGetIntegerv(GL_MAJOR_VERSION, &glExt.majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &glExt.minorVersion);
+
+	glExt.GetProgramBinary = (GLGetProgramBinaryProc)load("glGetProgramBinary");
+	glExt.ProgramBinary = (GLProgramBinaryProc)load("glProgramBinary");
+	glExt.ProgramParameteri = (GLProgramParameteriProc)load("glProgramParameteri");
+	glExt.programBinary = (versionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary"))
+		&& glExt.GetProgramBinary && glExt.ProgramBinary && glExt.ProgramParameteri;
+	if (glExt.programBinary) {
+		// drivers may support the entry points yet offer no binary format
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		glExt.programBinary = formats > 0;
+	}
+
+	if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+		glExt.MaxShaderCompilerThreads = (GLMaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+		glExt.MaxShaderCompilerThreads = (GLMaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+	}
+	glExt.parallelShaderCompile = glExt.MaxShaderCompilerThreads != nullptr;
+	if (glExt.parallelShaderCompile) {
+		// let the driver pick as many compiler threads as it likes
+		glExt.MaxShaderCompilerThreads(0xFFFFFFFF);
+	}
+
+	if (versionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+		glExt.BufferStorage = (GLBufferStorageProc)load("glBufferStorage");
+	}
+	glExt.bufferStorage = glExt.BufferStorage != nullptr;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// glad is generated for plain GL 3.3 core, so newer entry points and enums are declared here and
+// loaded at runtime; each feature flag is only set when the driver provides it
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (APIENTRYP GLGetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP GLProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP GLProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP GLMaxShaderCompilerThreadsProc)(GLuint count);
+typedef void (APIENTRYP GLBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct GLExtensions {
+	int majorVersion, minorVersion;
+
+	/* GL 4.1 / ARB_get_program_binary */
+	bool programBinary;
+	GLGetProgramBinaryProc GetProgramBinary;
+	GLProgramBinaryProc ProgramBinary;
+	GLProgramParameteriProc ProgramParameteri;
+
+	/* KHR_parallel_shader_compile (or the ARB variant) */
+	bool parallelShaderCompile;
+	GLMaxShaderCompilerThreadsProc MaxShaderCompilerThreads;
+
+	/* GL 4.4 / ARB_buffer_storage */
+	bool bufferStorage;
+	GLBufferStorageProc BufferStorage;
+};
+
+extern GLExtensions glExt;
+
+// Fill glExt; call once after gladLoadGLLoader with the same loader
+void loadGLExtensions(GLADloadproc load);
+bool hasGLExtension(const char* name);
@@ -0,0 +1,139 @@
+#include "GLState.h"
+
+// Never a valid object name, so the first bind after startup or invalidate() is always issued
+const unsigned int UNKNOWN_BINDING = 0xFFFFFFFFu;
+
+GLState glState;
+
+GLState::GLState() {
+	issuedCalls = 0;
+	skippedCalls = 0;
+	lastIssuedCalls = 0;
+	lastSkippedCalls = 0;
+	invalidate();
+}
+
+void GLState::invalidate() {
+	program = UNKNOWN_BINDING;
+	vertexArray = UNKNOWN_BINDING;
+	activeUnit = UNKNOWN_BINDING;
+	for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+		textures[i] = UNKNOWN_BINDING;
+	}
+	blend = -1;
+	depthTest = -1;
+	cullFace = -1;
+}
+
+void GLState::beginFrame() {
+	lastIssuedCalls = issuedCalls;
+	lastSkippedCalls = skippedCalls;
+	issuedCalls = 0;
+	skippedCalls = 0;
+}
+
+void GLState::countCall(bool issued) {
+	if (issued) {
+		issuedCalls++;
+	}
+	else {
+		skippedCalls++;
+	}
+}
+
+void GLState::useProgram(unsigned int newProgram) {
+	countCall(newProgram != program);
+	if (newProgram != program) {
+		glUseProgram(newProgram);
+		program = newProgram;
+	}
+}
+
+unsigned int GLState::currentProgram() const {
+	return program;
+}
+
+void GLState::bindVertexArray(unsigned int newVertexArray) {
+	countCall(newVertexArray != vertexArray);
+	if (newVertexArray != vertexArray) {
+		glBindVertexArray(newVertexArray);
+		vertexArray = newVertexArray;
+	}
+}
+
+void GLState::activateUnit(unsigned int unit) {
+	countCall(unit != activeUnit);
+	if (unit != activeUnit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int texture) {
+	if (unit >= (unsigned int)GL_STATE_TEXTURE_UNITS) {
+		activateUnit(unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		countCall(true);
+		return;
+	}
+	if (textures[unit] == texture) {
+		countCall(false);
+		return;
+	}
+	activateUnit(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	textures[unit] = texture;
+	countCall(true);
+}
+
+int* GLState::capabilitySlot(GLenum capability) {
+	switch (capability) {
+	case GL_BLEND:
+		return &blend;
+	case GL_DEPTH_TEST:
+		return &depthTest;
+	case GL_CULL_FACE:
+		return &cullFace;
+	default:
+		return nullptr;
+	}
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled) {
+	int* slot = capabilitySlot(capability);
+	if (slot && *slot == (enabled ? 1 : 0)) {
+		countCall(false);
+		return;
+	}
+	if (enabled) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+	if (slot) {
+		*slot = enabled ? 1 : 0;
+	}
+	countCall(true);
+}
+
+/* A deleted program stays in use until another is bound, but its name may be handed out again */
+void GLState::programDeleted(unsigned int deleted) {
+	if (program == deleted) {
+		program = UNKNOWN_BINDING;
+	}
+}
+
+void GLState::vertexArrayDeleted(unsigned int deleted) {
+	if (vertexArray == deleted) {
+		vertexArray = UNKNOWN_BINDING;
+	}
+}
+
+void GLState::textureDeleted(unsigned int deleted) {
+	for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+		if (textures[i] == deleted) {
+			textures[i] = UNKNOWN_BINDING;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Texture units whose GL_TEXTURE_2D binding is shadowed; binds on higher units always go to GL
+const int GL_STATE_TEXTURE_UNITS = 16;
+
+// Shadow copy of the GL state the renderer changes most: bound program, vertex array, 2D texture
+// per unit, active unit and the blend/depth/cull switches. A call that would not change anything is
+// skipped. Everything starts unknown, so the first call of each kind always reaches GL.
+// Code that deletes a tracked object has to report it, since GL unbinds it behind our back.
+class GLState {
+public:
+	unsigned int issuedCalls;              /* GL calls made this frame, uniform uploads included */
+	unsigned int skippedCalls;             /* calls dropped as redundant this frame */
+	unsigned int lastIssuedCalls;          /* totals of the previous frame */
+	unsigned int lastSkippedCalls;
+
+	GLState();
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vertexArray);
+	void bindTexture(unsigned int unit, unsigned int texture);   /* GL_TEXTURE_2D on the given unit */
+	void setEnabled(GLenum capability, bool enabled);
+	unsigned int currentProgram() const;
+
+	void programDeleted(unsigned int program);
+	void vertexArrayDeleted(unsigned int vertexArray);
+	void textureDeleted(unsigned int texture);
+	/* forget everything, e.g. after code outside the renderer touched GL */
+	void invalidate();
+	/* roll the per-frame counters */
+	void beginFrame();
+	/* record whether a uniform upload was made or skipped */
+	void countCall(bool issued);
+private:
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeUnit;
+	unsigned int textures[GL_STATE_TEXTURE_UNITS];
+	int blend, depthTest, cullFace;        /* 1 on, 0 off, -1 unknown */
+	int* capabilitySlot(GLenum capability);
+	void activateUnit(unsigned int unit);
+};
+
+extern GLState glState;
@@ -0,0 +1,526 @@
+#include "GltfAsset.h"
+
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+
+#include "stb_image.h"
+
+static const unsigned int GLB_MAGIC = 0x46546C67;       /* "glTF" */
+static const unsigned int GLB_CHUNK_JSON = 0x4E4F534A;  /* "JSON" */
+static const unsigned int GLB_CHUNK_BIN = 0x004E4942;   /* "BIN\0" */
+// Arrays and objects nested deeper than this are rejected; glTF needs about six levels
+static const int JSON_MAX_DEPTH = 64;
+
+// Just enough JSON for the glTF chunk: a tree of values parsed in one pass, looked up by key
+struct JsonValue {
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type;
+	double number;
+	std::string string;
+	std::vector<JsonValue> items;                       /* array elements or object values */
+	std::vector<std::string> keys;                      /* object keys, parallel to items */
+
+	JsonValue() : type(NUL), number(0.0) {
+	}
+	const JsonValue& operator[](const char* key) const {
+		static const JsonValue missing;
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (keys[i] == key) {
+				return items[i];
+			}
+		}
+		return missing;
+	}
+	const JsonValue& operator[](size_t index) const {
+		static const JsonValue missing;
+		return index < items.size() && type == ARRAY ? items[index] : missing;
+	}
+	size_t size() const {
+		return type == ARRAY ? items.size() : 0;
+	}
+	bool has(const char* key) const {
+		return (*this)[key].type != NUL;
+	}
+	double asNumber(double fallback) const {
+		return type == NUMBER ? number : fallback;
+	}
+	bool asBool(bool fallback) const {
+		return type == BOOLEAN ? number != 0.0 : fallback;
+	}
+	int asInt(int fallback) const {
+		return type == NUMBER && number >= (double)INT_MIN && number <= (double)INT_MAX ? (int)number : fallback;
+	}
+};
+
+class JsonParser {
+public:
+	JsonParser(const char* text, size_t length) : cursor(text), end(text + length), depth(0), failed(false) {
+	}
+	bool parse(JsonValue& root) {
+		value(root);
+		skipSpace();
+		return !failed;
+	}
+private:
+	const char* cursor;
+	const char* end;
+	int depth;
+	bool failed;
+
+	void skipSpace() {
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+			cursor++;
+		}
+	}
+	bool expect(char c) {
+		skipSpace();
+		if (cursor < end && *cursor == c) {
+			cursor++;
+			return true;
+		}
+		failed = true;
+		return false;
+	}
+	void value(JsonValue& out) {
+		skipSpace();
+		if (failed || cursor >= end) {
+			failed = true;
+			return;
+		}
+		char c = *cursor;
+		if ((c == '{' || c == '[') && depth >= JSON_MAX_DEPTH) {
+			failed = true;
+			return;
+		}
+		if (c == '{') {
+			out.type = JsonValue::OBJECT;
+			cursor++;
+			skipSpace();
+			if (cursor < end && *cursor == '}') {
+				cursor++;
+				return;
+			}
+			do {
+				std::string key;
+				skipSpace();
+				if (!stringLiteral(key) || !expect(':')) {
+					failed = true;
+					return;
+				}
+				out.keys.push_back(key);
+				out.items.emplace_back();
+				depth++;
+				value(out.items.back());
+				depth--;
+				skipSpace();
+			} while (!failed && cursor < end && *cursor == ',' && ++cursor);
+			expect('}');
+		}
+		else if (c == '[') {
+			out.type = JsonValue::ARRAY;
+			cursor++;
+			skipSpace();
+			if (cursor < end && *cursor == ']') {
+				cursor++;
+				return;
+			}
+			do {
+				out.items.emplace_back();
+				depth++;
+				value(out.items.back());
+				depth--;
+				skipSpace();
+			} while (!failed && cursor < end && *cursor == ',' && ++cursor);
+			expect(']');
+		}
+		else if (c == '"') {
+			out.type = JsonValue::STRING;
+			failed = !stringLiteral(out.string);
+		}
+		else if (c == 't' || c == 'f' || c == 'n') {
+			const char* word = c == 't' ? "true" : c == 'f' ? "false" : "null";
+			size_t length = std::strlen(word);
+			if ((size_t)(end - cursor) < length || std::strncmp(cursor, word, length) != 0) {
+				failed = true;
+				return;
+			}
+			cursor += length;
+			out.type = c == 'n' ? JsonValue::NUL : JsonValue::BOOLEAN;
+			out.number = c == 't' ? 1.0 : 0.0;
+		}
+		else {
+			// strtod stops at the end of the number; the chunk is padded with spaces, not terminated
+			char buffer[64];
+			size_t length = 0;
+			while (cursor + length < end && length + 1 < sizeof(buffer) && std::strchr("+-0123456789.eE", cursor[length])) {
+				buffer[length] = cursor[length];
+				length++;
+			}
+			buffer[length] = '\0';
+			char* numberEnd = nullptr;
+			out.type = JsonValue::NUMBER;
+			out.number = std::strtod(buffer, &numberEnd);
+			if (length == 0 || numberEnd != buffer + length) {
+				failed = true;
+				return;
+			}
+			cursor += length;
+		}
+	}
+	// glTF keys and uris are ASCII in practice; escapes other than \uXXXX are decoded, \u keeps its text
+	bool stringLiteral(std::string& out) {
+		if (cursor >= end || *cursor != '"') {
+			return false;
+		}
+		cursor++;
+		while (cursor < end && *cursor != '"') {
+			char c = *cursor++;
+			if (c == '\\' && cursor < end) {
+				char escaped = *cursor++;
+				switch (escaped) {
+				case 'n': out += '\n'; break;
+				case 't': out += '\t'; break;
+				case 'r': out += '\r'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'u': out += "\\u"; break;
+				default: out += escaped; break;
+				}
+			}
+			else {
+				out += c;
+			}
+		}
+		if (cursor >= end) {
+			return false;
+		}
+		cursor++;
+		return true;
+	}
+};
+
+static int componentCount(const std::string& type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+static size_t componentSize(GLenum componentType) {
+	switch (componentType) {
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+	case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+	default: return 0;
+	}
+}
+
+// Offsets, lengths and counts: absent means 0, anything else must be a non-negative integer that a double holds exactly
+static bool readSize(const JsonValue& value, size_t& out) {
+	out = 0;
+	if (value.type == JsonValue::NUL) {
+		return true;
+	}
+	if (value.type != JsonValue::NUMBER || !(value.number >= 0.0) || value.number > 9007199254740992.0
+		|| value.number != std::floor(value.number)) {
+		return false;
+	}
+	out = (size_t)value.number;
+	return true;
+}
+
+static bool validIndex(int index, size_t count) {
+	return index >= -1 && index < (int)count;
+}
+
+static unsigned int readUint(const unsigned char* bytes) {
+	return (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) | ((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+}
+
+static GltfImage decodeImage(const unsigned char* bytes, size_t length) {
+	GltfImage image = { nullptr, 0, 0, 0 };
+	// glTF rows already run top to bottom, matching its texture coordinates
+	stbi_set_flip_vertically_on_load_thread(0);
+	image.pixels = stbi_load_from_memory(bytes, (int)length, &image.width, &image.height, &image.channels, 0);
+	return image;
+}
+
+GltfAsset::GltfAsset(const std::string& path) {
+	loaded = false;
+	size_t slash = path.find_last_of("/\\");
+	directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	if (!file.open(path)) {
+		std::cout << "ERROR::GLTF::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+		return;
+	}
+	// header: magic, version, length; then chunks of length, type, data padded to 4 bytes
+	if (file.size < 20 || readUint(file.data) != GLB_MAGIC || readUint(file.data + 4) != 2) {
+		std::cout << "ERROR::GLTF::NOT_A_GLB_V2_FILE: " << path << std::endl;
+		return;
+	}
+	size_t totalLength = std::min((size_t)readUint(file.data + 8), file.size);
+	const char* json = nullptr;
+	size_t jsonLength = 0;
+	const unsigned char* binary = nullptr;
+	size_t binaryLength = 0;
+	for (size_t offset = 12; offset + 8 <= totalLength; ) {
+		size_t chunkLength = readUint(file.data + offset);
+		unsigned int chunkType = readUint(file.data + offset + 4);
+		if (offset + 8 + chunkLength > totalLength) {
+			break;
+		}
+		if (chunkType == GLB_CHUNK_JSON && !json) {
+			json = (const char*)file.data + offset + 8;
+			jsonLength = chunkLength;
+		}
+		else if (chunkType == GLB_CHUNK_BIN && !binary) {
+			binary = file.data + offset + 8;
+			binaryLength = chunkLength;
+		}
+		offset += 8 + ((chunkLength + 3) & ~(size_t)3);
+	}
+	if (!json) {
+		std::cout << "ERROR::GLTF::INVALID_JSON_CHUNK: " << path << std::endl;
+		return;
+	}
+	if (!parse(json, jsonLength, binary, binaryLength)) {
+		std::cout << "ERROR::GLTF::MALFORMED_ASSET: " << path << std::endl;
+		// nothing of a rejected file is handed out
+		meshes.clear();
+		nodes.clear();
+		rootNodes.clear();
+		return;
+	}
+	loaded = true;
+}
+
+GltfAsset::~GltfAsset() {
+	for (int i = 0; i < imageCount(); i++) {
+		image(i);
+		stbi_image_free(images[i].pixels);
+	}
+}
+
+int GltfAsset::imageCount() const {
+	return (int)images.size();
+}
+
+const GltfImage& GltfAsset::image(int index) {
+	if (!imageReady[index]) {
+		images[index] = pendingImages[index].get();
+		imageReady[index] = true;
+	}
+	return images[index];
+}
+
+bool GltfAsset::parse(const char* json, size_t length, const unsigned char* binary, size_t binaryLength) {
+	JsonValue root;
+	if (!JsonParser(json, length).parse(root)) {
+		std::cout << "ERROR::GLTF::INVALID_JSON_CHUNK" << std::endl;
+		return false;
+	}
+
+	// Only the GLB binary chunk (buffer 0 without uri) is supported as vertex storage
+	const JsonValue& views = root["bufferViews"];
+	for (size_t i = 0; i < views.size(); i++) {
+		const JsonValue& view = views[i];
+		size_t offset, viewLength, stride;
+		if (!readSize(view["byteOffset"], offset) || !readSize(view["byteLength"], viewLength) || !readSize(view["byteStride"], stride)
+			|| stride > 252) {
+			std::cout << "ERROR::GLTF::INVALID_BUFFER_VIEW " << i << std::endl;
+			return false;
+		}
+		BufferView result = { nullptr, 0, (int)stride };
+		if (view["buffer"].asInt(0) == 0 && binary && viewLength <= binaryLength && offset <= binaryLength - viewLength) {
+			result.data = binary + offset;
+			result.length = viewLength;
+		}
+		else {
+			std::cout << "ERROR::GLTF::BUFFER_VIEW_OUTSIDE_BINARY_CHUNK " << i << std::endl;
+		}
+		bufferViews.push_back(result);
+	}
+	viewBuffers.resize(bufferViews.size());
+
+	const JsonValue& accessorList = root["accessors"];
+	for (size_t i = 0; i < accessorList.size(); i++) {
+		const JsonValue& accessor = accessorList[i];
+		Accessor result;
+		size_t count;
+		result.bufferView = accessor["bufferView"].asInt(-1);
+		result.componentType = (GLenum)accessor["componentType"].asInt(GL_FLOAT);
+		result.components = componentCount(accessor["type"].string);
+		if (!readSize(accessor["byteOffset"], result.offset) || !readSize(accessor["count"], count) || count > (size_t)INT_MAX
+			|| !validIndex(result.bufferView, bufferViews.size()) || result.components == 0 || componentSize(result.componentType) == 0) {
+			std::cout << "ERROR::GLTF::INVALID_ACCESSOR " << i << std::endl;
+			return false;
+		}
+		result.count = (int)count;
+		result.normalized = accessor["normalized"].asBool(false);
+		result.hasBounds = accessor["min"].size() >= 3 && accessor["max"].size() >= 3;
+		result.min = glm::vec3(0.0f);
+		result.max = glm::vec3(0.0f);
+		if (result.hasBounds) {
+			for (int c = 0; c < 3; c++) {
+				result.min[c] = (float)accessor["min"][c].asNumber(0.0);
+				result.max[c] = (float)accessor["max"][c].asNumber(0.0);
+			}
+		}
+		// every element has to lie inside the view: offset + (count - 1) * stride + element size <= length
+		if (result.bufferView >= 0 && bufferViews[result.bufferView].data && count > 0) {
+			const BufferView& view = bufferViews[result.bufferView];
+			size_t elementSize = (size_t)result.components * componentSize(result.componentType);
+			size_t stride = view.stride > 0 ? (size_t)view.stride : elementSize;
+			if (result.offset > view.length || elementSize > view.length - result.offset
+				|| count - 1 > (view.length - result.offset - elementSize) / stride) {
+				std::cout << "ERROR::GLTF::ACCESSOR_OUTSIDE_BUFFER_VIEW " << i << std::endl;
+				return false;
+			}
+		}
+		accessors.push_back(result);
+	}
+
+	const JsonValue& meshList = root["meshes"];
+	for (size_t i = 0; i < meshList.size(); i++) {
+		std::vector<Primitive> primitives;
+		const JsonValue& primitiveList = meshList[i]["primitives"];
+		for (size_t p = 0; p < primitiveList.size(); p++) {
+			const JsonValue& primitive = primitiveList[p];
+			const JsonValue& attributes = primitive["attributes"];
+			Primitive result;
+			result.position = attributes["POSITION"].asInt(-1);
+			result.normal = attributes["NORMAL"].asInt(-1);
+			result.texcoord = attributes["TEXCOORD_0"].asInt(-1);
+			result.indices = primitive["indices"].asInt(-1);
+			result.material = primitive["material"].asInt(-1);
+			result.mode = (GLenum)primitive["mode"].asInt(GL_TRIANGLES);
+			if (!validIndex(result.position, accessors.size()) || !validIndex(result.normal, accessors.size())
+				|| !validIndex(result.texcoord, accessors.size()) || !validIndex(result.indices, accessors.size())) {
+				std::cout << "ERROR::GLTF::PRIMITIVE_ACCESSOR_OUT_OF_RANGE " << i << "/" << p << std::endl;
+				return false;
+			}
+			primitives.push_back(result);
+		}
+		meshes.push_back(primitives);
+	}
+
+	// Base color texture -> texture -> image
+	const JsonValue& textures = root["textures"];
+	const JsonValue& materials = root["materials"];
+	for (size_t i = 0; i < materials.size(); i++) {
+		const JsonValue& baseColor = materials[i]["pbrMetallicRoughness"]["baseColorTexture"];
+		int texture = baseColor["index"].asInt(-1);
+		materialImages.push_back(texture >= 0 ? textures[texture]["source"].asInt(-1) : -1);
+	}
+
+	const JsonValue& nodeList = root["nodes"];
+	for (size_t i = 0; i < nodeList.size(); i++) {
+		const JsonValue& node = nodeList[i];
+		Node result;
+		result.mesh = node["mesh"].asInt(-1);
+		for (size_t c = 0; c < node["children"].size(); c++) {
+			result.children.push_back(node["children"][c].asInt(0));
+		}
+		result.translation = glm::vec3(0.0f);
+		result.rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		result.scale = glm::vec3(1.0f);
+		if (node["matrix"].size() == 16) {
+			// split into translation, rotation and scale; shear cannot be represented and is dropped
+			glm::mat4 matrix;
+			for (int c = 0; c < 16; c++) {
+				matrix[c / 4][c % 4] = (float)node["matrix"][c].asNumber(0.0);
+			}
+			result.translation = glm::vec3(matrix[3]);
+			result.scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+			glm::mat3 rotation(glm::vec3(matrix[0]) / result.scale.x, glm::vec3(matrix[1]) / result.scale.y, glm::vec3(matrix[2]) / result.scale.z);
+			glm::quat q = glm::quat_cast(rotation);
+			result.rotation = glm::vec4(q.x, q.y, q.z, q.w);
+		}
+		else {
+			for (int c = 0; c < 3 && node["translation"].size() == 3; c++) {
+				result.translation[c] = (float)node["translation"][c].asNumber(0.0);
+			}
+			for (int c = 0; c < 4 && node["rotation"].size() == 4; c++) {
+				result.rotation[c] = (float)node["rotation"][c].asNumber(0.0);
+			}
+			for (int c = 0; c < 3 && node["scale"].size() == 3; c++) {
+				result.scale[c] = (float)node["scale"][c].asNumber(1.0);
+			}
+		}
+		nodes.push_back(result);
+	}
+	// The hierarchy must be a forest: children in range, one parent each and no node its own ancestor, so walking
+	// it from the roots terminates
+	std::vector<int> parents(nodes.size(), -1);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].mesh >= (int)meshes.size()) {
+			nodes[i].mesh = -1;
+		}
+		for (int child : nodes[i].children) {
+			if (child < 0 || child >= (int)nodes.size() || parents[child] >= 0 || child == (int)i) {
+				std::cout << "ERROR::GLTF::INVALID_NODE_HIERARCHY " << i << std::endl;
+				return false;
+			}
+			parents[child] = (int)i;
+		}
+	}
+	for (size_t i = 0; i < nodes.size(); i++) {
+		size_t steps = 0;
+		for (int ancestor = parents[i]; ancestor >= 0; ancestor = parents[ancestor]) {
+			if (++steps > nodes.size()) {
+				std::cout << "ERROR::GLTF::CYCLIC_NODE_HIERARCHY " << i << std::endl;
+				return false;
+			}
+		}
+	}
+	const JsonValue& scenes = root["scenes"];
+	const JsonValue& scene = scenes[(size_t)root["scene"].asInt(0)];
+	for (size_t i = 0; i < scene["nodes"].size(); i++) {
+		int node = scene["nodes"][i].asInt(-1);
+		if (node >= 0 && node < (int)nodes.size() && parents[node] < 0) {
+			rootNodes.push_back(node);
+		}
+	}
+
+	// Start every image now; meshes wait for theirs only when they upload it
+	const JsonValue& imageList = root["images"];
+	for (size_t i = 0; i < imageList.size(); i++) {
+		const JsonValue& image = imageList[i];
+		int view = image["bufferView"].asInt(-1);
+		if (view >= 0 && view < (int)bufferViews.size() && bufferViews[view].data) {
+			const unsigned char* bytes = bufferViews[view].data;
+			size_t byteLength = bufferViews[view].length;
+			pendingImages.push_back(std::async(std::launch::async, [bytes, byteLength]() {
+				return decodeImage(bytes, byteLength);
+			}));
+		}
+		else if (image["uri"].type == JsonValue::STRING && image["uri"].string.compare(0, 5, "data:") != 0) {
+			std::string imagePath = directory + image["uri"].string;
+			pendingImages.push_back(std::async(std::launch::async, [imagePath]() {
+				std::ifstream stream(imagePath, std::ios::binary);
+				std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+				return decodeImage(bytes.data(), bytes.size());
+			}));
+		}
+		else {
+			std::cout << "ERROR::GLTF::UNSUPPORTED_IMAGE_SOURCE " << i << std::endl;
+			std::promise<GltfImage> none;
+			none.set_value({ nullptr, 0, 0, 0 });
+			pendingImages.push_back(none.get_future());
+		}
+		images.push_back({ nullptr, 0, 0, 0 });
+		imageReady.push_back(false);
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+#include <memory>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "MappedFile.h"
+
+// Image decoded from a glTF asset, rows top to bottom as glTF texture coordinates expect
+struct GltfImage {
+	unsigned char* pixels;                 /* null when decoding failed */
+	int width, height, channels;
+};
+
+// Binary glTF 2.0 (.glb). The file is memory-mapped and only its JSON chunk is parsed; buffer views
+// point straight into the mapped binary chunk so meshes can hand them to GL without conversion.
+// Embedded or referenced images start decoding on worker threads as soon as the file is open.
+class GltfAsset {
+public:
+	struct BufferView {
+		const unsigned char* data;         /* inside the mapped file */
+		size_t length;
+		int stride;                        /* bytes between elements, 0 for tightly packed */
+	};
+	struct Accessor {
+		int bufferView;                    /* -1 for an all-zero accessor */
+		size_t offset;                     /* from the start of the buffer view */
+		GLenum componentType;              /* GL_FLOAT, GL_UNSIGNED_SHORT, ... as in the file */
+		int components;                    /* 1 for SCALAR up to 4 for VEC4 */
+		int count;
+		bool normalized;
+		bool hasBounds;
+		glm::vec3 min, max;
+	};
+	struct Primitive {
+		int position, normal, texcoord;    /* accessor indices, -1 when absent */
+		int indices;                       /* -1 for non-indexed */
+		int material;
+		GLenum mode;                       /* GL_TRIANGLES, ... */
+	};
+	struct Node {
+		int mesh;                          /* -1 for a pure transform */
+		std::vector<int> children;
+		glm::vec3 translation;
+		glm::vec4 rotation;                /* unit quaternion, xyz vector part and w */
+		glm::vec3 scale;
+	};
+
+	bool loaded;
+	std::vector<BufferView> bufferViews;
+	std::vector<Accessor> accessors;
+	std::vector<std::vector<Primitive>> meshes;
+	std::vector<int> materialImages;       /* image of each material's base color texture, -1 for none */
+	std::vector<Node> nodes;
+	std::vector<int> rootNodes;            /* nodes of the default scene */
+	// GL buffer of each buffer view, created by the first mesh that draws from it. Meshes hold a reference, so
+	// primitives share one copy and the last Mesh::deleteBuffers deletes it.
+	std::vector<std::shared_ptr<unsigned int>> viewBuffers;
+	std::shared_ptr<unsigned int> flatNormalBuffer;  /* one normal, for primitives without normals */
+
+	GltfAsset(const std::string& path);
+	~GltfAsset();
+	// decoded image; waits for its worker thread the first time
+	const GltfImage& image(int index);
+	int imageCount() const;
+private:
+	MappedFile file;
+	std::string directory;                 /* for images referenced by relative uri */
+	std::vector<std::future<GltfImage>> pendingImages;
+	std::vector<GltfImage> images;
+	std::vector<bool> imageReady;
+	bool parse(const char* json, size_t length, const unsigned char* binary, size_t binaryLength);
+	GltfAsset(const GltfAsset&) = delete;
+	GltfAsset& operator=(const GltfAsset&) = delete;
+};
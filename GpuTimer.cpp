@@ -0,0 +1,53 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() {
+	glGenQueries(GPU_TIMER_LATENCY, queries);
+	for (int i = 0; i < GPU_TIMER_LATENCY; i++) {
+		pending[i] = false;
+	}
+	current = 0;
+	reset();
+}
+
+/* Start timing; recycles the oldest query, reading its result if the GPU has finished with it */
+void GpuTimer::begin() {
+	collect(current, false);
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % GPU_TIMER_LATENCY;
+}
+
+double GpuTimer::averageMs() const {
+	return samples > 0 ? totalMs / samples : 0.0;
+}
+
+void GpuTimer::reset() {
+	lastMs = 0.0;
+	totalMs = 0.0;
+	samples = 0;
+}
+
+/* Read back a finished query; with wait = false an unfinished result is dropped instead of stalling */
+void GpuTimer::collect(int index, bool wait) {
+	if (!pending[index]) {
+		return;
+	}
+	GLint available = 0;
+	glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available || wait) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+		lastMs = elapsed / 1.0e6;
+		totalMs += lastMs;
+		samples++;
+	}
+	pending[index] = false;
+}
+
+void GpuTimer::deleteQueries() {
+	glDeleteQueries(GPU_TIMER_LATENCY, queries);
+}
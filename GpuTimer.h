@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Number of queries in flight; results are read back this many frames late so the CPU never waits on the GPU
+const int GPU_TIMER_LATENCY = 3;
+
+class GpuTimer {
+public:
+	double lastMs;                          /* most recent resolved GPU time in milliseconds */
+	double totalMs;                         /* sum of all resolved samples */
+	unsigned int samples;                   /* number of resolved samples */
+
+	GpuTimer();
+	void begin();
+	void end();
+	double averageMs() const;
+	void reset();
+	void deleteQueries();
+private:
+	unsigned int queries[GPU_TIMER_LATENCY];
+	bool pending[GPU_TIMER_LATENCY];
+	int current;
+	void collect(int index, bool wait);
+};
@@ -0,0 +1,107 @@
+#include "LightCuller.h"
+
+#include <xmmintrin.h>
+
+const int SIMD_WIDTH = 4;
+
+LightCuller::LightCuller(ThreadPool& pool) : pool(pool) {
+	parallelThreshold = 256;
+	lightCount = 0;
+	paddedCount = 0;
+}
+
+/* Pack the lights into SIMD-friendly arrays; call whenever a light moves or turns */
+void LightCuller::setLights(const std::vector<SpotLight>& lights) {
+	lightCount = (int)lights.size();
+	paddedCount = (lightCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	posX.assign(paddedCount, 0.0f);
+	posY.assign(paddedCount, 0.0f);
+	posZ.assign(paddedCount, 0.0f);
+	dirX.assign(paddedCount, 0.0f);
+	dirY.assign(paddedCount, 0.0f);
+	dirZ.assign(paddedCount, 0.0f);
+	cosAngle.assign(paddedCount, 1.0f);
+	sinAngle.assign(paddedCount, 0.0f);
+	// a negative range fails the range test for any object
+	range.assign(paddedCount, -INFINITY);
+
+	for (int i = 0; i < lightCount; i++) {
+		const SpotLight& light = lights[i];
+		glm::vec3 dir = glm::normalize(light.direction);
+		posX[i] = light.position.x;
+		posY[i] = light.position.y;
+		posZ[i] = light.position.z;
+		dirX[i] = dir.x;
+		dirY[i] = dir.y;
+		dirZ[i] = dir.z;
+		cosAngle[i] = light.cutoffAngle;
+		sinAngle[i] = std::sqrt(std::max(0.0f, 1.0f - light.cutoffAngle * light.cutoffAngle));
+		range[i] = light.range;
+	}
+}
+
+void LightCuller::cull(const std::vector<CullBounds>& objects) {
+	int objectCount = (int)objects.size();
+	indices.resize((size_t)objectCount * lightCount);
+	counts.resize(objectCount);
+	if (objectCount >= parallelThreshold) {
+		pool.parallelFor(objectCount, 64, [this, &objects](int begin, int end) {
+			cullRange(objects, begin, end);
+		});
+	}
+	else {
+		cullRange(objects, 0, objectCount);
+	}
+}
+
+/* Cone vs. sphere test for four lights at a time: the sphere is rejected when it lies fully
+   outside the cone's angle, beyond the light's range, or behind the apex */
+void LightCuller::cullRange(const std::vector<CullBounds>& objects, int begin, int end) {
+	const __m128 zero = _mm_setzero_ps();
+	for (int o = begin; o < end; o++) {
+		const CullBounds& bounds = objects[o];
+		__m128 cx = _mm_set1_ps(bounds.center.x);
+		__m128 cy = _mm_set1_ps(bounds.center.y);
+		__m128 cz = _mm_set1_ps(bounds.center.z);
+		__m128 radius = _mm_set1_ps(bounds.radius);
+		__m128 negRadius = _mm_set1_ps(-bounds.radius);
+
+		int* out = indices.data() + (size_t)o * lightCount;
+		int n = 0;
+		for (int l = 0; l < paddedCount; l += SIMD_WIDTH) {
+			// vector from apex to sphere center
+			__m128 vx = _mm_sub_ps(cx, _mm_loadu_ps(&posX[l]));
+			__m128 vy = _mm_sub_ps(cy, _mm_loadu_ps(&posY[l]));
+			__m128 vz = _mm_sub_ps(cz, _mm_loadu_ps(&posZ[l]));
+			__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+			// distance along the cone axis
+			__m128 along = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(vx, _mm_loadu_ps(&dirX[l])),
+				_mm_mul_ps(vy, _mm_loadu_ps(&dirY[l]))),
+				_mm_mul_ps(vz, _mm_loadu_ps(&dirZ[l])));
+			__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+			// distance from the sphere center to the cone surface
+			__m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&cosAngle[l]), across), _mm_mul_ps(along, _mm_loadu_ps(&sinAngle[l])));
+
+			__m128 outsideAngle = _mm_cmpgt_ps(closest, radius);
+			__m128 beyondRange = _mm_cmpgt_ps(along, _mm_add_ps(_mm_loadu_ps(&range[l]), radius));
+			__m128 behindApex = _mm_cmplt_ps(along, negRadius);
+			int rejected = _mm_movemask_ps(_mm_or_ps(_mm_or_ps(outsideAngle, beyondRange), behindApex));
+
+			for (int bit = 0; bit < SIMD_WIDTH; bit++) {
+				if (!(rejected & (1 << bit)) && l + bit < lightCount) {
+					out[n++] = l + bit;
+				}
+			}
+		}
+		counts[o] = n;
+	}
+}
+
+const int* LightCuller::lightsFor(int object) const {
+	return indices.data() + (size_t)object * lightCount;
+}
+
+int LightCuller::lightCountFor(int object) const {
+	return counts[object];
+}
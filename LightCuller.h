@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "SpotLight.h"
+#include "ThreadPool.h"
+
+// Bounding sphere of a drawable in world space
+struct CullBounds {
+	glm::vec3 center;
+	float radius;
+};
+
+// Finds, for every object, the spotlights whose cone and range can reach its bounds
+class LightCuller {
+public:
+	int parallelThreshold;     /* object count from which culling is split across the thread pool */
+
+	LightCuller(ThreadPool& pool);
+	void setLights(const std::vector<SpotLight>& lights);
+	void cull(const std::vector<CullBounds>& objects);
+
+	// compact list of light indices affecting an object after the last cull
+	const int* lightsFor(int object) const;
+	int lightCountFor(int object) const;
+private:
+	ThreadPool& pool;
+	int lightCount;
+	int paddedCount;                           /* light count rounded up to the SIMD width */
+	/* lights in structure-of-arrays form, padded with lights that reject everything */
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> dirX, dirY, dirZ;
+	std::vector<float> cosAngle, sinAngle, range;
+	std::vector<int> indices;                  /* lightCount slots per object */
+	std::vector<int> counts;
+	void cullRange(const std::vector<CullBounds>& objects, int begin, int end);
+};
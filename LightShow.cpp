@@ -0,0 +1,210 @@
+#include "LightShow.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <utility>
+#include <map>
+
+const int SHOW_SIMD_WIDTH = 4;
+const char* CHANNEL_NAMES[CHANNEL_COUNT] = { "pan", "tilt", "red", "green", "blue", "intensity", "cone", "strobe" };
+const float CHANNEL_DEFAULTS[CHANNEL_COUNT] = { 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 30.0f, 0.0f };
+
+typedef std::vector<std::pair<float, float>> Keyframes;   /* (time, value) of one fixture and channel */
+
+LightShow::LightShow() {
+	fixtureCount = 0;
+	length = 0.0f;
+	paddedCount = 0;
+	evaluatedTime = 0.0;
+}
+
+/* Value of one fixture's own piecewise linear curve, held constant outside its keys */
+static float sampleKeyframes(const Keyframes& keys, float time, float fallback) {
+	if (keys.empty()) {
+		return fallback;
+	}
+	if (time <= keys.front().first) {
+		return keys.front().second;
+	}
+	if (time >= keys.back().first) {
+		return keys.back().second;
+	}
+	auto next = std::upper_bound(keys.begin(), keys.end(), std::make_pair(time, INFINITY));
+	auto previous = next - 1;
+	float u = (time - previous->first) / (next->first - previous->first);
+	return previous->second + (next->second - previous->second) * u;
+}
+
+bool LightShow::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::LIGHT_SHOW::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+		return false;
+	}
+
+	int fixtures = 0;
+	float loopLength = 0.0f;
+	std::vector<Keyframes> keys[CHANNEL_COUNT];
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string command;
+		if (!(words >> command)) {
+			continue;
+		}
+		bool ok = true;
+		if (command == "fixtures") {
+			ok = (bool)(words >> fixtures) && fixtures > 0 && keys[0].empty();
+			for (int c = 0; ok && c < CHANNEL_COUNT; c++) {
+				keys[c].resize(fixtures);
+			}
+		}
+		else if (command == "length") {
+			ok = (bool)(words >> loopLength);
+		}
+		else if (command == "key") {
+			std::string target, channelName;
+			float time, value;
+			ok = (bool)(words >> target >> channelName >> time >> value) && fixtures > 0;
+			int channel = (int)(std::find(CHANNEL_NAMES, CHANNEL_NAMES + CHANNEL_COUNT, channelName) - CHANNEL_NAMES);
+			int first = 0, last = fixtures - 1;
+			if (ok && target != "*") {
+				size_t dash = target.find('-');
+				first = std::atoi(target.c_str());
+				last = dash == std::string::npos ? first : std::atoi(target.c_str() + dash + 1);
+			}
+			ok = ok && channel < CHANNEL_COUNT && first >= 0 && first <= last && last < fixtures;
+			for (int f = first; ok && f <= last; f++) {
+				// a later line at the same time replaces the earlier key
+				Keyframes& track = keys[channel][f];
+				auto at = std::lower_bound(track.begin(), track.end(), std::make_pair(time, -INFINITY));
+				if (at != track.end() && at->first == time) {
+					at->second = value;
+				}
+				else {
+					track.insert(at, std::make_pair(time, value));
+				}
+			}
+		}
+		else {
+			ok = false;
+		}
+		if (!ok) {
+			std::cout << "ERROR::LIGHT_SHOW::INVALID_LINE " << path << ":" << lineNumber << ": " << line << std::endl;
+			return false;
+		}
+	}
+	if (fixtures == 0) {
+		std::cout << "ERROR::LIGHT_SHOW::NO_FIXTURES: " << path << std::endl;
+		return false;
+	}
+
+	fixtureCount = fixtures;
+	length = loopLength;
+	paddedCount = (fixtures + SHOW_SIMD_WIDTH - 1) / SHOW_SIMD_WIDTH * SHOW_SIMD_WIDTH;
+
+	// Group fixtures by their key times; within a group all curves bend at the same times, so a row
+	// per key is enough to interpolate every fixture of the group at once
+	for (int c = 0; c < CHANNEL_COUNT; c++) {
+		std::map<std::vector<float>, int> groups;
+		tracks[c].clear();
+		for (int f = 0; f < fixtures; f++) {
+			std::vector<float> times;
+			for (const auto& key : keys[c][f]) {
+				times.push_back(key.first);
+			}
+			if (times.empty()) {
+				times.push_back(0.0f);
+			}
+			auto found = groups.find(times);
+			if (found == groups.end()) {
+				found = groups.emplace(times, (int)tracks[c].size()).first;
+				tracks[c].push_back(Track());
+				tracks[c].back().times = times;
+			}
+			tracks[c][found->second].fixtures.push_back(f);
+		}
+		for (Track& track : tracks[c]) {
+			int count = (int)track.fixtures.size();
+			track.stride = (count + SHOW_SIMD_WIDTH - 1) / SHOW_SIMD_WIDTH * SHOW_SIMD_WIDTH;
+			// whole lanes can be stored in place only when no padding would spill onto other fixtures
+			bool consecutive = track.fixtures.back() - track.fixtures.front() == count - 1;
+			track.firstFixture = consecutive && count == track.stride ? track.fixtures.front() : -1;
+			track.rows.assign(track.times.size() * track.stride, CHANNEL_DEFAULTS[c]);
+			for (size_t k = 0; k < track.times.size(); k++) {
+				for (int j = 0; j < count; j++) {
+					track.rows[k * track.stride + j] = sampleKeyframes(keys[c][track.fixtures[j]], track.times[k], CHANNEL_DEFAULTS[c]);
+				}
+			}
+			scratch.resize(std::max(scratch.size(), (size_t)track.stride));
+		}
+		values[c].assign(paddedCount, CHANNEL_DEFAULTS[c]);
+	}
+	evaluate(0.0);
+	return true;
+}
+
+void LightShow::evaluate(double seconds) {
+	double time = length > 0.0f ? std::fmod(seconds, (double)length) : seconds;
+	evaluatedTime = time;
+	for (int c = 0; c < CHANNEL_COUNT; c++) {
+		for (const Track& track : tracks[c]) {
+			// interpolate straight into the channel when the fixtures are consecutive
+			float* out = track.firstFixture >= 0 ? values[c].data() + track.firstFixture : scratch.data();
+			size_t next = std::upper_bound(track.times.begin(), track.times.end(), (float)time) - track.times.begin();
+			if (next == 0 || next == track.times.size()) {
+				// before the first or after the last key: hold it
+				const float* row = &track.rows[(next == 0 ? 0 : next - 1) * track.stride];
+				std::copy(row, row + track.stride, out);
+			}
+			else {
+				const float* a = &track.rows[(next - 1) * track.stride];
+				const float* b = &track.rows[next * track.stride];
+				float u = (float)((time - track.times[next - 1]) / (track.times[next] - track.times[next - 1]));
+				__m128 weight = _mm_set1_ps(u);
+				for (int j = 0; j < track.stride; j += SHOW_SIMD_WIDTH) {
+					__m128 va = _mm_loadu_ps(a + j);
+					__m128 vb = _mm_loadu_ps(b + j);
+					_mm_storeu_ps(out + j, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), weight)));
+				}
+			}
+			if (track.firstFixture < 0) {
+				for (size_t j = 0; j < track.fixtures.size(); j++) {
+					values[c][track.fixtures[j]] = scratch[j];
+				}
+			}
+		}
+	}
+}
+
+void LightShow::apply(std::vector<SpotLight>& lights, float rangeThreshold) const {
+	const float toRadians = 3.14159265f / 180.0f;
+	int count = std::min((int)lights.size(), fixtureCount);
+	for (int f = 0; f < count; f++) {
+		SpotLight& light = lights[f];
+		float pan = values[CHANNEL_PAN][f] * toRadians;
+		float tilt = values[CHANNEL_TILT][f] * toRadians;
+		light.direction = glm::vec3(std::sin(tilt) * std::cos(pan), -std::cos(tilt), std::sin(tilt) * std::sin(pan));
+
+		float cone = glm::clamp(values[CHANNEL_CONE][f], 0.0f, 89.0f) * toRadians;
+		light.cutoffAngle = std::cos(cone);
+		float intensity = std::max(0.0f, values[CHANNEL_INTENSITY][f]);
+		light.diffuse = glm::vec3(values[CHANNEL_RED][f], values[CHANNEL_GREEN][f], values[CHANNEL_BLUE][f]) * intensity;
+		light.range = spotLightRange(light, rangeThreshold);
+
+		// a strobing fixture is dark for the second half of every flash period; the range is kept
+		// from the lit state so the shadow frustum does not flicker with it
+		float strobe = values[CHANNEL_STROBE][f];
+		if (strobe > 0.0f && std::fmod(evaluatedTime * strobe, 1.0) >= 0.5) {
+			light.diffuse = glm::vec3(0.0f);
+		}
+	}
+}
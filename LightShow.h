@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SpotLight.h"
+
+// Parameters a cue file can animate per fixture
+enum LightChannel {
+	CHANNEL_PAN,               /* degrees around the vertical axis */
+	CHANNEL_TILT,              /* degrees away from straight down */
+	CHANNEL_RED,
+	CHANNEL_GREEN,
+	CHANNEL_BLUE,
+	CHANNEL_INTENSITY,         /* multiplies the color */
+	CHANNEL_CONE,              /* half angle of the cone in degrees */
+	CHANNEL_STROBE,            /* flashes per second, 0 for steady light */
+	CHANNEL_COUNT
+};
+
+// Keyframed light show. A cue file lists linear keyframes per fixture and channel. On load, the fixtures
+// of a channel that share the same key times (usually everything one key line addressed) become one
+// track holding a row of values per key, one value per fixture. Evaluation finds the segment once per
+// track and interpolates whole rows four fixtures at a time with SSE, leaving the results in
+// per-channel arrays.
+//
+// Cue file lines ('#' starts a comment):
+//   fixtures N                            number of fixtures
+//   length S                              loop length in seconds, 0 to hold the last keys
+//   key F CHANNEL TIME VALUE              F is an index, a range first-last, or * for all fixtures
+class LightShow {
+public:
+	int fixtureCount;
+	float length;
+	std::vector<float> values[CHANNEL_COUNT];    /* evaluated channels, padded to a multiple of 4 fixtures */
+
+	LightShow();
+	bool load(const std::string& path);
+	// evaluate every channel of every fixture at the given show time
+	void evaluate(double seconds);
+	// write pan/tilt, color, cone and strobe of the first fixtures into lights (positions and attenuation stay)
+	void apply(std::vector<SpotLight>& lights, float rangeThreshold) const;
+private:
+	struct Track {
+		std::vector<float> times;              /* key times shared by the track's fixtures, ascending */
+		std::vector<int> fixtures;
+		int firstFixture;                      /* results are stored in place from here, -1 to scatter them */
+		int stride;                            /* fixture count padded to the SIMD width */
+		std::vector<float> rows;               /* rows[key * stride + j] for fixtures[j] */
+	};
+	std::vector<Track> tracks[CHANNEL_COUNT];
+	std::vector<float> scratch;                /* interpolated row of a track with scattered fixtures */
+	int paddedCount;
+	double evaluatedTime;                      /* looped time of the last evaluate, for the strobe phase */
+};
@@ -0,0 +1,69 @@
+#include "LightingPass.h"
+
+#include <chrono>
+
+LightingPass::LightingPass(ThreadPool& pool, ShaderVariantCache& shaders)
+	: lightCuller(pool), meshletCuller(pool), shaders(shaders), renderQueue(pool) {
+	shadingModel = ShadingModel::Lambert;
+	ambientLight = glm::vec3(0.0f);
+	baseColor = glm::vec3(0.8f);
+	shininess = 32.0f;
+	specularStrength = 0.5f;
+	meshletMs = 0.0;
+}
+
+void LightingPass::render(const Scene& scene, const std::vector<Mesh*>& meshes, const std::vector<SpotLight>& lights,
+	ShadowAtlas& shadowAtlas, const FrameCamera& camera) {
+	shaders.beginFrame();
+	lightCuller.setLights(lights);
+	lightCuller.cull(scene.worldBounds);
+
+	drawKeys.resize(scene.size());
+	renderQueue.build(scene.size(), [&](int i, std::vector<RenderItem>& bucket) {
+		if (scene.meshes[i] == NO_MESH) {
+			return;
+		}
+		Mesh* mesh = meshes[scene.meshes[i]];
+		const CullBounds& bounds = scene.worldBounds[i];
+		drawKeys[i] = { lightCuller.lightCountFor(i), shadowAtlas.enabled, mesh->hasTexture, shadingModel };
+		float depth = (glm::length(bounds.center - camera.position) - bounds.radius - camera.nearPlane) / (camera.farPlane - camera.nearPlane);
+		bucket.push_back({ RenderQueue::opaqueKey(drawKeys[i].packed(), mesh->textureID, mesh->VAO, depth), (unsigned int)i });
+	});
+	renderQueue.sort();
+
+	for (const RenderItem& item : renderQueue.items()) {
+		int i = (int)item.index;
+		bool firstUse;
+		Shader& program = shaders.get(drawKeys[i], firstUse);
+		program.use();
+		if (firstUse) {
+			// Uniforms shared by all draws go to each program once per frame
+			program.setMat4("view", camera.view);
+			program.setMat4("projection", camera.projection);
+			program.setMat4("viewProjection", camera.viewProjection);
+			program.setMat4("previousViewProjection", camera.previousViewProjection);
+			program.setInt("ourTexture", 0);
+			program.setVec3("baseColor", baseColor);
+			program.setVec3("ambientLight", ambientLight);
+			program.setVec3("viewPos", camera.position);
+			program.setFloat("shininess", shininess);
+			program.setFloat("specularStrength", specularStrength);
+			program.setUniformBlock("SpotLights", SPOTLIGHT_BLOCK_BINDING);
+			shadowAtlas.bind(program, 1);
+		}
+		program.setMat4("model", scene.worldMatrices[i]);
+		program.setMat4("previousModel", scene.previousWorldMatrices[i]);
+		program.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(scene.worldMatrices[i]))));
+		program.setIntArray("lightIndices", lightCuller.lightsFor(i), drawKeys[i].lightCount);
+		Mesh* mesh = meshes[scene.meshes[i]];
+		if (mesh->meshlets.count > 0) {
+			std::chrono::steady_clock::time_point cullStart = std::chrono::steady_clock::now();
+			meshletCuller.cull(mesh->meshlets, scene.worldMatrices[i], camera.viewProjection, camera.position, meshletDraws);
+			meshletMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+			mesh->renderMeshlets(meshletDraws);
+		}
+		else {
+			mesh->render();
+		}
+	}
+}
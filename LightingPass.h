@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Scene.h"
+#include "SpotLight.h"
+#include "ShadowAtlas.h"
+#include "ThreadPool.h"
+#include "LightCuller.h"
+#include "RenderQueue.h"
+#include "Meshlets.h"
+#include "ShaderVariantCache.h"
+
+// Camera state of one frame as the lighting programs see it
+struct FrameCamera {
+	glm::mat4 view;
+	glm::mat4 projection;                  /* what the scene is rasterized with, jittered under temporal AA */
+	glm::mat4 viewProjection;              /* unjittered, for motion vectors and meshlet culling */
+	glm::mat4 previousViewProjection;
+	glm::vec3 position;
+	float nearPlane, farPlane;
+};
+
+// The opaque scene pass: lights are culled against every entity, each draw gets the program variant for the lights
+// that reach it, and draws are sorted by program, texture and mesh, then front to back, before their uniforms are
+// set and they are issued. The main loop and the frame submission microbenchmarks both draw through it.
+class LightingPass {
+public:
+	ShadingModel shadingModel;
+	glm::vec3 ambientLight;
+	glm::vec3 baseColor;                   /* object color of meshes without a texture */
+	float shininess;
+	float specularStrength;
+	double meshletMs;                      /* CPU time of meshlet culling, summed over frames */
+	LightCuller lightCuller;
+	MeshletCuller meshletCuller;
+
+	LightingPass(ThreadPool& pool, ShaderVariantCache& shaders);
+	// draw the scene into the bound framebuffer; the lights come from the SpotLights block at SPOTLIGHT_BLOCK_BINDING
+	void render(const Scene& scene, const std::vector<Mesh*>& meshes, const std::vector<SpotLight>& lights,
+		ShadowAtlas& shadowAtlas, const FrameCamera& camera);
+private:
+	ShaderVariantCache& shaders;
+	RenderQueue renderQueue;
+	std::vector<ShaderKey> drawKeys;
+	MeshletDrawList meshletDraws;
+};
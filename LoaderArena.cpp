@@ -0,0 +1,63 @@
+#include "LoaderArena.h"
+
+#include <new>
+
+LoaderArena::LoaderArena(size_t initialBytes)
+	: block(new unsigned char[initialBytes]), blockSize(initialBytes), used(0), overflowBytes(0), peak(0) {
+}
+
+LoaderArena::~LoaderArena() {
+	reset();
+}
+
+void LoaderArena::reset() {
+	size_t total = used + overflowBytes;
+	if (total > peak) {
+		peak = total;
+	}
+	for (const Overflow& chunk : overflow) {
+		::operator delete(chunk.pointer, chunk.bytes, std::align_val_t(chunk.alignment));
+	}
+	overflow.clear();
+	if (overflowBytes > 0) {
+		// room for everything the last asset asked for, with some slack for a slightly larger one
+		blockSize = total + total / 4;
+		block.reset(new unsigned char[blockSize]);
+	}
+	used = 0;
+	overflowBytes = 0;
+}
+
+size_t LoaderArena::capacity() const {
+	return blockSize;
+}
+
+size_t LoaderArena::peakBytes() const {
+	return peak > used + overflowBytes ? peak : used + overflowBytes;
+}
+
+LoaderArena& LoaderArena::forThisThread() {
+	thread_local LoaderArena arena;
+	return arena;
+}
+
+void* LoaderArena::do_allocate(size_t bytes, size_t alignment) {
+	// new[] blocks are aligned for any fundamental type, so aligning the offset aligns the address
+	size_t start = (used + alignment - 1) & ~(alignment - 1);
+	if (alignment <= alignof(std::max_align_t) && start + bytes <= blockSize) {
+		used = start + bytes;
+		return block.get() + start;
+	}
+	void* pointer = ::operator new(bytes, std::align_val_t(alignment));
+	overflow.push_back({ pointer, bytes, alignment });
+	overflowBytes += bytes;
+	return pointer;
+}
+
+void LoaderArena::do_deallocate(void*, size_t, size_t) {
+	// freed all at once by reset()
+}
+
+bool LoaderArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Scratch memory for the data a loader throws away once an asset is built. Allocations bump a pointer through
+// one block and are never freed one by one; reset() makes the whole block reusable for the next asset. What did
+// not fit goes to the heap until the next reset(), which then grows the block to the peak, so a run of loads
+// settles on no heap traffic at all. Not thread safe: use forThisThread().
+class LoaderArena : public std::pmr::memory_resource {
+public:
+	explicit LoaderArena(size_t initialBytes = 1 << 20);
+	~LoaderArena();
+	// invalidates everything allocated since the last reset
+	void reset();
+	size_t capacity() const;                /* size of the reusable block */
+	size_t peakBytes() const;               /* most bytes one asset has used */
+	// arena of the calling thread, created on first use and kept until the thread exits
+	static LoaderArena& forThisThread();
+private:
+	std::unique_ptr<unsigned char[]> block;
+	size_t blockSize;
+	size_t used;
+	size_t overflowBytes;
+	size_t peak;
+	struct Overflow {
+		void* pointer;
+		size_t bytes;
+		size_t alignment;
+	};
+	std::vector<Overflow> overflow;
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	LoaderArena(const LoaderArena&) = delete;
+	LoaderArena& operator=(const LoaderArena&) = delete;
+};
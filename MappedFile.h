@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file; pages are read in by the OS on first touch, so nothing
+// is copied up front and untouched parts of the file are never read
+class MappedFile {
+public:
+	const unsigned char* data;             /* null when the file could not be mapped */
+	size_t size;
+
+	MappedFile();
+	~MappedFile();
+	bool open(const std::string& path);
+	void close();
+private:
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
@@ -0,0 +1,73 @@
+#include "MemoryReport.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+static double toMiB(size_t bytes) {
+	return bytes / (1024.0 * 1024.0);
+}
+
+void MemoryReport::add(const std::string& kind, const std::string& name, size_t cpuBytes, size_t gpuBytes) {
+	entries.push_back({ kind, name, cpuBytes, gpuBytes });
+}
+
+size_t MemoryReport::totalCpuBytes() const {
+	size_t total = 0;
+	for (const MemoryEntry& entry : entries) {
+		total += entry.cpuBytes;
+	}
+	return total;
+}
+
+size_t MemoryReport::totalGpuBytes() const {
+	size_t total = 0;
+	for (const MemoryEntry& entry : entries) {
+		total += entry.gpuBytes;
+	}
+	return total;
+}
+
+void MemoryReport::print(int maxEntries) const {
+	std::vector<const MemoryEntry*> sorted;
+	for (const MemoryEntry& entry : entries) {
+		sorted.push_back(&entry);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const MemoryEntry* a, const MemoryEntry* b) {
+		return a->cpuBytes + a->gpuBytes > b->cpuBytes + b->gpuBytes;
+	});
+	std::ios_base::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision(2);
+	std::cout << std::fixed << "Memory (MiB):" << std::setw(14) << "CPU" << std::setw(12) << "GPU" << std::endl;
+	for (int i = 0; i < (int)sorted.size() && i < maxEntries; i++) {
+		std::cout << "  " << std::left << std::setw(9) << sorted[i]->kind << std::right << std::setw(14) << toMiB(sorted[i]->cpuBytes)
+			<< std::setw(12) << toMiB(sorted[i]->gpuBytes) << "  " << sorted[i]->name << std::endl;
+	}
+	if ((int)sorted.size() > maxEntries) {
+		std::cout << "  ... " << sorted.size() - maxEntries << " smaller entries" << std::endl;
+	}
+	// totals per kind in the order kinds first appear
+	std::vector<std::string> kinds;
+	for (const MemoryEntry& entry : entries) {
+		if (std::find(kinds.begin(), kinds.end(), entry.kind) == kinds.end()) {
+			kinds.push_back(entry.kind);
+		}
+	}
+	for (const std::string& kind : kinds) {
+		size_t cpu = 0, gpu = 0;
+		int count = 0;
+		for (const MemoryEntry& entry : entries) {
+			if (entry.kind == kind) {
+				cpu += entry.cpuBytes;
+				gpu += entry.gpuBytes;
+				count++;
+			}
+		}
+		std::cout << "  " << std::left << std::setw(9) << "total" << std::right << std::setw(14) << toMiB(cpu) << std::setw(12) << toMiB(gpu)
+			<< "  " << kind << " x" << count << std::endl;
+	}
+	std::cout << "  " << std::left << std::setw(9) << "total" << std::right << std::setw(14) << toMiB(totalCpuBytes()) << std::setw(12)
+		<< toMiB(totalGpuBytes()) << "  everything" << std::endl;
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
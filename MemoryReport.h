@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct MemoryEntry {
+	std::string kind;          /* mesh, texture, shader */
+	std::string name;
+	size_t cpuBytes;
+	size_t gpuBytes;
+};
+
+// CPU and GPU bytes held by resources, gathered on request. GPU sizes are what was handed to the driver
+// (buffers, texture images, program binaries); drivers add padding and mip storage of their own.
+class MemoryReport {
+public:
+	std::vector<MemoryEntry> entries;
+
+	void add(const std::string& kind, const std::string& name, size_t cpuBytes, size_t gpuBytes);
+	size_t totalCpuBytes() const;
+	size_t totalGpuBytes() const;
+	// the largest maxEntries entries, then a total per kind
+	void print(int maxEntries) const;
+};
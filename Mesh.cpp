@@ -1,57 +1,466 @@
 #include "Mesh.h"
+#include "GLState.h"
+#include "LoaderArena.h"
 
-Mesh::Mesh(std::string objectPath, std::string texturePath) {
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
+
+// The single-header libraries are compiled here only, so any file may include Mesh.h
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+Mesh::Mesh(std::string objectPath, std::string texturePath, bool upload)
+	: textureID(0), VAO(0), residency(MeshResidency::Full), bufferBytes(0), textureBytes(0), VBO(0), drawMode(GL_TRIANGLES), indexCount(0), indexType(GL_UNSIGNED_INT), indexOffset(0) {
 	loadVertices(objectPath);
+	vertexCount = (GLsizei)vertices.size();
+	computeBounds();
 	loadTexture(texturePath);
+	if (!upload) {
+		return;
+	}
 	setupMeshVertices();
 	setupMeshTexture();
 }
 
-/* Load an .obj file into a vector containing vertices' attributes */
+/* Element arrays are read tightly packed; every index has to name one of the vertexCount vertices */
+static bool gltfIndicesInRange(const GltfAsset::Accessor& indices, const GltfAsset::BufferView& view, int vertexCount) {
+	size_t size = indices.componentType == GL_UNSIGNED_BYTE ? 1 : indices.componentType == GL_UNSIGNED_SHORT ? 2
+		: indices.componentType == GL_UNSIGNED_INT ? 4 : 0;
+	if (size == 0 || indices.components != 1 || (view.stride != 0 && (size_t)view.stride != size) || indices.offset % size != 0) {
+		return false;
+	}
+	// the accessor's extent was checked against the view when the asset was parsed
+	const unsigned char* data = view.data + indices.offset;
+	for (int i = 0; i < indices.count; i++) {
+		unsigned int index = 0;
+		if (size == 1) {
+			index = data[i];
+		}
+		else if (size == 2) {
+			unsigned short value;
+			std::memcpy(&value, data + i * size, size);
+			index = value;
+		}
+		else {
+			std::memcpy(&index, data + i * size, size);
+		}
+		if (index >= (unsigned int)vertexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Upload the primitive's buffer views unchanged and describe their layout to the vertex array */
+Mesh::Mesh(GltfAsset& asset, int meshIndex, int primitiveIndex)
+	: textureID(0), hasTexture(false), boundsCenter(0.0f), boundsRadius(0.0f), VAO(0), texData(nullptr), residency(MeshResidency::GpuOnly),
+	bufferBytes(0), textureBytes(0), VBO(0),
+	drawMode(GL_TRIANGLES), vertexCount(0), indexCount(0), indexType(GL_UNSIGNED_INT), indexOffset(0) {
+	glGenVertexArrays(1, &VAO);
+	if (!asset.loaded || meshIndex < 0 || meshIndex >= (int)asset.meshes.size()
+		|| primitiveIndex < 0 || primitiveIndex >= (int)asset.meshes[meshIndex].size()) {
+		std::cout << "ERROR::MESH::NO_SUCH_GLTF_PRIMITIVE: " << meshIndex << "/" << primitiveIndex << std::endl;
+		return;
+	}
+	const GltfAsset::Primitive& primitive = asset.meshes[meshIndex][primitiveIndex];
+	drawMode = primitive.mode;
+
+	glState.bindVertexArray(VAO);
+	if (primitive.position < 0 || !setupGltfAttribute(asset, primitive.position, 0)) {
+		std::cout << "ERROR::MESH::GLTF_PRIMITIVE_WITHOUT_POSITIONS: " << meshIndex << "/" << primitiveIndex << std::endl;
+		return;
+	}
+	const GltfAsset::Accessor& positions = asset.accessors[primitive.position];
+	vertexCount = positions.count;
+	if (primitive.normal < 0 || !setupGltfAttribute(asset, primitive.normal, 1)) {
+		// Flat shading from straight above until the asset provides normals. A single normal advanced per instance
+		// reads the same value for every vertex of a plain draw, and unlike glVertexAttrib it is vertex array state.
+		static const float up[3] = { 0.0f, 1.0f, 0.0f };
+		glBindBuffer(GL_ARRAY_BUFFER, shareGltfBuffer(asset.flatNormalBuffer, up, sizeof(up)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glVertexAttribDivisor(1, 1);
+		glEnableVertexAttribArray(1);
+	}
+	bool hasTexcoord = primitive.texcoord >= 0 && setupGltfAttribute(asset, primitive.texcoord, 2);
+
+	if (primitive.indices >= 0) {
+		const GltfAsset::Accessor& indices = asset.accessors[primitive.indices];
+		if (indices.bufferView < 0 || !asset.bufferViews[indices.bufferView].data
+			|| !gltfIndicesInRange(indices, asset.bufferViews[indices.bufferView], vertexCount)) {
+			// drawing the vertices unindexed would be a different shape, so draw nothing
+			std::cout << "ERROR::MESH::INVALID_GLTF_INDICES: " << meshIndex << "/" << primitiveIndex << std::endl;
+			vertexCount = 0;
+			return;
+		}
+		const GltfAsset::BufferView& view = asset.bufferViews[indices.bufferView];
+		// recorded in the bound vertex array
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shareGltfBuffer(asset.viewBuffers[indices.bufferView], view.data, view.length));
+		indexCount = indices.count;
+		indexType = indices.componentType;
+		indexOffset = indices.offset;
+	}
+
+	// Bounds come from the accessor's min/max; the box's half diagonal keeps the sphere conservative
+	if (positions.hasBounds) {
+		boundsCenter = (positions.min + positions.max) * 0.5f;
+		boundsRadius = glm::length(positions.max - positions.min) * 0.5f;
+	}
+
+	int material = primitive.material;
+	int image = material >= 0 && material < (int)asset.materialImages.size() ? asset.materialImages[material] : -1;
+	if (hasTexcoord && image >= 0 && image < asset.imageCount()) {
+		const GltfImage& pixels = asset.image(image);
+		if (pixels.pixels) {
+			static const GLenum formats[] = { GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+			GLenum format = formats[std::min(std::max(pixels.channels, 1), 4)];
+			glGenTextures(1, &textureID);
+			glState.bindTexture(0, textureID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			// decoded rows are tightly packed whatever the channel count
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, pixels.width, pixels.height, 0, format, GL_UNSIGNED_BYTE, pixels.pixels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			textureBytes = (size_t)pixels.width * pixels.height * std::min(std::max(pixels.channels, 1), 4);
+			hasTexture = true;
+		}
+	}
+}
+
+/* Upload a buffer of the asset the first time any of its primitives uses it; later meshes take a reference */
+unsigned int Mesh::shareGltfBuffer(std::shared_ptr<unsigned int>& shared, const void* data, size_t length) {
+	if (!shared) {
+		unsigned int* buffer = new unsigned int(0);
+		glGenBuffers(1, buffer);
+		// not vertex array state, so the upload does not disturb the bound vertex array
+		glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+		glBufferData(GL_ARRAY_BUFFER, length, data, GL_STATIC_DRAW);
+		shared.reset(buffer, [](unsigned int* name) {
+			glDeleteBuffers(1, name);
+			delete name;
+		});
+		bufferBytes += length;
+	}
+	if (std::find(sharedBuffers.begin(), sharedBuffers.end(), shared) == sharedBuffers.end()) {
+		sharedBuffers.push_back(shared);
+	}
+	return *shared;
+}
+
+/* Point a vertex attribute at an accessor, uploading its buffer view the first time the asset uses it. Interleaved
+   and separate layouts both map directly onto the view's stride and the accessor's offset. */
+bool Mesh::setupGltfAttribute(GltfAsset& asset, int accessor, unsigned int location) {
+	if (accessor < 0 || accessor >= (int)asset.accessors.size()) {
+		return false;
+	}
+	const GltfAsset::Accessor& source = asset.accessors[accessor];
+	if (source.bufferView < 0 || !asset.bufferViews[source.bufferView].data) {
+		return false;
+	}
+	// attributes shorter than the positions would be read past their end
+	if (location != 0 && source.count < vertexCount) {
+		return false;
+	}
+	const GltfAsset::BufferView& view = asset.bufferViews[source.bufferView];
+	glBindBuffer(GL_ARRAY_BUFFER, shareGltfBuffer(asset.viewBuffers[source.bufferView], view.data, view.length));
+	glVertexAttribPointer(location, source.components, source.componentType, source.normalized ? GL_TRUE : GL_FALSE,
+		view.stride, (void*)source.offset);
+	glEnableVertexAttribArray(location);
+	return true;
+}
+
+namespace {
+	// Transient state of one OBJ parse; every array lives in the loader arena
+	struct ObjParse {
+		std::pmr::vector<glm::vec3> positions;
+		std::pmr::vector<glm::vec3> normals;
+		std::pmr::vector<glm::vec2> texcoords;
+		std::pmr::vector<tinyobj::index_t> corners;   /* three per triangle, resolved to 0-based, -1 when absent */
+		std::pmr::vector<tinyobj::index_t> polygon;   /* corners of the face being triangulated */
+		bool firstShapeDone;                          /* faces after the first 'o' or 'g' that follows faces */
+
+		explicit ObjParse(std::pmr::memory_resource* arena)
+			: positions(arena), normals(arena), texcoords(arena), corners(arena), polygon(arena), firstShapeDone(false) {
+		}
+		// OBJ indices are 1-based, negative ones count back from the latest element and 0 means absent
+		static int resolve(int index, size_t count) {
+			if (index > 0) {
+				return index <= (int)count ? index - 1 : -1;
+			}
+			if (index < 0) {
+				return (int)count + index >= 0 ? (int)count + index : -1;
+			}
+			return -1;
+		}
+		tinyobj::index_t resolve(const tinyobj::index_t& raw) const {
+			tinyobj::index_t index;
+			index.vertex_index = resolve(raw.vertex_index, positions.size());
+			index.normal_index = resolve(raw.normal_index, normals.size());
+			index.texcoord_index = resolve(raw.texcoord_index, texcoords.size());
+			return index;
+		}
+		void endShape() {
+			if (!corners.empty()) {
+				firstShapeDone = true;
+			}
+		}
+		void triangle(size_t a, size_t b, size_t c) {
+			corners.push_back(polygon[a]);
+			corners.push_back(polygon[b]);
+			corners.push_back(polygon[c]);
+		}
+		// position of a corner projected onto two axes; tinyobj reads a missing position as the origin
+		void planar(const tinyobj::index_t& corner, const int axes[2], float& x, float& y) const {
+			x = corner.vertex_index >= 0 ? positions[corner.vertex_index][axes[0]] : 0.0f;
+			y = corner.vertex_index >= 0 ? positions[corner.vertex_index][axes[1]] : 0.0f;
+		}
+		void addFace(const tinyobj::index_t* indices, int count);
+		void earClip();
+	};
+
+	/* Triangulate a face exactly as tinyobj::LoadObj does, so assets keep the triangles they had: quads are split
+	   along their shorter diagonal and larger polygons are ear clipped */
+	void ObjParse::addFace(const tinyobj::index_t* indices, int count) {
+		if (count < 3) {
+			return;
+		}
+		polygon.clear();
+		for (int i = 0; i < count; i++) {
+			polygon.push_back(resolve(indices[i]));
+		}
+		if (count == 3) {
+			triangle(0, 1, 2);
+			return;
+		}
+		if (count == 4) {
+			for (const tinyobj::index_t& corner : polygon) {
+				if (corner.vertex_index < 0) {
+					return;
+				}
+			}
+			glm::vec3 diagonal02 = positions[polygon[2].vertex_index] - positions[polygon[0].vertex_index];
+			glm::vec3 diagonal13 = positions[polygon[3].vertex_index] - positions[polygon[1].vertex_index];
+			if (glm::dot(diagonal02, diagonal02) < glm::dot(diagonal13, diagonal13)) {
+				triangle(0, 1, 2);
+				triangle(0, 2, 3);
+			}
+			else {
+				triangle(0, 1, 3);
+				triangle(1, 2, 3);
+			}
+			return;
+		}
+		earClip();
+	}
+
+	/* tinyobj's built-in ear clipping, in the plane of the two axes its first non-degenerate corner spans most */
+	void ObjParse::earClip() {
+		int axes[2] = { 1, 2 };
+		size_t count = polygon.size();
+		for (size_t k = 0; k < count; k++) {
+			const tinyobj::index_t& i0 = polygon[k];
+			const tinyobj::index_t& i1 = polygon[(k + 1) % count];
+			const tinyobj::index_t& i2 = polygon[(k + 2) % count];
+			if (i0.vertex_index < 0 || i1.vertex_index < 0 || i2.vertex_index < 0) {
+				continue;
+			}
+			glm::vec3 edge0 = positions[i1.vertex_index] - positions[i0.vertex_index];
+			glm::vec3 edge1 = positions[i2.vertex_index] - positions[i1.vertex_index];
+			glm::vec3 normal = glm::abs(glm::cross(edge0, edge1));
+			const float epsilon = std::numeric_limits<float>::epsilon();
+			if (normal.x > epsilon || normal.y > epsilon || normal.z > epsilon) {
+				if (!(normal.x > normal.y && normal.x > normal.z)) {
+					axes[0] = 0;
+					if (normal.z > normal.x && normal.z > normal.y) {
+						axes[1] = 1;
+					}
+				}
+				break;
+			}
+		}
+
+		// give up on a polygon once a full lap finds no ear
+		size_t guess = 0;
+		size_t remainingIterations = count;
+		size_t previousCount = count;
+		while (polygon.size() > 3 && remainingIterations > 0) {
+			size_t n = polygon.size();
+			if (guess >= n) {
+				guess -= n;
+			}
+			if (previousCount != n) {
+				previousCount = n;
+				remainingIterations = n;
+			}
+			else {
+				remainingIterations--;
+			}
+			float vx[3], vy[3];
+			for (size_t k = 0; k < 3; k++) {
+				planar(polygon[(guess + k) % n], axes, vx[k], vy[k]);
+			}
+			// tinyobj's convexity test, kept as it is so the same corners are clipped
+			float cross = (vx[1] - vx[0]) * (vy[2] - vy[1]) - (vy[1] - vy[0]) * (vx[2] - vx[1]);
+			float area = (vx[0] * vy[1] - vy[0] * vx[1]) * 0.5f;
+			if (cross * area < 0.0f) {
+				guess++;
+				continue;
+			}
+			bool overlap = false;
+			for (size_t other = 3; other < n && !overlap; other++) {
+				const tinyobj::index_t& corner = polygon[(guess + other) % n];
+				if (corner.vertex_index < 0) {
+					continue;
+				}
+				float tx, ty;
+				planar(corner, axes, tx, ty);
+				overlap = tinyobj::pnpoly(3, vx, vy, tx, ty) != 0;
+			}
+			if (overlap) {
+				guess++;
+				continue;
+			}
+			triangle(guess % n, (guess + 1) % n, (guess + 2) % n);
+			polygon.erase(polygon.begin() + (guess + 1) % n);
+		}
+		if (polygon.size() == 3) {
+			triangle(0, 1, 2);
+		}
+	}
+}
+
+/* Parse an .obj file into a vector containing vertices' attributes. Everything but the vertices is scratch in the
+   calling thread's loader arena, so loading one asset after another does not go back to the heap. */
 void Mesh::loadVertices(std::string objectPath) {
-	std::string warn, err;
-	bool bTriangulate = true;
-	bool bSuc = tinyobj::LoadObj(&obj.attrib, &obj.shapes, &obj.materials,
-		&warn, &err, objectPath.c_str(), nullptr, bTriangulate);
-	if (!bSuc)
-	{
-		std::cout << "tinyobj error: " << err.c_str() << std::endl;
+	std::ifstream file(objectPath, std::ios::binary);
+	if (!file) {
+		std::cout << "tinyobj error: cannot open file [" << objectPath << "]" << std::endl;
 		return;
 	}
+	LoaderArena& arena = LoaderArena::forThisThread();
+	arena.reset();
+	{
+		ObjParse parse(&arena);
+		tinyobj::callback_t callback;
+		callback.vertex_cb = [](void* data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t) {
+			((ObjParse*)data)->positions.emplace_back(x, y, z);
+		};
+		callback.normal_cb = [](void* data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z) {
+			((ObjParse*)data)->normals.emplace_back(x, y, z);
+		};
+		callback.texcoord_cb = [](void* data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t) {
+			((ObjParse*)data)->texcoords.emplace_back(x, y);
+		};
+		callback.index_cb = [](void* data, tinyobj::index_t* indices, int count) {
+			ObjParse& parse = *(ObjParse*)data;
+			if (!parse.firstShapeDone) {
+				parse.addFace(indices, count);
+			}
+		};
+		// only the first shape is kept, as before
+		callback.group_cb = [](void* data, const char**, int) { ((ObjParse*)data)->endShape(); };
+		callback.object_cb = [](void* data, const char*) { ((ObjParse*)data)->endShape(); };
 
-	for (auto face : obj.shapes[0].mesh.indices) {
-		int vid = face.vertex_index;
-		int nid = face.normal_index;
-		int tid = face.texcoord_index;
+		std::string warn, err;
+		if (!tinyobj::LoadObjWithCallback(file, callback, &parse, nullptr, &warn, &err)) {
+			std::cout << "tinyobj error: " << err.c_str() << std::endl;
+		}
+		else {
+			// sized from the triangulated index count, so the vertices are allocated once
+			vertices.reserve(vertices.size() + parse.corners.size());
+			for (const tinyobj::index_t& corner : parse.corners) {
+				Vertex vertex = {};
+				if (corner.vertex_index >= 0) {
+					vertex.position = parse.positions[corner.vertex_index];
+				}
+				if (corner.normal_index >= 0) {
+					vertex.normal = parse.normals[corner.normal_index];
+				}
+				if (corner.texcoord_index >= 0) {
+					vertex.texture = parse.texcoords[corner.texcoord_index];
+				}
+				vertices.push_back(vertex);
+			}
+		}
+	}
+	arena.reset();
+}
 
-		Vertex vertex = {};
-		vertex.position = glm::vec3(obj.attrib.vertices[vid * 3], obj.attrib.vertices[vid * 3 + 1], obj.attrib.vertices[vid * 3 + 2]);
-		vertex.normal = glm::vec3(obj.attrib.normals[nid * 3], obj.attrib.normals[nid * 3 + 1], obj.attrib.normals[nid * 3 + 2]);
-		vertex.texture = glm::vec2(obj.attrib.texcoords[tid * 2], obj.attrib.texcoords[tid * 2 + 1]);
-		vertices.push_back(vertex);
+/* Bounding sphere around the axis-aligned box of the vertices */
+void Mesh::computeBounds() {
+	boundsCenter = glm::vec3(0.0f);
+	boundsRadius = 0.0f;
+	if (vertices.empty()) {
+		return;
+	}
+	glm::vec3 minCorner = vertices[0].position;
+	glm::vec3 maxCorner = vertices[0].position;
+	for (const Vertex& vertex : vertices) {
+		minCorner = glm::min(minCorner, vertex.position);
+		maxCorner = glm::max(maxCorner, vertex.position);
+	}
+	boundsCenter = (minCorner + maxCorner) * 0.5f;
+	for (const Vertex& vertex : vertices) {
+		boundsRadius = glm::max(boundsRadius, glm::length(vertex.position - boundsCenter));
 	}
 }
 
-/* Load texture from file */
+/* Load texture from file; an empty path leaves the mesh untextured */
 void Mesh::loadTexture(std::string texturePath) {
+	texData = nullptr;
+	hasTexture = false;
+	texWidth = texHeight = texNrChannels = 0;
+	if (texturePath.empty()) {
+		return;
+	}
 	stbi_set_flip_vertically_on_load(true);
 	texData = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texNrChannels, 0);
+	hasTexture = texData != nullptr;
 	if (!texData) {
 		std::cout << "Failed to load texture " << texturePath << std::endl;
 		return;
 	}
 }
 
+glm::vec3 Mesh::sampleTexture(const glm::vec2& uv) const {
+	float u = uv.x * texWidth - 0.5f, v = uv.y * texHeight - 0.5f;
+	float x0 = std::floor(u), y0 = std::floor(v);
+	float fx = u - x0, fy = v - y0;
+	glm::vec3 texels[4];
+	for (int i = 0; i < 4; i++) {
+		int x = ((int)x0 + (i & 1)) % texWidth;
+		int y = ((int)y0 + (i >> 1)) % texHeight;
+		x += x < 0 ? texWidth : 0;
+		y += y < 0 ? texHeight : 0;
+		const unsigned char* p = texData + ((size_t)y * texWidth + x) * texNrChannels;
+		texels[i] = texNrChannels >= 3 ? glm::vec3(p[0], p[1], p[2]) : glm::vec3(p[0]);
+	}
+	glm::vec3 bottom = glm::mix(texels[0], texels[1], fx);
+	glm::vec3 top = glm::mix(texels[2], texels[3], fx);
+	return glm::mix(bottom, top, fy) * (1.0f / 255.0f);
+}
+
 /* Create vertex buffers and pass data to vertex shader */
 void Mesh::setupMeshVertices() {
 	// Create buffers
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
 
-	glBindVertexArray(VAO);
+	glState.bindVertexArray(VAO);
 	// Pass vertices data to vertex buffers
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	bufferBytes = vertices.size() * sizeof(Vertex);
 
 	// Set vertex position in vertex shader
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -67,23 +476,183 @@ void Mesh::setupMeshVertices() {
 }
 
 void Mesh::setupMeshTexture() {
+	if (!texData) {
+		return;
+	}
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	glState.bindTexture(0, textureID);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, texData);
+	textureBytes = (size_t)texWidth * texHeight * 3;
 	stbi_image_free(texData);
+	texData = nullptr;
+}
+
+bool Mesh::buildMeshlets() {
+	if (vertices.empty()) {
+		return false;
+	}
+	// identical corners of neighbouring faces become one indexed vertex
+	struct VertexHash {
+		size_t operator()(const Vertex& v) const {
+			const unsigned int* words = (const unsigned int*)&v;
+			size_t hash = 2166136261u;
+			for (size_t i = 0; i < sizeof(Vertex) / sizeof(unsigned int); i++) {
+				hash = (hash ^ words[i]) * 16777619u;
+			}
+			return hash;
+		}
+	};
+	struct VertexEqual {
+		bool operator()(const Vertex& a, const Vertex& b) const {
+			return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+		}
+	};
+	std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> welded;
+	std::vector<Vertex> unique;
+	indices.clear();
+	indices.reserve(vertices.size());
+	for (const Vertex& vertex : vertices) {
+		auto inserted = welded.emplace(vertex, (unsigned int)unique.size());
+		if (inserted.second) {
+			unique.push_back(vertex);
+		}
+		indices.push_back(inserted.first->second);
+	}
+
+	std::vector<glm::vec3> positions(unique.size());
+	for (size_t i = 0; i < unique.size(); i++) {
+		positions[i] = unique[i].position;
+	}
+	meshlets.build(positions, indices);
+
+	vertices.swap(unique);
+	vertexCount = (GLsizei)vertices.size();
+	glState.bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	viewBuffers.push_back(buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	indexCount = (GLsizei)indices.size();
+	indexType = GL_UNSIGNED_INT;
+	indexOffset = 0;
+	bufferBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+	return true;
+}
+
+void Mesh::renderMeshlets(const MeshletDrawList& draws) {
+	if (draws.counts.empty()) {
+		return;
+	}
+	glState.bindTexture(0, textureID);
+	glState.bindVertexArray(VAO);
+	glMultiDrawElements(drawMode, draws.counts.data(), GL_UNSIGNED_INT, draws.offsets.data(), (GLsizei)draws.counts.size());
 }
 
 void Mesh::render() {
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+	glState.bindTexture(0, textureID);
+	glState.bindVertexArray(VAO);
+	if (indexCount > 0) {
+		glDrawElements(drawMode, indexCount, indexType, (void*)indexOffset);
+	}
+	else {
+		glDrawArrays(drawMode, 0, vertexCount);
+	}
+}
+
+void Mesh::setResidency(MeshResidency newResidency) {
+	if (newResidency >= residency) {
+		return;
+	}
+	if (newResidency == MeshResidency::Compact) {
+		// weld corners at the same position; normals and texture coordinates are what made them distinct
+		struct PositionHash {
+			size_t operator()(const glm::vec3& position) const {
+				// -0 and +0 are equal under the map's ==, so both must hash as +0
+				glm::vec3 p = position + glm::vec3(0.0f);
+				unsigned int words[3];
+				std::memcpy(words, &p, sizeof(words));
+				return ((size_t)words[0] * 73856093u) ^ ((size_t)words[1] * 19349663u) ^ ((size_t)words[2] * 83492791u);
+			}
+		};
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> welded;
+		std::vector<unsigned int> compactVertex(vertices.size());
+		compactPositions.clear();
+		for (size_t i = 0; i < vertices.size(); i++) {
+			auto inserted = welded.emplace(vertices[i].position, (unsigned int)compactPositions.size());
+			if (inserted.second) {
+				compactPositions.push_back(vertices[i].position);
+			}
+			compactVertex[i] = inserted.first->second;
+		}
+		compactPositions.shrink_to_fit();
+		// after buildMeshlets() the vertices are unique and the triangles are in the index list
+		compactIndices.clear();
+		if (indices.empty()) {
+			compactIndices = compactVertex;
+		}
+		else {
+			compactIndices.reserve(indices.size());
+			for (unsigned int index : indices) {
+				compactIndices.push_back(compactVertex[index]);
+			}
+		}
+		if (compactIndices.size() != 3 * (size_t)triangleCount()) {
+			std::cout << "ERROR::MESH::COMPACT_TRIANGLES_MISMATCH: " << compactIndices.size() / 3 << " triangles, drawn with "
+				<< triangleCount() << std::endl;
+		}
+	}
+	else {
+		std::vector<glm::vec3>().swap(compactPositions);
+		std::vector<unsigned int>().swap(compactIndices);
+	}
+	std::vector<Vertex>().swap(vertices);
+	std::vector<unsigned int>().swap(indices);
+	residency = newResidency;
+}
+
+int Mesh::triangleCount() const {
+	return (indexCount > 0 ? indexCount : vertexCount) / 3;
+}
+
+size_t Mesh::cpuBytes() const {
+	size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+	bytes += compactPositions.capacity() * sizeof(glm::vec3) + compactIndices.capacity() * sizeof(unsigned int);
+	bytes += meshlets.cpuBytes();
+	return bytes;
+}
+
+size_t Mesh::textureCpuBytes() const {
+	return texData ? (size_t)texWidth * texHeight * texNrChannels : 0;
 }
 
 void Mesh::deleteBuffers() {
+	if (texData) {
+		stbi_image_free(texData);
+		texData = nullptr;
+	}
+	if (VAO == 0) {
+		return;
+	}
 	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
+	if (VBO != 0) {
+		glDeleteBuffers(1, &VBO);
+	}
+	if (!viewBuffers.empty()) {
+		glDeleteBuffers((GLsizei)viewBuffers.size(), viewBuffers.data());
+		viewBuffers.clear();
+	}
+	// the last primitive of an asset to let go deletes the buffer
+	sharedBuffers.clear();
+	glState.vertexArrayDeleted(VAO);
+	if (textureID != 0) {
+		glDeleteTextures(1, &textureID);
+		glState.textureDeleted(textureID);
+	}
 }
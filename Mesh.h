@@ -5,17 +5,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glad/glad.h>
 #include <iostream>
+#include <memory>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "GltfAsset.h"
+#include "Meshlets.h"
 
-struct Object {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
+// What a mesh keeps on the CPU once it is on the GPU
+enum class MeshResidency {
+	GpuOnly,                  /* nothing; render() only needs the GPU copy */
+	Compact,                  /* welded positions and triangle indices, for picking and collision */
+	Full                      /* the vertices, for editing; what a new mesh keeps */
 };
 
 struct Vertex {
@@ -26,21 +26,57 @@ struct Vertex {
 
 class Mesh {
 public:
-	std::vector<Vertex> vertices;          /* a collection of vertices */
+	std::vector<Vertex> vertices;          /* a collection of vertices (OBJ only; glTF data stays on the GPU) */
+	std::vector<unsigned int> indices;     /* three per triangle into vertices once buildMeshlets() welded them, else empty */
 	unsigned int textureID;                /* the mesh's texture ID    */
+	bool hasTexture;                       /* false when the image failed to load */
+	glm::vec3 boundsCenter;                /* bounding sphere in object space */
+	float boundsRadius;
+	unsigned int VAO;                      /* vertex array, part of the draw sort key */
+	MeshletSet meshlets;                   /* empty unless buildMeshlets() was called */
+	int texWidth, texHeight, texNrChannels; /* texture props */
+	unsigned char* texData;                 /* decoded texture, kept in memory only for meshes that are not uploaded */
+	MeshResidency residency;
+	std::vector<glm::vec3> compactPositions;  /* Compact residency: positions shared by the triangles */
+	std::vector<unsigned int> compactIndices; /* Compact residency: three per triangle */
+	size_t bufferBytes;                     /* GPU memory of the buffers this mesh created; shared glTF views count once */
+	size_t textureBytes;                    /* GPU memory of the texture */
 	
-	Mesh(std::string objectPath, std::string texturePath);
+	// upload = false keeps the vertices and decoded texture on the CPU without touching OpenGL
+	Mesh(std::string objectPath, std::string texturePath, bool upload = true);
+	// one primitive of a glTF mesh; its buffer views are uploaded as stored in the file
+	Mesh(GltfAsset& asset, int meshIndex, int primitiveIndex);
 	void render();
+	// bilinear, repeating lookup in texData like the GPU sampler; only for meshes loaded with upload = false
+	glm::vec3 sampleTexture(const glm::vec2& uv) const;
+	// weld the OBJ vertices into an indexed mesh and cluster its triangles for culling (OBJ meshes only)
+	bool buildMeshlets();
+	// draw only the index ranges that survived MeshletCuller::cull
+	void renderMeshlets(const MeshletDrawList& draws);
+	// Release the CPU copies the residency does not keep (OBJ meshes only). Released data is not reloaded, so
+	// residency only goes down: Full, then Compact, then GpuOnly.
+	void setResidency(MeshResidency residency);
+	int triangleCount() const;
+	size_t cpuBytes() const;                /* vertices and indices, compact copy and meshlets */
+	size_t textureCpuBytes() const;         /* decoded texture still in memory */
 	void deleteBuffers();
+	// parse an .obj file and append its first shape to vertices; public so the load can be timed on its own
+	void loadVertices(std::string objectPath);
 private:
-	Object obj;                             /* object loaded from file  */
-	int texWidth, texHeight, texNrChannels; /* texture props */
-	unsigned char* texData;                 /* texture data */
-	unsigned int VAO, VBO;
+	unsigned int VBO;
+	std::vector<unsigned int> viewBuffers; /* further buffers: index buffer of welded meshes */
+	std::vector<std::shared_ptr<unsigned int>> sharedBuffers;  /* glTF buffer views, owned with the other primitives */
+	GLenum drawMode;
+	GLsizei vertexCount;                   /* vertices drawn without an index buffer */
+	GLsizei indexCount;                    /* 0 when not indexed */
+	GLenum indexType;
+	size_t indexOffset;
 	void setupMeshVertices();
 	void setupMeshTexture();
-	void loadVertices(std::string objectPath);
 	void loadTexture(std::string texturePath);
+	void computeBounds();
+	bool setupGltfAttribute(GltfAsset& asset, int accessor, unsigned int location);
+	unsigned int shareGltfBuffer(std::shared_ptr<unsigned int>& shared, const void* data, size_t length);
 };
 
 
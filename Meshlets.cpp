@@ -0,0 +1,230 @@
+#include "Meshlets.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+// Clusters per culling batch; batches are the unit of work handed to the thread pool
+static const int MESHLET_BATCH = 1024;
+
+MeshletSet::MeshletSet() {
+	count = 0;
+}
+
+void MeshletSet::clear() {
+	count = 0;
+	centerX.clear(); centerY.clear(); centerZ.clear(); radius.clear();
+	axisX.clear(); axisY.clear(); axisZ.clear(); cutoff.clear();
+	firstIndex.clear(); indexCount.clear();
+}
+
+size_t MeshletSet::cpuBytes() const {
+	return (centerX.capacity() + centerY.capacity() + centerZ.capacity() + radius.capacity()
+		+ axisX.capacity() + axisY.capacity() + axisZ.capacity() + cutoff.capacity()) * sizeof(float)
+		+ (firstIndex.capacity() + indexCount.capacity()) * sizeof(unsigned int);
+}
+
+/* Greedy clustering: triangles are taken in order until the next one would exceed either limit. OBJ and glTF
+   exporters keep neighbouring faces close in the index buffer, so clusters come out spatially compact. */
+void MeshletSet::build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+	clear();
+	std::vector<int> stamp(positions.size(), -1);     /* cluster that last counted the vertex */
+	int triangleCount = (int)(indices.size() / 3);
+
+	auto finish = [&](int firstTriangle, int endTriangle) {
+		glm::vec3 minCorner(INFINITY), maxCorner(-INFINITY);
+		for (int k = firstTriangle * 3; k < endTriangle * 3; k++) {
+			minCorner = glm::min(minCorner, positions[indices[k]]);
+			maxCorner = glm::max(maxCorner, positions[indices[k]]);
+		}
+		glm::vec3 center = (minCorner + maxCorner) * 0.5f;
+		float sphere = 0.0f;
+		glm::vec3 normalSum(0.0f);
+		for (int t = firstTriangle; t < endTriangle; t++) {
+			const glm::vec3& a = positions[indices[t * 3]];
+			const glm::vec3& b = positions[indices[t * 3 + 1]];
+			const glm::vec3& c = positions[indices[t * 3 + 2]];
+			sphere = std::max(sphere, std::max(glm::length(a - center), std::max(glm::length(b - center), glm::length(c - center))));
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normalSum += normal / length;
+			}
+		}
+
+		// The cone spread is the widest angle between the axis and a triangle normal; from 90 degrees on
+		// some triangle always faces the camera, so the cluster is never back-facing
+		float spread = 1.0f;
+		float axisLength = glm::length(normalSum);
+		glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+		if (axisLength > 0.0f) {
+			float minDot = 1.0f;
+			for (int t = firstTriangle; t < endTriangle; t++) {
+				const glm::vec3& a = positions[indices[t * 3]];
+				glm::vec3 normal = glm::cross(positions[indices[t * 3 + 1]] - a, positions[indices[t * 3 + 2]] - a);
+				float length = glm::length(normal);
+				if (length > 0.0f) {
+					minDot = std::min(minDot, glm::dot(axis, normal / length));
+				}
+			}
+			spread = minDot > 0.0f ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+		}
+
+		centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+		radius.push_back(sphere);
+		axisX.push_back(axis.x); axisY.push_back(axis.y); axisZ.push_back(axis.z);
+		cutoff.push_back(spread);
+		firstIndex.push_back((unsigned int)firstTriangle * 3);
+		indexCount.push_back((unsigned int)(endTriangle - firstTriangle) * 3);
+		count++;
+	};
+
+	int first = 0;
+	int vertexCount = 0;
+	for (int t = 0; t < triangleCount; t++) {
+		int added = 0;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices[t * 3 + k];
+			bool repeated = (k > 0 && indices[t * 3] == v) || (k > 1 && indices[t * 3 + 1] == v);
+			added += stamp[v] != count && !repeated ? 1 : 0;
+		}
+		if (t > first && (vertexCount + added > MESHLET_MAX_VERTICES || t - first >= MESHLET_MAX_TRIANGLES)) {
+			finish(first, t);
+			first = t;
+			vertexCount = 0;
+			added = 0;
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+				bool repeated = (k > 0 && indices[t * 3] == v) || (k > 1 && indices[t * 3 + 1] == v);
+				added += repeated ? 0 : 1;
+			}
+		}
+		for (int k = 0; k < 3; k++) {
+			stamp[indices[t * 3 + k]] = count;
+		}
+		vertexCount += added;
+	}
+	if (triangleCount > first) {
+		finish(first, triangleCount);
+	}
+
+	// pad the arrays for whole SIMD loads
+	size_t padded = (count + 3) & ~3;
+	for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &radius, &axisX, &axisY, &axisZ, &cutoff }) {
+		array->resize(padded, 0.0f);
+	}
+}
+
+MeshletCuller::MeshletCuller(ThreadPool& pool) : pool(pool) {
+	parallelThreshold = 4 * MESHLET_BATCH;
+	testedCount = 0;
+	visibleCount = 0;
+}
+
+void MeshletCuller::cull(const MeshletSet& meshlets, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+	MeshletDrawList& out) {
+	out.counts.clear();
+	out.offsets.clear();
+	out.visibleCount = 0;
+	if (meshlets.count == 0) {
+		return;
+	}
+
+	// Frustum planes of the combined matrix are the view frustum in object space (Gribb-Hartmann)
+	glm::mat4 m = viewProjection * model;
+	float planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		int row = p / 2;
+		float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+		glm::vec4 plane;
+		for (int c = 0; c < 4; c++) {
+			plane[c] = m[c][3] + sign * m[c][row];
+		}
+		float length = glm::length(glm::vec3(plane));
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = length > 0.0f ? plane[c] / length : 0.0f;
+		}
+	}
+	glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+	float scaleX = glm::length(glm::vec3(model[0]));
+	float scaleY = glm::length(glm::vec3(model[1]));
+	float scaleZ = glm::length(glm::vec3(model[2]));
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	bool coneTest = maxScale - std::min(scaleX, std::min(scaleY, scaleZ)) <= 1e-3f * maxScale;
+
+	int batches = (meshlets.count + MESHLET_BATCH - 1) / MESHLET_BATCH;
+	if ((int)batchVisible.size() < batches) {
+		batchVisible.resize(batches);
+	}
+	auto runBatches = [&](int begin, int end) {
+		for (int b = begin; b < end; b++) {
+			batchVisible[b].clear();
+			cullRange(meshlets, planes, camera, coneTest, b * MESHLET_BATCH, std::min(meshlets.count, (b + 1) * MESHLET_BATCH), batchVisible[b]);
+		}
+	};
+	if (meshlets.count >= parallelThreshold) {
+		pool.parallelFor(batches, 1, runBatches);
+	}
+	else {
+		runBatches(0, batches);
+	}
+
+	// Concatenate in cluster order so ranges that touch in the index buffer become one draw
+	unsigned int rangeEnd = 0xFFFFFFFFu;
+	for (int b = 0; b < batches; b++) {
+		for (unsigned int k : batchVisible[b]) {
+			unsigned int first = meshlets.firstIndex[k];
+			if (first == rangeEnd) {
+				out.counts.back() += (GLsizei)meshlets.indexCount[k];
+			}
+			else {
+				out.counts.push_back((GLsizei)meshlets.indexCount[k]);
+				out.offsets.push_back((const void*)(size_t)(first * sizeof(unsigned int)));
+			}
+			rangeEnd = first + meshlets.indexCount[k];
+			out.visibleCount++;
+		}
+	}
+	testedCount += meshlets.count;
+	visibleCount += out.visibleCount;
+}
+
+/* Four clusters per iteration: inside all six planes, and not entirely facing away from the camera */
+void MeshletCuller::cullRange(const MeshletSet& meshlets, const float planes[6][4], const glm::vec3& camera, bool coneTest,
+	int begin, int end, std::vector<unsigned int>& visible) {
+	__m128 camX = _mm_set1_ps(camera.x);
+	__m128 camY = _mm_set1_ps(camera.y);
+	__m128 camZ = _mm_set1_ps(camera.z);
+	for (int i = begin; i < end; i += 4) {
+		__m128 cx = _mm_loadu_ps(&meshlets.centerX[i]);
+		__m128 cy = _mm_loadu_ps(&meshlets.centerY[i]);
+		__m128 cz = _mm_loadu_ps(&meshlets.centerZ[i]);
+		__m128 r = _mm_loadu_ps(&meshlets.radius[i]);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+		__m128 inside = _mm_cmpeq_ps(r, r);
+		for (int p = 0; p < 6; p++) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), cx), _mm_mul_ps(_mm_set1_ps(planes[p][1]), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][2]), cz), _mm_set1_ps(planes[p][3])));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, negR));
+		}
+		if (coneTest) {
+			// back-facing when dot(center - camera, axis) >= sin(spread) * |center - camera| + radius
+			__m128 vx = _mm_sub_ps(cx, camX);
+			__m128 vy = _mm_sub_ps(cy, camY);
+			__m128 vz = _mm_sub_ps(cz, camZ);
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+			__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&meshlets.axisX[i])), _mm_mul_ps(vy, _mm_loadu_ps(&meshlets.axisY[i]))),
+				_mm_mul_ps(vz, _mm_loadu_ps(&meshlets.axisZ[i])));
+			__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&meshlets.cutoff[i]), distance), r);
+			inside = _mm_andnot_ps(_mm_cmpge_ps(along, limit), inside);
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4 && i + lane < end; lane++) {
+			if (mask & (1 << lane)) {
+				visible.push_back((unsigned int)(i + lane));
+			}
+		}
+	}
+}
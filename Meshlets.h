@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "ThreadPool.h"
+
+// Cluster limits, sized like the common mesh shader budgets so one cluster's vertices stay cache resident
+const int MESHLET_MAX_VERTICES = 64;
+const int MESHLET_MAX_TRIANGLES = 124;
+
+// Clusters of consecutive triangles in an index buffer, each with a bounding sphere and a cone holding
+// all its triangle normals. Stored as structure of arrays padded to a multiple of 4 so the culler tests
+// four at a time; the padding lanes are ignored.
+struct MeshletSet {
+	int count;
+	std::vector<float> centerX, centerY, centerZ, radius;    /* object-space bounding sphere */
+	std::vector<float> axisX, axisY, axisZ, cutoff;          /* normal cone: axis and sine of its spread, 1 = never back-facing */
+	std::vector<unsigned int> firstIndex, indexCount;         /* range in the index buffer */
+
+	MeshletSet();
+	// split the triangles of an indexed mesh into clusters, in index buffer order
+	void build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+	void clear();
+	size_t cpuBytes() const;
+};
+
+// Index ranges that survived culling, ready for glMultiDrawElements; adjacent ranges are merged
+struct MeshletDrawList {
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;      /* byte offsets into the 32-bit index buffer */
+	int visibleCount;                      /* clusters drawn, before merging */
+};
+
+// Rejects clusters outside the view frustum or facing away from the camera. Works in the object space
+// of the mesh so the clusters never need transforming; cone culling is skipped under non-uniform scale,
+// which does not preserve normal directions.
+class MeshletCuller {
+public:
+	int parallelThreshold;     /* clusters in a mesh from which culling is split across the thread pool */
+	long long testedCount;     /* statistics since the last reset */
+	long long visibleCount;
+
+	MeshletCuller(ThreadPool& pool);
+	void cull(const MeshletSet& meshlets, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+		MeshletDrawList& out);
+private:
+	ThreadPool& pool;
+	std::vector<std::vector<unsigned int>> batchVisible;     /* surviving clusters per batch, in order */
+	void cullRange(const MeshletSet& meshlets, const float planes[6][4], const glm::vec3& camera, bool coneTest,
+		int begin, int end, std::vector<unsigned int>& visible);
+};
@@ -0,0 +1,180 @@
+#include "Microbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+MicrobenchState::MicrobenchState(long long iterations)
+	: iterations(iterations), bytesPerIteration(0), itemsPerIteration(0), remaining(iterations), started(false), paused(false),
+	accumulatedNs(0.0) {
+}
+
+bool MicrobenchState::keepRunning() {
+	if (!started) {
+		started = true;
+		start = Clock::now();
+	}
+	if (remaining-- > 0) {
+		return true;
+	}
+	if (!paused) {
+		pauseTiming();
+	}
+	return false;
+}
+
+void MicrobenchState::pauseTiming() {
+	accumulatedNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	paused = true;
+}
+
+void MicrobenchState::resumeTiming() {
+	paused = false;
+	start = Clock::now();
+}
+
+double MicrobenchState::elapsedNs() const {
+	return accumulatedNs;
+}
+
+Microbench::Microbench() {
+	minTimeMs = 200.0;
+	repetitions = 5;
+}
+
+void Microbench::add(const std::string& name, const std::function<void(MicrobenchState&)>& body) {
+	entries.push_back({ name, body });
+}
+
+void Microbench::run() {
+	std::ios_base::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision(3);
+	std::cout << std::fixed;
+	std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(14) << "Time" << std::setw(12) << "StdDev"
+		<< std::setw(12) << "Iterations" << "  Throughput" << std::endl;
+	for (const Entry& entry : entries) {
+		if (!filter.empty() && entry.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		MicrobenchResult result = measure(entry);
+		results.push_back(result);
+		std::ostringstream throughput;
+		if (result.bytesPerSecond > 0.0) {
+			throughput << std::fixed << std::setprecision(1) << "  " << result.bytesPerSecond / (1024.0 * 1024.0) << " MiB/s";
+		}
+		if (result.itemsPerSecond > 0.0) {
+			throughput << "  " << result.itemsPerSecond / 1e6 << " M items/s";
+		}
+		if (!result.label.empty()) {
+			throughput << "  " << result.label;
+		}
+		std::cout << std::left << std::setw(48) << result.name << std::right << std::setw(11) << result.medianNs / 1e3 << " us"
+			<< std::setw(9) << result.stddevNs / 1e3 << " us" << std::setw(12) << result.iterations << throughput.str() << std::endl;
+	}
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
+
+MicrobenchResult Microbench::measure(const Entry& entry) {
+	// Grow the batch until it is long enough to time, predicting the count from the last batch like Google Benchmark
+	long long iterations = 1;
+	double batchNs = 0.0;
+	MicrobenchState state(iterations);
+	while (true) {
+		state = MicrobenchState(iterations);
+		entry.body(state);
+		batchNs = state.elapsedNs();
+		if (batchNs >= minTimeMs * 1e6 || iterations >= 1000000000LL) {
+			break;
+		}
+		double predicted = batchNs > 0.0 ? iterations * minTimeMs * 1e6 * 1.4 / batchNs : iterations * 10.0;
+		iterations = std::max(iterations + 1, std::min((long long)predicted, iterations * 10));
+	}
+
+	// The sizing batch is the first repetition
+	std::vector<double> perIteration = { batchNs / iterations };
+	for (int r = 1; r < repetitions; r++) {
+		MicrobenchState repeat(iterations);
+		entry.body(repeat);
+		perIteration.push_back(repeat.elapsedNs() / iterations);
+	}
+
+	MicrobenchResult result;
+	result.name = entry.name;
+	result.iterations = iterations;
+	result.repetitions = (int)perIteration.size();
+	result.label = state.label;
+	std::vector<double> sorted = perIteration;
+	std::sort(sorted.begin(), sorted.end());
+	result.minNs = sorted.front();
+	result.medianNs = sorted[sorted.size() / 2];
+	result.meanNs = 0.0;
+	for (double ns : sorted) {
+		result.meanNs += ns;
+	}
+	result.meanNs /= sorted.size();
+	double variance = 0.0;
+	for (double ns : sorted) {
+		variance += (ns - result.meanNs) * (ns - result.meanNs);
+	}
+	result.stddevNs = sorted.size() > 1 ? std::sqrt(variance / (sorted.size() - 1)) : 0.0;
+	result.bytesPerSecond = state.bytesPerIteration * 1e9 / result.medianNs;
+	result.itemsPerSecond = state.itemsPerIteration * 1e9 / result.medianNs;
+	return result;
+}
+
+// JSON string contents; names and labels are plain ASCII, so only quotes and backslashes need escaping
+static std::string jsonEscape(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+bool Microbench::writeJson(const std::string& fileName, const std::string& context) const {
+	std::ofstream fout(fileName);
+	if (!fout) {
+		std::cout << "ERROR::MICROBENCH::CANNOT_WRITE: " << fileName << std::endl;
+		return false;
+	}
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+	fout << std::setprecision(10);
+	fout << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"description\": \"" << jsonEscape(context) << "\",\n"
+		<< "    \"min_time_ms\": " << minTimeMs << ",\n    \"repetitions\": " << repetitions << "\n  },\n  \"benchmarks\": [";
+	bool first = true;
+	for (const MicrobenchResult& result : results) {
+		// one aggregate per statistic, as Google Benchmark reports repetitions
+		const char* names[] = { "mean", "median", "stddev", "min" };
+		double values[] = { result.meanNs, result.medianNs, result.stddevNs, result.minNs };
+		for (int i = 0; i < 4; i++) {
+			fout << (first ? "\n" : ",\n") << "    {\n      \"name\": \"" << jsonEscape(result.name) << "_" << names[i] << "\",\n"
+				<< "      \"run_name\": \"" << jsonEscape(result.name) << "\",\n      \"run_type\": \"aggregate\",\n"
+				<< "      \"aggregate_name\": \"" << names[i] << "\",\n      \"repetitions\": " << result.repetitions << ",\n"
+				<< "      \"iterations\": " << result.iterations << ",\n      \"real_time\": " << values[i] << ",\n"
+				<< "      \"cpu_time\": " << values[i] << ",\n      \"time_unit\": \"ns\"";
+			if (i == 1 && result.bytesPerSecond > 0.0) {
+				fout << ",\n      \"bytes_per_second\": " << result.bytesPerSecond;
+			}
+			if (i == 1 && result.itemsPerSecond > 0.0) {
+				fout << ",\n      \"items_per_second\": " << result.itemsPerSecond;
+			}
+			if (!result.label.empty()) {
+				fout << ",\n      \"label\": \"" << jsonEscape(result.label) << "\"";
+			}
+			fout << "\n    }";
+			first = false;
+		}
+	}
+	fout << "\n  ]\n}" << std::endl;
+	return true;
+}
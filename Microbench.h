@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+// Handed to a benchmark body, which repeats the measured work while keepRunning() returns true:
+//     while (state.keepRunning()) { work(); }
+// Setup that must not be timed goes between pauseTiming() and resumeTiming().
+class MicrobenchState {
+public:
+	long long iterations;                  /* iterations the runner asked for in this batch */
+	long long bytesPerIteration;           /* optional: turned into bytes per second in the report */
+	long long itemsPerIteration;           /* optional: turned into items per second in the report */
+	std::string label;                     /* optional note shown with the result */
+
+	MicrobenchState(long long iterations);
+	bool keepRunning();
+	void pauseTiming();
+	void resumeTiming();
+	double elapsedNs() const;
+private:
+	typedef std::chrono::steady_clock Clock;
+	long long remaining;
+	bool started;
+	bool paused;
+	Clock::time_point start;
+	double accumulatedNs;
+};
+
+struct MicrobenchResult {
+	std::string name;
+	long long iterations;                  /* per repetition */
+	int repetitions;
+	double meanNs, medianNs, minNs, stddevNs;   /* time per iteration over the repetitions */
+	double bytesPerSecond, itemsPerSecond;      /* at the median, 0 when not reported */
+	std::string label;
+};
+
+// A small runner in the style of Google Benchmark. Every benchmark's iteration count grows until a batch takes
+// at least minTimeMs, then that batch is repeated to get the spread. Results print as a table and can be saved as
+// JSON in the layout of Google Benchmark's --benchmark_format=json, so existing comparison tools read them.
+class Microbench {
+public:
+	double minTimeMs;                      /* shortest batch that is trusted */
+	int repetitions;
+	std::string filter;                    /* only benchmarks whose name contains this run; empty runs all */
+	std::vector<MicrobenchResult> results;
+
+	Microbench();
+	void add(const std::string& name, const std::function<void(MicrobenchState&)>& body);
+	void run();
+	bool writeJson(const std::string& fileName, const std::string& context) const;
+private:
+	struct Entry {
+		std::string name;
+		std::function<void(MicrobenchState&)> body;
+	};
+	std::vector<Entry> entries;
+	MicrobenchResult measure(const Entry& entry);
+};
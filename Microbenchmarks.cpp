@@ -0,0 +1,367 @@
+#include "Microbenchmarks.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "Microbench.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "ShaderVariantCache.h"
+#include "LightingPass.h"
+#include "ShadowAtlas.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+#include "GLState.h"
+
+// defined in Source.cpp
+void dump_framebuffer_to_ppm(std::string fileName, unsigned int width, unsigned int height);
+
+// Scaled-up inputs are generated next to the executable and removed afterwards
+static const char* GRID_OBJ_PATH = "microbench-grid.obj";
+static const char* LARGE_TEXTURE_PATH = "microbench-texture.ppm";
+static const char* DUMP_PATH = "microbench-dump.ppm";
+
+struct MeshAsset {
+	std::string name;
+	std::string objectPath;
+	std::string texturePath;
+};
+
+static bool fileExists(const std::string& path) {
+	return std::ifstream(path).good();
+}
+
+/* A flat grid of cells x cells quads with positions, texture coordinates and normals, as an exported OBJ would have */
+static bool writeGridObj(const std::string& path, int cells) {
+	std::ofstream fout(path);
+	if (!fout) {
+		return false;
+	}
+	for (int y = 0; y <= cells; y++) {
+		for (int x = 0; x <= cells; x++) {
+			fout << "v " << x - cells * 0.5f << " 0 " << y - cells * 0.5f << "\n";
+		}
+	}
+	for (int y = 0; y <= cells; y++) {
+		for (int x = 0; x <= cells; x++) {
+			fout << "vt " << (float)x / cells << " " << (float)y / cells << "\n";
+		}
+	}
+	fout << "vn 0 1 0\n";
+	for (int y = 0; y < cells; y++) {
+		for (int x = 0; x < cells; x++) {
+			int a = y * (cells + 1) + x + 1, b = a + 1, c = a + cells + 1, d = c + 1;
+			fout << "f " << a << "/" << a << "/1 " << c << "/" << c << "/1 " << d << "/" << d << "/1\n";
+			fout << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << b << "/" << b << "/1\n";
+		}
+	}
+	return (bool)fout;
+}
+
+/* A binary PPM of noise; stb_image decodes it without the cost of a compressed format, so it isolates the I/O */
+static bool writeNoiseTexture(const std::string& path, int size) {
+	std::ofstream fout(path, std::ios::binary);
+	if (!fout) {
+		return false;
+	}
+	fout << "P6\n" << size << " " << size << "\n255\n";
+	std::vector<unsigned char> row(size * 3);
+	unsigned int seed = 1;
+	for (int y = 0; y < size; y++) {
+		for (unsigned char& value : row) {
+			seed = seed * 1664525u + 1013904223u;
+			value = (unsigned char)(seed >> 24);
+		}
+		fout.write((const char*)row.data(), row.size());
+	}
+	return (bool)fout;
+}
+
+/* Entities laid out on a square grid, copies of the mesh table in turn */
+static void buildInstanceScene(Scene& scene, const std::vector<Mesh*>& meshes, int instances) {
+	int side = (int)std::ceil(std::sqrt((double)instances));
+	for (int i = 0; i < instances; i++) {
+		Mesh* mesh = meshes[i % meshes.size()];
+		int entity = scene.createEntity(NO_PARENT, (int)(i % meshes.size()), { mesh->boundsCenter, mesh->boundsRadius });
+		if (instances > (int)meshes.size()) {
+			scene.setPosition(entity, glm::vec3(((i % side) - side * 0.5f) * 60.0f, 0.0f, -(i / side) * 60.0f));
+		}
+	}
+	scene.updateTransforms(nullptr);
+}
+
+int runMicrobenchmarks(const std::vector<SpotLight>& lights, const std::string& jsonPath, const std::string& filter) {
+	Microbench bench;
+	bench.filter = filter;
+
+	std::vector<MeshAsset> assets = {
+		{ "timmy", "./asset/timmy.obj", "./asset/timmy.png" },
+		{ "bucket", "./asset/bucket.obj", "./asset/bucket.jpg" },
+		{ "floor", "./asset/floor.obj", "./asset/floor.jpeg" }
+	};
+	bool wroteGrid = writeGridObj(GRID_OBJ_PATH, 512);
+	bool wroteTexture = writeNoiseTexture(LARGE_TEXTURE_PATH, 4096);
+	if (wroteGrid) {
+		assets.push_back({ "grid-512k-triangles", GRID_OBJ_PATH, "" });
+	}
+	if (wroteTexture) {
+		assets.push_back({ "noise-4096", "", LARGE_TEXTURE_PATH });
+	}
+
+	// Meshes stay on the CPU for the load benchmarks; the ones that load are uploaded for the GL benchmarks
+	std::vector<std::unique_ptr<Mesh>> sceneMeshes;
+	std::vector<MeshAsset> sceneAssets;
+	for (int i = 0; i < 3; i++) {
+		if (fileExists(assets[i].objectPath)) {
+			sceneMeshes.emplace_back(new Mesh(assets[i].objectPath, assets[i].texturePath));
+			sceneAssets.push_back(assets[i]);
+		}
+		else {
+			std::cout << "Microbench: " << assets[i].objectPath << " not found, its benchmarks are skipped" << std::endl;
+		}
+	}
+
+	// The OBJ parse and the expansion into vertices. The vertex array is released between iterations, so
+	// its growth is timed as it happens at load.
+	for (const MeshAsset& asset : assets) {
+		if (asset.objectPath.empty() || !fileExists(asset.objectPath)) {
+			continue;
+		}
+		// kept alive by the benchmark; deleteBuffers frees the texture it decoded on the way
+		std::shared_ptr<Mesh> mesh(new Mesh(asset.objectPath, asset.texturePath, false), [](Mesh* m) { m->deleteBuffers(); delete m; });
+		bench.add("Mesh/loadVertices/" + asset.name, [mesh, asset](MicrobenchState& state) {
+			while (state.keepRunning()) {
+				state.pauseTiming();
+				std::vector<Vertex>().swap(mesh->vertices);
+				state.resumeTiming();
+				mesh->loadVertices(asset.objectPath);
+			}
+			state.itemsPerIteration = (long long)mesh->vertices.size() / 3;
+			state.label = "items are triangles";
+		});
+	}
+
+	// stbi_load as Mesh::loadTexture calls it
+	for (const MeshAsset& asset : assets) {
+		if (asset.texturePath.empty() || !fileExists(asset.texturePath)) {
+			continue;
+		}
+		bench.add("stbi_load/" + asset.name, [asset](MicrobenchState& state) {
+			int width = 0, height = 0, channels = 0;
+			stbi_set_flip_vertically_on_load(true);
+			while (state.keepRunning()) {
+				unsigned char* data = stbi_load(asset.texturePath.c_str(), &width, &height, &channels, 0);
+				stbi_image_free(data);
+			}
+			state.bytesPerIteration = (long long)width * height * channels;
+			state.label = std::to_string(width) + "x" + std::to_string(height);
+		});
+	}
+
+	// Texture upload as Mesh::setupMeshTexture does it, waiting until the driver has consumed the pixels
+	for (const MeshAsset& asset : assets) {
+		if (asset.texturePath.empty() || !fileExists(asset.texturePath)) {
+			continue;
+		}
+		bench.add("glTexImage2D/" + asset.name, [asset](MicrobenchState& state) {
+			int width, height, channels;
+			stbi_set_flip_vertically_on_load(true);
+			unsigned char* data = stbi_load(asset.texturePath.c_str(), &width, &height, &channels, 3);
+			if (!data) {
+				while (state.keepRunning()) {
+				}
+				return;
+			}
+			unsigned int texture;
+			glGenTextures(1, &texture);
+			glState.bindTexture(0, texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			while (state.keepRunning()) {
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+				glFinish();
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glDeleteTextures(1, &texture);
+			glState.textureDeleted(texture);
+			stbi_image_free(data);
+			state.bytesPerIteration = (long long)width * height * 3;
+		});
+	}
+
+	// Uniform setters on the lighting program the scene uses most
+	ShaderManager shaderManager;
+	ShaderVariantCache lightingShaders(shaderManager, "vertex_shader.glsl", "fragment_shader.glsl");
+	ShaderKey key = { (int)lights.size(), false, true, ShadingModel::Lambert };
+	lightingShaders.prepare(key);
+	bool firstUse;
+	Shader* program = &lightingShaders.get(key, firstUse);
+	glm::mat4 matrices[2] = { glm::mat4(1.0f), glm::translate(glm::mat4(1.0f), glm::vec3(1.0f)) };
+	bench.add("Shader/setMat4/changed", [program, matrices](MicrobenchState& state) {
+		program->use();
+		long long i = 0;
+		while (state.keepRunning()) {
+			program->setMat4("model", matrices[i++ & 1]);
+		}
+	});
+	bench.add("Shader/setMat4/unchanged", [program, matrices](MicrobenchState& state) {
+		program->use();
+		while (state.keepRunning()) {
+			program->setMat4("model", matrices[0]);
+		}
+	});
+	bench.add("Shader/setFloat/changed", [program](MicrobenchState& state) {
+		program->use();
+		long long i = 0;
+		while (state.keepRunning()) {
+			program->setFloat("shininess", (float)(i++ & 1) + 16.0f);
+		}
+	});
+	bench.add("Shader/setIntArray/changed", [program, &lights](MicrobenchState& state) {
+		program->use();
+		int indices[2][MAX_SPOTLIGHTS];
+		for (int i = 0; i < MAX_SPOTLIGHTS; i++) {
+			indices[0][i] = i;
+			indices[1][i] = MAX_SPOTLIGHTS - 1 - i;
+		}
+		long long i = 0;
+		while (state.keepRunning()) {
+			program->setIntArray("lightIndices", indices[i++ & 1], (int)lights.size());
+		}
+	});
+	// the uniforms every draw sets, for a realistic and a crowded frame
+	for (int draws : { 3, 10000 }) {
+		bench.add("Shader/perDrawUniforms/" + std::to_string(draws), [program, draws](MicrobenchState& state) {
+			program->use();
+			std::vector<glm::mat4> models(draws);
+			for (int i = 0; i < draws; i++) {
+				models[i] = glm::translate(glm::mat4(1.0f), glm::vec3((float)i, 0.0f, 0.0f));
+			}
+			int indices[3] = { 0, 1, 2 };
+			while (state.keepRunning()) {
+				for (int i = 0; i < draws; i++) {
+					program->setMat4("model", models[i]);
+					program->setMat4("previousModel", models[i]);
+					program->setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(models[i]))));
+					program->setIntArray("lightIndices", indices, 3);
+				}
+			}
+			state.itemsPerIteration = draws;
+			state.label = "items are draws";
+		});
+	}
+
+	// Framebuffer capture at the window size and at 4K from an offscreen target
+	RenderTarget largeTarget(3840, 2160, GL_RGBA8, false);
+	bench.add("dump_framebuffer_to_ppm/1024x768", [](MicrobenchState& state) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		while (state.keepRunning()) {
+			dump_framebuffer_to_ppm(DUMP_PATH, 1024, 768);
+		}
+		state.bytesPerIteration = 1024LL * 768 * 3;
+	});
+	bench.add("dump_framebuffer_to_ppm/3840x2160", [&largeTarget](MicrobenchState& state) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, largeTarget.FBO);
+		while (state.keepRunning()) {
+			dump_framebuffer_to_ppm(DUMP_PATH, largeTarget.width, largeTarget.height);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		state.bytesPerIteration = (long long)largeTarget.width * largeTarget.height * 3;
+	});
+
+	// The CPU side of a frame through the main loop's own passes: shadow map updates, light culling, draw sorting,
+	// uniforms and draw calls, once with whole meshes and once drawn cluster by cluster. The GPU is drained outside
+	// the timed part so only submission is measured.
+	ThreadPool threadPool;
+	StreamBuffer frameUniforms(GL_UNIFORM_BUFFER, 64 * 1024);
+	ShaderHandle depthShader = shaderManager.add("shadow_vertex_shader.glsl", "shadow_fragment_shader.glsl");
+	ShadowAtlas shadowAtlas(4096);
+	std::vector<std::unique_ptr<Mesh>> meshletMeshes;
+	for (const MeshAsset& asset : sceneAssets) {
+		meshletMeshes.emplace_back(new Mesh(asset.objectPath, asset.texturePath));
+		meshletMeshes.back()->buildMeshlets();
+	}
+	for (bool useMeshlets : { false, true }) {
+		std::vector<Mesh*> meshes;
+		for (std::unique_ptr<Mesh>& mesh : useMeshlets ? meshletMeshes : sceneMeshes) {
+			meshes.push_back(mesh.get());
+		}
+		if (meshes.empty()) {
+			break;
+		}
+		for (int instances : { 3, 1000, 10000 }) {
+			std::string name = std::string("FrameSubmission/") + (useMeshlets ? "meshlets/" : "") + std::to_string(instances);
+			bench.add(name, [&, meshes, instances](MicrobenchState& state) {
+				Scene scene;
+				buildInstanceScene(scene, meshes, instances);
+				std::vector<ShadowCaster> staticCasters, dynamicCasters;
+				for (int i = 0; i < scene.size(); i++) {
+					staticCasters.push_back({ meshes[scene.meshes[i]], scene.worldMatrices[i] });
+				}
+				LightingPass lightingPass(threadPool, lightingShaders);
+				for (const SpotLight& light : lights) {
+					lightingPass.ambientLight += light.ambient;
+				}
+				FrameCamera camera;
+				camera.position = glm::vec3(50.0f, 100.0f, 200.0f);
+				camera.view = glm::lookAt(camera.position, glm::vec3(0.0f, 80.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				camera.nearPlane = 0.1f;
+				camera.farPlane = 1000.0f;
+				camera.projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, camera.nearPlane, camera.farPlane);
+				camera.viewProjection = camera.projection * camera.view;
+				camera.previousViewProjection = camera.viewProjection;
+				Shader& depthProgram = shaderManager.get(depthShader);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glViewport(0, 0, 1024, 768);
+				while (state.keepRunning()) {
+					frameUniforms.beginFrame();
+					StreamAllocation lightBlock = frameUniforms.allocate(sizeof(SpotLightBlock));
+					if (lightBlock.data) {
+						writeSpotLightBlock((SpotLightBlock*)lightBlock.data, lights);
+						frameUniforms.commit();
+						frameUniforms.bindRange(SPOTLIGHT_BLOCK_BINDING, lightBlock);
+					}
+					scene.updateTransforms(&threadPool);
+					shadowAtlas.update(lights, camera.view, camera.projection, depthProgram, staticCasters, dynamicCasters);
+					lightingPass.render(scene, meshes, lights, shadowAtlas, camera);
+					frameUniforms.endFrame();
+					state.pauseTiming();
+					glFinish();
+					state.resumeTiming();
+				}
+				state.itemsPerIteration = instances;
+				state.label = "items are draws";
+			});
+		}
+	}
+
+	bench.run();
+	int status = 0;
+	if (!jsonPath.empty() && !bench.writeJson(jsonPath, "DiscoScene microbenchmarks, " + std::string((const char*)glGetString(GL_RENDERER)))) {
+		status = -1;
+	}
+
+	frameUniforms.deleteBuffers();
+	shadowAtlas.deleteBuffers();
+	largeTarget.deleteBuffers();
+	for (std::unique_ptr<Mesh>& mesh : sceneMeshes) {
+		mesh->deleteBuffers();
+	}
+	for (std::unique_ptr<Mesh>& mesh : meshletMeshes) {
+		mesh->deleteBuffers();
+	}
+	shaderManager.deleteAll();
+	std::remove(GRID_OBJ_PATH);
+	std::remove(LARGE_TEXTURE_PATH);
+	std::remove(DUMP_PATH);
+	return status;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SpotLight.h"
+
+// Run the engine's microbenchmarks on the current GL context and save the results as JSON to jsonPath (skipped when
+// empty). filter keeps only benchmarks whose name contains it. Returns 0 on success like main().
+int runMicrobenchmarks(const std::vector<SpotLight>& lights, const std::string& jsonPath, const std::string& filter);
@@ -0,0 +1,315 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+// Distance secondary rays start off the surface, in scene units (the disco scene spans a few hundred)
+static const float RAY_OFFSET = 0.01f;
+// Path mode: bounces before Russian roulette may end a path
+static const int MIN_BOUNCES = 2;
+static const float TWO_PI = 6.28318530718f;
+
+// Hit points of a packet, one per lane
+struct PathTracer::SurfaceBatch {
+	bool hit[4];
+	glm::vec3 position[4];
+	glm::vec3 normal[4];       /* interpolated and normalized, not flipped, as the fragment shader uses it */
+	glm::vec3 faceNormal[4];   /* geometric normal on the side the ray came from */
+	glm::vec3 viewDir[4];      /* toward the ray origin */
+	glm::vec3 albedo[4];
+};
+
+/* PCG output permutation over an LCG step, uniform in [0, 1) */
+static inline float randomFloat(unsigned int& state) {
+	state = state * 747796405u + 2891336453u;
+	unsigned int word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+	word = (word >> 22) ^ word;
+	return (word >> 8) * (1.0f / 16777216.0f);
+}
+
+/* Cosine-weighted direction around n, whose density cancels the Lambert BRDF's cosine and 1/pi */
+static glm::vec3 sampleCosine(const glm::vec3& n, float r1, float r2) {
+	float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+	float a = -1.0f / (sign + n.z);
+	float b = n.x * n.y * a;
+	glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+	glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+	float phi = TWO_PI * r1;
+	float radius = std::sqrt(r2);
+	return tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - r2));
+}
+
+PathTracer::PathTracer(ThreadPool& pool, int width, int height)
+	: width(width), height(height), pool(pool) {
+	mode = TraceMode::Direct;
+	shadows = true;
+	maxBounces = 4;
+	clearColor = glm::vec3(0.3f, 0.4f, 0.5f);
+	baseColor = glm::vec3(0.8f);
+	shadingModel = ShadingModel::Lambert;
+	shininess = 32.0f;
+	specularStrength = 0.5f;
+	pixels.resize((size_t)width * height * 3);
+	accumulation.resize((size_t)width * height);
+	sampleCount = 0;
+	raysTraced = 0;
+	lastMs = 0.0;
+	buildMs = 0.0;
+	ambientLight = glm::vec3(0.0f);
+	inverseViewProjection = glm::mat4(1.0f);
+}
+
+/* World-space triangles of every draw go into one BVH; the meshes must outlive the tracer */
+void PathTracer::setScene(const std::vector<SoftwareDraw>& sceneDraws, const std::vector<SpotLight>& sceneLights,
+	const glm::vec3& sceneAmbient) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	draws = sceneDraws;
+	lights = sceneLights;
+	ambientLight = sceneAmbient;
+	coneDirections.resize(lights.size());
+	for (int i = 0; i < (int)lights.size(); i++) {
+		coneDirections[i] = glm::normalize(-lights[i].direction);
+	}
+
+	std::vector<BvhTriangle> triangles;
+	shading.clear();
+	for (int d = 0; d < (int)draws.size(); d++) {
+		const glm::mat4& model = draws[d].model;
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+		const std::vector<Vertex>& vertices = draws[d].mesh->vertices;
+		for (size_t v = 0; v + 2 < vertices.size(); v += 3) {
+			glm::vec3 corners[3];
+			TriangleShading attributes;
+			for (int i = 0; i < 3; i++) {
+				corners[i] = glm::vec3(model * glm::vec4(vertices[v + i].position, 1.0f));
+				attributes.normal[i] = normalMatrix * vertices[v + i].normal;
+				attributes.uv[i] = vertices[v + i].texture;
+			}
+			attributes.faceNormal = glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+			attributes.draw = d;
+			triangles.push_back({ corners[0], corners[1] - corners[0], corners[2] - corners[0] });
+			shading.push_back(attributes);
+		}
+	}
+	bvh.build(triangles);
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	sampleCount = 0;
+}
+
+void PathTracer::setCamera(const glm::mat4& view, const glm::mat4& projection) {
+	inverseViewProjection = glm::inverse(projection * view);
+	sampleCount = 0;
+}
+
+void PathTracer::resolveHits(const RayPacket& packet, SurfaceBatch& surfaces) const {
+	for (int lane = 0; lane < 4; lane++) {
+		int id = packet.triangle[lane];
+		surfaces.hit[lane] = id >= 0;
+		if (id < 0) {
+			continue;
+		}
+		glm::vec3 origin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+		glm::vec3 direction(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+		const TriangleShading& t = shading[id];
+		float u = packet.u[lane], v = packet.v[lane], w = 1.0f - u - v;
+		surfaces.position[lane] = origin + direction * packet.tMax[lane];
+		surfaces.normal[lane] = glm::normalize(t.normal[0] * w + t.normal[1] * u + t.normal[2] * v);
+		surfaces.faceNormal[lane] = glm::dot(t.faceNormal, direction) > 0.0f ? -t.faceNormal : t.faceNormal;
+		surfaces.viewDir[lane] = -direction;
+		const Mesh& mesh = *draws[t.draw].mesh;
+		glm::vec2 uv = t.uv[0] * w + t.uv[1] * u + t.uv[2] * v;
+		surfaces.albedo[lane] = mesh.texData ? mesh.sampleTexture(uv) : baseColor;
+	}
+}
+
+/* Spotlight contribution at each hit lane, as in fragment_shader.glsl but with shadow rays instead of shadow maps */
+void PathTracer::directLight(const SurfaceBatch& surfaces, bool castShadows, glm::vec3* radiance, long long& rays) const {
+	RayPacket shadowRays;
+	glm::vec3 contribution[4];
+	for (int i = 0; i < (int)lights.size(); i++) {
+		const SpotLight& light = lights[i];
+		int lit = 0;
+		for (int lane = 0; lane < 4; lane++) {
+			shadowRays.disable(lane);
+			if (!surfaces.hit[lane]) {
+				continue;
+			}
+			glm::vec3 toLight = light.position - surfaces.position[lane];
+			float dist = glm::length(toLight);
+			glm::vec3 lightDir = toLight * (1.0f / dist);
+			if (glm::dot(lightDir, coneDirections[i]) <= light.cutoffAngle) {
+				continue;
+			}
+			const glm::vec3& norm = surfaces.normal[lane];
+			glm::vec3 diffuse = light.diffuse * std::max(glm::dot(norm, lightDir), 0.0f) * surfaces.albedo[lane];
+			if (shadingModel == ShadingModel::BlinnPhong) {
+				glm::vec3 halfway = glm::normalize(lightDir + surfaces.viewDir[lane]);
+				diffuse += light.diffuse * specularStrength * std::pow(std::max(glm::dot(norm, halfway), 0.0f), shininess);
+			}
+			float attenuation = 1.0f / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * dist * dist);
+			contribution[lane] = diffuse * attenuation;
+			if (contribution[lane] == glm::vec3(0.0f)) {
+				continue;
+			}
+			lit |= 1 << lane;
+			if (castShadows) {
+				shadowRays.set(lane, surfaces.position[lane] + surfaces.faceNormal[lane] * RAY_OFFSET, lightDir, dist - 2.0f * RAY_OFFSET);
+				rays++;
+			}
+		}
+		int blocked = castShadows && lit ? bvh.occluded(shadowRays) : 0;
+		for (int lane = 0; lane < 4; lane++) {
+			if ((lit & ~blocked) & (1 << lane)) {
+				radiance[lane] += contribution[lane];
+			}
+		}
+	}
+}
+
+void PathTracer::renderTile(int tile, long long& rays) {
+	int tilesX = (width + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE;
+	int originX = (tile % tilesX) * TRACE_TILE_SIZE;
+	int originY = (tile / tilesX) * TRACE_TILE_SIZE;
+	int endX = std::min(originX + TRACE_TILE_SIZE, width);
+	int endY = std::min(originY + TRACE_TILE_SIZE, height);
+	bool path = mode == TraceMode::Path;
+
+	RayPacket packet;
+	SurfaceBatch surfaces;
+	for (int quadY = originY; quadY < endY; quadY += 2) {
+		for (int quadX = originX; quadX < endX; quadX += 2) {
+			int pixel[4];
+			unsigned int random[4];
+			glm::vec3 radiance[4], throughput[4];
+			for (int lane = 0; lane < 4; lane++) {
+				int x = quadX + (lane & 1), y = quadY + (lane >> 1);
+				radiance[lane] = glm::vec3(0.0f);
+				throughput[lane] = glm::vec3(1.0f);
+				if (x >= endX || y >= endY) {
+					pixel[lane] = -1;
+					packet.disable(lane);
+					continue;
+				}
+				pixel[lane] = y * width + x;
+				random[lane] = (unsigned int)pixel[lane] * 9781u + (unsigned int)sampleCount * 6271u + 1u;
+				randomFloat(random[lane]);
+				// pixel centers as the rasterizers sample them; Path mode spreads samples over the pixel
+				float jitterX = path ? randomFloat(random[lane]) : 0.5f;
+				float jitterY = path ? randomFloat(random[lane]) : 0.5f;
+				float ndcX = (x + jitterX) / width * 2.0f - 1.0f;
+				float ndcY = (y + jitterY) / height * 2.0f - 1.0f;
+				glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+				glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+				glm::vec3 start = glm::vec3(nearPoint) / nearPoint.w;
+				glm::vec3 end = glm::vec3(farPoint) / farPoint.w;
+				float length = glm::length(end - start);
+				packet.set(lane, start, (end - start) / length, length);
+				rays++;
+			}
+
+			for (int bounce = 0; ; bounce++) {
+				bvh.intersect(packet);
+				resolveHits(packet, surfaces);
+				bool any = false;
+				for (int lane = 0; lane < 4; lane++) {
+					if (pixel[lane] < 0 || packet.tMax[lane] <= 0.0f) {
+						surfaces.hit[lane] = false;
+						continue;
+					}
+					if (!surfaces.hit[lane]) {
+						// the background behind the scene, then the ambient light as a uniform sky for bounces
+						radiance[lane] += throughput[lane] * (bounce == 0 ? clearColor : ambientLight);
+						continue;
+					}
+					any = true;
+					if (!path) {
+						radiance[lane] = ambientLight * surfaces.albedo[lane];
+					}
+				}
+				if (!any) {
+					break;
+				}
+
+				glm::vec3 direct[4] = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+				directLight(surfaces, path || shadows, direct, rays);
+				for (int lane = 0; lane < 4; lane++) {
+					if (surfaces.hit[lane]) {
+						radiance[lane] += throughput[lane] * direct[lane];
+					}
+				}
+				if (!path || bounce >= maxBounces) {
+					break;
+				}
+
+				// continue diffuse paths in a new packet; lanes that ended stay disabled
+				for (int lane = 0; lane < 4; lane++) {
+					if (!surfaces.hit[lane]) {
+						packet.disable(lane);
+						continue;
+					}
+					throughput[lane] *= surfaces.albedo[lane];
+					if (bounce + 1 >= MIN_BOUNCES) {
+						float survival = std::min(1.0f, std::max(0.05f, std::max(throughput[lane].x, std::max(throughput[lane].y, throughput[lane].z))));
+						if (randomFloat(random[lane]) >= survival) {
+							packet.disable(lane);
+							continue;
+						}
+						throughput[lane] /= survival;
+					}
+					glm::vec3 normal = surfaces.normal[lane];
+					if (glm::dot(normal, surfaces.faceNormal[lane]) < 0.0f) {
+						normal = surfaces.faceNormal[lane];
+					}
+					float r1 = randomFloat(random[lane]);
+					float r2 = randomFloat(random[lane]);
+					glm::vec3 direction = sampleCosine(normal, r1, r2);
+					packet.set(lane, surfaces.position[lane] + surfaces.faceNormal[lane] * RAY_OFFSET, direction, INFINITY);
+					rays++;
+				}
+			}
+
+			for (int lane = 0; lane < 4; lane++) {
+				if (pixel[lane] < 0) {
+					continue;
+				}
+				glm::vec3& sum = accumulation[pixel[lane]];
+				sum = path ? sum + radiance[lane] : radiance[lane];
+			}
+		}
+	}
+}
+
+void PathTracer::render() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (mode == TraceMode::Direct || sampleCount == 0) {
+		std::fill(accumulation.begin(), accumulation.end(), glm::vec3(0.0f));
+		sampleCount = 0;
+	}
+
+	int tilesX = (width + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE;
+	int tilesY = (height + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE;
+	std::atomic<long long> totalRays(0);
+	pool.parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+		long long rays = 0;
+		for (int tile = begin; tile < end; tile++) {
+			renderTile(tile, rays);
+		}
+		totalRays += rays;
+	});
+	sampleCount = mode == TraceMode::Path ? sampleCount + 1 : 1;
+
+	float scale = 1.0f / sampleCount;
+	for (size_t i = 0; i < accumulation.size(); i++) {
+		for (int c = 0; c < 3; c++) {
+			pixels[i * 3 + c] = (unsigned char)(std::min(std::max(accumulation[i][c] * scale, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+	raysTraced = totalRays;
+	lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double PathTracer::lastMraysPerSecond() const {
+	return lastMs > 0.0 ? raysTraced / (lastMs * 1000.0) : 0.0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "SoftwareRenderer.h"
+#include "SpotLight.h"
+#include "ThreadPool.h"
+#include "ShaderVariantCache.h"
+
+enum class TraceMode {
+	Direct,   // the rasterizer's lighting with ray traced shadows, one deterministic sample per pixel
+	Path      // progressive path tracing: diffuse bounces lit by the spots and an environment of the ambient light
+};
+
+// Side of the square screen tiles handed to the thread pool
+const int TRACE_TILE_SIZE = 16;
+
+// CPU ray tracer over the same meshes and spotlights as the rasterizers. Rays are traced four at a time (2x2 pixel
+// quads, and their shadow and bounce rays) through a SAH BVH. Lights are points with the cone, attenuation and
+// Lambert / Blinn-Phong response of fragment_shader.glsl, so Direct mode can be diffed against the GPU frames;
+// Path mode adds indirect light and antialiasing and converges over many calls to render().
+class PathTracer {
+public:
+	int width, height;
+	TraceMode mode;
+	bool shadows;                       /* shadow rays toward the spots (Direct mode; Path mode always casts them) */
+	int maxBounces;                     /* Path mode: bounces after the camera ray */
+	glm::vec3 clearColor;               /* seen where camera rays leave the scene */
+	glm::vec3 baseColor;                /* object color of meshes without a texture */
+	ShadingModel shadingModel;
+	float shininess;
+	float specularStrength;
+	std::vector<unsigned char> pixels;  /* RGB rows from bottom to top, the layout glReadPixels returns */
+	int sampleCount;                    /* samples accumulated per pixel since the scene or camera changed */
+	long long raysTraced;               /* camera, shadow and bounce rays of the last render() */
+	double lastMs;                      /* wall time of the last render() */
+	double buildMs;                     /* BVH build time of the last setScene() */
+
+	PathTracer(ThreadPool& pool, int width, int height);
+	void setScene(const std::vector<SoftwareDraw>& draws, const std::vector<SpotLight>& lights, const glm::vec3& ambientLight);
+	void setCamera(const glm::mat4& view, const glm::mat4& projection);
+	// add one sample per pixel (Direct mode replaces the image) and refresh pixels
+	void render();
+	double lastMraysPerSecond() const;
+private:
+	// Shading attributes of a triangle, indexed like the BVH input
+	struct TriangleShading {
+		glm::vec3 normal[3];
+		glm::vec2 uv[3];
+		glm::vec3 faceNormal;
+		int draw;
+	};
+	struct SurfaceBatch;
+	ThreadPool& pool;
+	Bvh bvh;
+	std::vector<TriangleShading> shading;
+	std::vector<SoftwareDraw> draws;
+	std::vector<SpotLight> lights;
+	std::vector<glm::vec3> coneDirections;
+	glm::vec3 ambientLight;
+	glm::mat4 inverseViewProjection;
+	std::vector<glm::vec3> accumulation;
+	void renderTile(int tile, long long& rays);
+	void resolveHits(const RayPacket& packet, SurfaceBatch& surfaces) const;
+	void directLight(const SurfaceBatch& surfaces, bool castShadows, glm::vec3* radiance, long long& rays) const;
+};
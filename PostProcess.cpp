@@ -0,0 +1,181 @@
+#include "PostProcess.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The luminance average is taken over a fixed size target; its 1x1 mip is the frame average
+static const int LUMINANCE_SIZE = 256;
+
+PostProcess::PostProcess(ShaderManager& shaders)
+	: shaders(shaders),
+	downsampleShader(shaders.add("fullscreen_vertex_shader.glsl", "post_bloom_downsample_fragment_shader.glsl")),
+	upsampleShader(shaders.add("fullscreen_vertex_shader.glsl", "post_bloom_upsample_fragment_shader.glsl")),
+	luminanceShader(shaders.add("fullscreen_vertex_shader.glsl", "post_luminance_fragment_shader.glsl")),
+	adaptShader(shaders.add("fullscreen_vertex_shader.glsl", "post_adapt_fragment_shader.glsl")),
+	bloomChain{ RenderTarget(1, 1, GL_R11F_G11F_B10F, false), RenderTarget(1, 1, GL_R11F_G11F_B10F, false),
+		RenderTarget(1, 1, GL_R11F_G11F_B10F, false), RenderTarget(1, 1, GL_R11F_G11F_B10F, false),
+		RenderTarget(1, 1, GL_R11F_G11F_B10F, false) },
+	luminance(LUMINANCE_SIZE, LUMINANCE_SIZE, GL_R16F, false),
+	adapted{ RenderTarget(1, 1, GL_R32F, false), RenderTarget(1, 1, GL_R32F, false) } {
+	bloomEnabled = true;
+	autoExposureEnabled = true;
+	toneMappingEnabled = true;
+	fxaaEnabled = true;
+	bloomThreshold = 1.0f;
+	bloomKnee = 0.5f;
+	bloomStrength = 0.3f;
+	exposure = 1.0f;
+	exposureKey = 0.18f;
+	minExposure = 0.25f;
+	maxExposure = 4.0f;
+	adaptationSpeed = 2.0f;
+	budgetMs = 1.5f;
+	currentAdapted = 0;
+	adaptedValid = false;
+	bloomLevels = BLOOM_LEVELS;
+	for (int i = 0; i < 16; i++) {
+		resolveShaders[i] = -1;
+	}
+}
+
+/* Program for the current combination of effects; a combination seen for the first time compiles then */
+ShaderHandle PostProcess::resolveShader() {
+	int mask = (bloomEnabled ? 1 : 0) | (autoExposureEnabled ? 2 : 0) | (toneMappingEnabled ? 4 : 0) | (fxaaEnabled ? 8 : 0);
+	if (resolveShaders[mask] < 0) {
+		std::string defines;
+		defines += std::string("#define BLOOM ") + (bloomEnabled ? "1" : "0") + "\n";
+		defines += std::string("#define AUTO_EXPOSURE ") + (autoExposureEnabled ? "1" : "0") + "\n";
+		defines += std::string("#define TONEMAP ") + (toneMappingEnabled ? "1" : "0") + "\n";
+		defines += std::string("#define FXAA ") + (fxaaEnabled ? "1" : "0") + "\n";
+		resolveShaders[mask] = shaders.add("fullscreen_vertex_shader.glsl", "post_resolve_fragment_shader.glsl", defines);
+	}
+	return resolveShaders[mask];
+}
+
+/* Prefilter into half resolution, halve down the chain, then add each level onto the next larger one */
+void PostProcess::renderBloom(const RenderTarget& hdr) {
+	bloomLevels = 0;
+	for (int i = 0; i < BLOOM_LEVELS; i++) {
+		int width = hdr.width >> (i + 1);
+		int height = hdr.height >> (i + 1);
+		if (width < 2 || height < 2) {
+			break;
+		}
+		bloomChain[i].resize(width, height);
+		bloomLevels++;
+	}
+	if (bloomLevels == 0) {
+		return;
+	}
+
+	Shader& down = shaders.get(downsampleShader);
+	down.use();
+	down.setInt("source", 0);
+	down.setFloat("threshold", bloomThreshold);
+	down.setFloat("knee", bloomKnee);
+	for (int i = 0; i < bloomLevels; i++) {
+		const RenderTarget& source = i == 0 ? hdr : bloomChain[i - 1];
+		bloomChain[i].bind();
+		glState.bindTexture(0, source.colorTexture);
+		down.setBool("prefilter", i == 0);
+		down.setVec2("texelSize", 1.0f / source.width, 1.0f / source.height);
+		quad.draw();
+	}
+
+	Shader& up = shaders.get(upsampleShader);
+	up.use();
+	up.setInt("source", 0);
+	glState.setEnabled(GL_BLEND, true);
+	glBlendFunc(GL_ONE, GL_ONE);
+	for (int i = bloomLevels - 2; i >= 0; i--) {
+		const RenderTarget& source = bloomChain[i + 1];
+		bloomChain[i].bind();
+		glState.bindTexture(0, source.colorTexture);
+		up.setVec2("halfTexel", 0.5f / source.width, 0.5f / source.height);
+		quad.draw();
+	}
+	glState.setEnabled(GL_BLEND, false);
+}
+
+/* Average log luminance through the mip chain and move the adapted value toward it */
+void PostProcess::renderExposure(const RenderTarget& hdr, double deltaSeconds) {
+	Shader& logLuminance = shaders.get(luminanceShader);
+	logLuminance.use();
+	luminance.bind();
+	glState.bindTexture(0, hdr.colorTexture);
+	logLuminance.setInt("scene", 0);
+	quad.draw();
+	luminance.generateMipmaps();
+
+	int previous = currentAdapted;
+	currentAdapted = 1 - currentAdapted;
+	Shader& adapt = shaders.get(adaptShader);
+	adapt.use();
+	adapted[currentAdapted].bind();
+	glState.bindTexture(0, luminance.colorTexture);
+	glState.bindTexture(1, adapted[previous].colorTexture);
+	adapt.setInt("logLuminance", 0);
+	adapt.setInt("previous", 1);
+	adapt.setFloat("averageLevel", std::log2((float)LUMINANCE_SIZE));
+	adapt.setBool("historyValid", adaptedValid);
+	adapt.setFloat("adaptation", 1.0f - (float)std::exp(-deltaSeconds * adaptationSpeed));
+	quad.draw();
+	adaptedValid = true;
+}
+
+void PostProcess::render(const RenderTarget& hdr, int width, int height, double deltaSeconds) {
+	glState.setEnabled(GL_DEPTH_TEST, false);
+
+	if (bloomEnabled) {
+		bloomTimer.begin();
+		renderBloom(hdr);
+		bloomTimer.end();
+	}
+	if (autoExposureEnabled) {
+		exposureTimer.begin();
+		renderExposure(hdr, deltaSeconds);
+		exposureTimer.end();
+	}
+	else {
+		adaptedValid = false;
+	}
+
+	resolveTimer.begin();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+	Shader& resolve = shaders.get(resolveShader());
+	resolve.use();
+	glState.bindTexture(0, hdr.colorTexture);
+	glState.bindTexture(1, bloomChain[0].colorTexture);
+	glState.bindTexture(2, adapted[currentAdapted].colorTexture);
+	resolve.setInt("scene", 0);
+	resolve.setInt("bloom", 1);
+	resolve.setInt("adaptedLuminance", 2);
+	resolve.setVec2("texelSize", 1.0f / hdr.width, 1.0f / hdr.height);
+	resolve.setFloat("bloomStrength", bloomLevels > 0 ? bloomStrength : 0.0f);
+	resolve.setFloat("exposure", autoExposureEnabled ? exposureKey : exposure);
+	resolve.setFloat("minExposure", minExposure);
+	resolve.setFloat("maxExposure", maxExposure);
+	quad.draw();
+	resolveTimer.end();
+
+	glState.setEnabled(GL_DEPTH_TEST, true);
+}
+
+double PostProcess::lastMs() const {
+	return (bloomEnabled ? bloomTimer.lastMs : 0.0) + (autoExposureEnabled ? exposureTimer.lastMs : 0.0) + resolveTimer.lastMs;
+}
+
+void PostProcess::deleteBuffers() {
+	for (int i = 0; i < BLOOM_LEVELS; i++) {
+		bloomChain[i].deleteBuffers();
+	}
+	luminance.deleteBuffers();
+	adapted[0].deleteBuffers();
+	adapted[1].deleteBuffers();
+	quad.deleteBuffers();
+	bloomTimer.deleteQueries();
+	exposureTimer.deleteQueries();
+	resolveTimer.deleteQueries();
+}
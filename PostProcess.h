@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "ShaderManager.h"
+#include "RenderTarget.h"
+#include "FullscreenPass.h"
+#include "GpuTimer.h"
+
+// Bloom mip levels below the half resolution start of the chain
+const int BLOOM_LEVELS = 5;
+
+// Turns the HDR scene into the displayed image. Bloom is a dual Kawase down/up chain starting at half
+// resolution; exposure follows the geometric mean luminance, averaged on the GPU by a mip chain and
+// adapted over time without a readback; bloom composite, exposure, tone mapping and FXAA share one
+// full screen pass. Disabled effects are compiled out of that pass rather than branched over.
+class PostProcess {
+public:
+	bool bloomEnabled;
+	bool autoExposureEnabled;
+	bool toneMappingEnabled;
+	bool fxaaEnabled;
+	float bloomThreshold;      /* brightness where bloom starts */
+	float bloomKnee;           /* width of the soft transition around the threshold */
+	float bloomStrength;
+	float exposure;            /* used while auto exposure is off */
+	float exposureKey;         /* brightness the average luminance maps to with auto exposure */
+	float minExposure, maxExposure;
+	float adaptationSpeed;     /* per second; higher follows brightness changes faster */
+	float budgetMs;            /* GPU time the whole chain should stay under */
+	GpuTimer bloomTimer;
+	GpuTimer exposureTimer;
+	GpuTimer resolveTimer;     /* bloom composite + tone mapping + FXAA */
+
+	PostProcess(ShaderManager& shaders);
+	/* draw hdr into the window, which is width x height */
+	void render(const RenderTarget& hdr, int width, int height, double deltaSeconds);
+	double lastMs() const;     /* GPU time of the enabled passes, a few frames late */
+	void deleteBuffers();
+private:
+	ShaderManager& shaders;
+	ShaderHandle downsampleShader;
+	ShaderHandle upsampleShader;
+	ShaderHandle luminanceShader;
+	ShaderHandle adaptShader;
+	ShaderHandle resolveShaders[16];       /* by enabled effect mask, built on first use */
+	RenderTarget bloomChain[BLOOM_LEVELS];
+	RenderTarget luminance;                /* log luminance with mips down to 1x1 */
+	RenderTarget adapted[2];               /* ping-pong 1x1 adapted luminance */
+	FullscreenPass quad;
+	int currentAdapted;
+	bool adaptedValid;
+	int bloomLevels;                       /* levels in use, fewer for tiny inputs */
+	void renderBloom(const RenderTarget& hdr);
+	void renderExposure(const RenderTarget& hdr, double deltaSeconds);
+	ShaderHandle resolveShader();
+};
@@ -0,0 +1,72 @@
+#include "Ppm.h"
+
+#include <fstream>
+#include <iostream>
+
+bool writePpm(const std::string& fileName, const unsigned char* pixels, int width, int height) {
+	std::ofstream fout(fileName);
+	if (!fout) {
+		std::cout << "ERROR::PPM::CANNOT_WRITE: " << fileName << std::endl;
+		return false;
+	}
+	fout << "P3\n" << width << " " << height << "\n" << 255 << std::endl;
+	for (int i = 0; i < height; i++)
+	{
+		for (int j = 0; j < width; j++)
+		{
+			size_t cur = 3 * ((size_t)(height - i - 1) * width + j);
+			fout << (int)pixels[cur] << " " << (int)pixels[cur + 1] << " " << (int)pixels[cur + 2] << " ";
+		}
+		fout << std::endl;
+	}
+	fout.flush();
+	return (bool)fout;
+}
+
+bool readPpm(const std::string& fileName, PpmImage& image) {
+	std::ifstream fin(fileName, std::ios::binary);
+	std::string magic;
+	int maxValue = 0;
+	fin >> magic;
+	// comments may appear between the header fields
+	auto skipComments = [&fin]() {
+		fin >> std::ws;
+		while (fin.peek() == '#') {
+			std::string comment;
+			std::getline(fin, comment);
+			fin >> std::ws;
+		}
+	};
+	skipComments();
+	fin >> image.width;
+	skipComments();
+	fin >> image.height;
+	skipComments();
+	fin >> maxValue;
+	if (!fin || (magic != "P3" && magic != "P6") || image.width <= 0 || image.height <= 0 || maxValue != 255) {
+		std::cout << "ERROR::PPM::UNSUPPORTED_FILE: " << fileName << std::endl;
+		return false;
+	}
+	image.pixels.resize((size_t)image.width * image.height * 3);
+	size_t rowBytes = (size_t)image.width * 3;
+	if (magic == "P6") {
+		fin.get();
+		for (int row = image.height - 1; row >= 0; row--) {
+			fin.read((char*)&image.pixels[row * rowBytes], rowBytes);
+		}
+	}
+	else {
+		for (int row = image.height - 1; row >= 0 && fin; row--) {
+			for (size_t i = 0; i < rowBytes; i++) {
+				int value;
+				fin >> value;
+				image.pixels[row * rowBytes + i] = (unsigned char)value;
+			}
+		}
+	}
+	if (!fin) {
+		std::cout << "ERROR::PPM::TRUNCATED_FILE: " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
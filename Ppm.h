@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// An RGB image as the capture path stores it: 8 bits per channel, rows from bottom to top (the glReadPixels layout)
+struct PpmImage {
+	int width, height;
+	std::vector<unsigned char> pixels;
+};
+
+/* Write a text (P3) PPM, the format of the screenshots */
+bool writePpm(const std::string& fileName, const unsigned char* pixels, int width, int height);
+/* Read a text (P3) or binary (P6) PPM with 8-bit channels */
+bool readPpm(const std::string& fileName, PpmImage& image);
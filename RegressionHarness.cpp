@@ -0,0 +1,311 @@
+#include "RegressionHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// sRGB byte to CIELAB under D65
+static void toLab(const float* rgb, float* lab) {
+	float linear[3];
+	for (int c = 0; c < 3; c++) {
+		float v = rgb[c] / 255.0f;
+		linear[c] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+	float xyz[3] = {
+		(0.4124f * linear[0] + 0.3576f * linear[1] + 0.1805f * linear[2]) / 0.95047f,
+		0.2126f * linear[0] + 0.7152f * linear[1] + 0.0722f * linear[2],
+		(0.0193f * linear[0] + 0.1192f * linear[1] + 0.9505f * linear[2]) / 1.08883f
+	};
+	for (int c = 0; c < 3; c++) {
+		xyz[c] = xyz[c] > 0.008856f ? std::cbrt(xyz[c]) : 7.787f * xyz[c] + 16.0f / 116.0f;
+	}
+	lab[0] = 116.0f * xyz[1] - 16.0f;
+	lab[1] = 500.0f * (xyz[0] - xyz[1]);
+	lab[2] = 200.0f * (xyz[1] - xyz[2]);
+}
+
+// 3x3 box blur into CIELAB, edges clamped
+static std::vector<float> blurredLab(const PpmImage& image) {
+	int width = image.width, height = image.height;
+	std::vector<float> lab((size_t)width * height * 3);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for (int dy = -1; dy <= 1; dy++) {
+				int sy = std::min(std::max(y + dy, 0), height - 1);
+				for (int dx = -1; dx <= 1; dx++) {
+					int sx = std::min(std::max(x + dx, 0), width - 1);
+					const unsigned char* pixel = &image.pixels[3 * ((size_t)sy * width + sx)];
+					sum[0] += pixel[0];
+					sum[1] += pixel[1];
+					sum[2] += pixel[2];
+				}
+			}
+			sum[0] /= 9.0f;
+			sum[1] /= 9.0f;
+			sum[2] /= 9.0f;
+			toLab(sum, &lab[3 * ((size_t)y * width + x)]);
+		}
+	}
+	return lab;
+}
+
+ImageComparison compareImages(const PpmImage& golden, const PpmImage& current, float deltaEThreshold, PpmImage* diff) {
+	ImageComparison result = { false, 0.0, 0.0, 1.0 };
+	if (golden.width != current.width || golden.height != current.height) {
+		return result;
+	}
+	result.sizeMatches = true;
+	std::vector<float> goldenLab = blurredLab(golden);
+	std::vector<float> currentLab = blurredLab(current);
+	size_t pixelCount = (size_t)golden.width * golden.height;
+	if (diff) {
+		diff->width = golden.width;
+		diff->height = golden.height;
+		diff->pixels.assign(pixelCount * 3, 0);
+	}
+	size_t changed = 0;
+	double sum = 0.0;
+	for (size_t i = 0; i < pixelCount; i++) {
+		const float* a = &goldenLab[3 * i];
+		const float* b = &currentLab[3 * i];
+		double deltaE = std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+		sum += deltaE;
+		result.maxDeltaE = std::max(result.maxDeltaE, deltaE);
+		bool isChanged = deltaE > deltaEThreshold;
+		changed += isChanged;
+		if (diff) {
+			// changed pixels in red, the rest as a dim copy of the golden image so the changes can be located
+			unsigned char* out = &diff->pixels[3 * i];
+			if (isChanged) {
+				out[0] = 255;
+			}
+			else {
+				unsigned char gray = (unsigned char)((golden.pixels[3 * i] + golden.pixels[3 * i + 1] + golden.pixels[3 * i + 2]) / 12);
+				out[0] = out[1] = out[2] = gray;
+			}
+		}
+	}
+	result.meanDeltaE = sum / pixelCount;
+	result.changedFraction = (double)changed / pixelCount;
+	return result;
+}
+
+bool writeFrameTimes(const std::string& fileName, const std::vector<double>& frameMs) {
+	std::ofstream fout(fileName);
+	if (!fout) {
+		std::cout << "ERROR::REGRESSION::CANNOT_WRITE: " << fileName << std::endl;
+		return false;
+	}
+	for (double ms : frameMs) {
+		fout << ms << "\n";
+	}
+	return true;
+}
+
+bool readFrameTimes(const std::string& fileName, std::vector<double>& frameMs) {
+	std::ifstream fin(fileName);
+	if (!fin) {
+		return false;
+	}
+	frameMs.clear();
+	double ms;
+	while (fin >> ms) {
+		frameMs.push_back(ms);
+	}
+	return !frameMs.empty();
+}
+
+FrameTimeStats frameTimeStats(const std::vector<double>& frameMs, float warmupFraction) {
+	FrameTimeStats stats = { 0, 0.0, 0.0, 0.0 };
+	size_t skip = std::min(frameMs.size() - std::min(frameMs.size(), (size_t)1), (size_t)(frameMs.size() * warmupFraction));
+	std::vector<double> sorted(frameMs.begin() + skip, frameMs.end());
+	if (sorted.empty()) {
+		return stats;
+	}
+	std::sort(sorted.begin(), sorted.end());
+	stats.frames = (int)sorted.size();
+	for (double ms : sorted) {
+		stats.meanMs += ms;
+	}
+	stats.meanMs /= sorted.size();
+	// nearest rank
+	stats.p50Ms = sorted[std::min(sorted.size() - 1, (size_t)std::ceil(0.50 * sorted.size()) - 1)];
+	stats.p99Ms = sorted[std::min(sorted.size() - 1, (size_t)std::ceil(0.99 * sorted.size()) - 1)];
+	return stats;
+}
+
+RegressionHarness::RegressionHarness(std::string executable) : executable(executable) {
+	deltaE = 6.0f;
+	changedFraction = 0.005f;
+	timeTolerance = 0.15f;
+	warmupFraction = 0.1f;
+	update = false;
+}
+
+int RegressionHarness::run(const std::string& scriptPath) {
+	std::ifstream fin(scriptPath);
+	if (!fin) {
+		std::cout << "ERROR::REGRESSION::SCRIPT_NOT_FOUND: " << scriptPath << std::endl;
+		return 1;
+	}
+	directory = std::filesystem::path(scriptPath).parent_path().string();
+	if (directory.empty()) {
+		directory = ".";
+	}
+	std::error_code error;
+	std::filesystem::create_directories(directory + "/out", error);
+	std::filesystem::create_directories(directory + "/golden", error);
+	loadBaselines();
+
+	int caseCount = 0, failed = 0;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(fin, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string name;
+		if (!(words >> name)) {
+			continue;
+		}
+		if (name == "set") {
+			std::string setting;
+			float value;
+			if (!(words >> setting >> value)) {
+				std::cout << "ERROR::REGRESSION::BAD_SETTING: line " << lineNumber << std::endl;
+				continue;
+			}
+			if (setting == "delta-e") deltaE = value;
+			else if (setting == "changed-pixels") changedFraction = value;
+			else if (setting == "time-tolerance") timeTolerance = value;
+			else if (setting == "warmup") warmupFraction = value;
+			else std::cout << "ERROR::REGRESSION::UNKNOWN_SETTING: " << setting << " on line " << lineNumber << std::endl;
+			continue;
+		}
+		std::string options;
+		std::getline(words, options);
+		caseCount++;
+		if (!runCase(name, options)) {
+			failed++;
+		}
+	}
+	if (update) {
+		saveBaselines();
+	}
+	std::cout << "Regression: " << caseCount - failed << " of " << caseCount << " cases passed" << (update ? " (goldens updated)" : "") << std::endl;
+	return failed;
+}
+
+bool RegressionHarness::runCase(const std::string& name, const std::string& options) {
+	std::string imagePath = directory + "/out/" + name + ".ppm";
+	std::string timesPath = directory + "/out/" + name + ".txt";
+	std::error_code error;
+	std::filesystem::remove(imagePath, error);
+	std::filesystem::remove(timesPath, error);
+	// the children run hidden with the lights frozen where the scene starts, so every run draws the same frame
+	std::string command = "\"" + executable + "\"" + options + " --capture \"" + imagePath + "\" --frame-times \"" + timesPath
+		+ "\" --hidden on --paused on";
+	std::cout << name << ":" << std::endl;
+	int status = std::system(command.c_str());
+	if (status != 0) {
+		std::cout << "  FAIL: exited with status " << status << std::endl;
+		return false;
+	}
+	bool imagePassed = checkImage(name);
+	bool timesPassed = checkFrameTimes(name);
+	return imagePassed && timesPassed;
+}
+
+bool RegressionHarness::checkImage(const std::string& name) {
+	std::string imagePath = directory + "/out/" + name + ".ppm";
+	std::string goldenPath = directory + "/golden/" + name + ".ppm";
+	PpmImage current;
+	if (!readPpm(imagePath, current)) {
+		std::cout << "  image FAIL: no frame was captured" << std::endl;
+		return false;
+	}
+	PpmImage golden;
+	if (update || !std::filesystem::exists(goldenPath)) {
+		std::error_code error;
+		std::filesystem::copy_file(imagePath, goldenPath, std::filesystem::copy_options::overwrite_existing, error);
+		std::cout << "  image: stored as the golden image" << std::endl;
+		return !error;
+	}
+	// a damaged golden is replaced only on request (--regress-update on), never by whatever this run drew
+	if (!readPpm(goldenPath, golden)) {
+		std::cout << "  image FAIL: golden image " << goldenPath << " cannot be read" << std::endl;
+		return false;
+	}
+	PpmImage diff;
+	ImageComparison comparison = compareImages(golden, current, deltaE, &diff);
+	if (!comparison.sizeMatches) {
+		std::cout << "  image FAIL: " << current.width << "x" << current.height << ", golden is " << golden.width << "x" << golden.height << std::endl;
+		return false;
+	}
+	bool passed = comparison.changedFraction <= changedFraction;
+	std::cout << "  image " << (passed ? "ok" : "FAIL") << ": " << 100.0 * comparison.changedFraction << "% of pixels changed (limit "
+		<< 100.0f * changedFraction << "%), mean dE " << comparison.meanDeltaE << ", max dE " << comparison.maxDeltaE << std::endl;
+	if (!passed) {
+		std::string diffPath = directory + "/out/" + name + "-diff.ppm";
+		writePpm(diffPath, diff.pixels.data(), diff.width, diff.height);
+		std::cout << "  changed pixels: " << diffPath << std::endl;
+	}
+	return passed;
+}
+
+bool RegressionHarness::checkFrameTimes(const std::string& name) {
+	std::vector<double> frameMs;
+	if (!readFrameTimes(directory + "/out/" + name + ".txt", frameMs)) {
+		std::cout << "  frame times FAIL: none were recorded" << std::endl;
+		return false;
+	}
+	FrameTimeStats stats = frameTimeStats(frameMs, warmupFraction);
+	std::vector<Baseline>::iterator baseline = std::find_if(baselines.begin(), baselines.end(),
+		[&name](const Baseline& b) { return b.name == name; });
+	if (update || baseline == baselines.end()) {
+		if (baseline == baselines.end()) {
+			baselines.push_back({ name, stats.p50Ms, stats.p99Ms });
+			if (!update) {
+				saveBaselines();
+			}
+		}
+		else {
+			baseline->p50Ms = stats.p50Ms;
+			baseline->p99Ms = stats.p99Ms;
+		}
+		std::cout << "  frame times: p50 " << stats.p50Ms << " ms, p99 " << stats.p99Ms << " ms stored as the baseline" << std::endl;
+		return true;
+	}
+	// p99 of a short run is noisy, so it gets twice the tolerance of the median
+	bool passed = stats.p50Ms <= baseline->p50Ms * (1.0 + timeTolerance) && stats.p99Ms <= baseline->p99Ms * (1.0 + 2.0 * timeTolerance);
+	std::cout << "  frame times " << (passed ? "ok" : "FAIL") << ": p50 " << stats.p50Ms << " ms (baseline " << baseline->p50Ms << "), p99 "
+		<< stats.p99Ms << " ms (baseline " << baseline->p99Ms << ") over " << stats.frames << " frames" << std::endl;
+	return passed;
+}
+
+void RegressionHarness::loadBaselines() {
+	baselines.clear();
+	std::ifstream fin(directory + "/baselines.txt");
+	std::string line;
+	while (std::getline(fin, line)) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		Baseline baseline;
+		if (words >> baseline.name >> baseline.p50Ms >> baseline.p99Ms) {
+			baselines.push_back(baseline);
+		}
+	}
+}
+
+void RegressionHarness::saveBaselines() {
+	std::ofstream fout(directory + "/baselines.txt");
+	fout << "# case p50-ms p99-ms, recorded on the machine the regression cases run on" << std::endl;
+	for (const Baseline& baseline : baselines) {
+		fout << baseline.name << " " << baseline.p50Ms << " " << baseline.p99Ms << std::endl;
+	}
+}
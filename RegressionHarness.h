@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Ppm.h"
+
+// How far a frame strayed from its golden image. Both are blurred 3x3 first so single-pixel edge and texture
+// sampling differences between drivers wash out, then compared per pixel as a CIE76 color difference.
+struct ImageComparison {
+	bool sizeMatches;
+	double meanDeltaE;
+	double maxDeltaE;
+	double changedFraction;   /* share of pixels whose difference exceeds the threshold */
+};
+
+struct FrameTimeStats {
+	int frames;               /* frames left after dropping the warmup */
+	double meanMs, p50Ms, p99Ms;
+};
+
+/* Compare two images; diff (if given) receives the per-pixel difference, changed pixels in red */
+ImageComparison compareImages(const PpmImage& golden, const PpmImage& current, float deltaEThreshold, PpmImage* diff);
+/* One frame time in milliseconds per line */
+bool writeFrameTimes(const std::string& fileName, const std::vector<double>& frameMs);
+bool readFrameTimes(const std::string& fileName, std::vector<double>& frameMs);
+/* Percentiles of the frames after the first warmupFraction of them */
+FrameTimeStats frameTimeStats(const std::vector<double>& frameMs, float warmupFraction);
+
+// Golden-image and frame-time regression runner. A case script lists one case per line as a name followed by the
+// command line options to run this executable with (e.g. "software-3 --software 16 --spotlights 3"); lines of the form
+// "set NAME VALUE" change the tolerances below for the cases after them, and # starts a comment. Every case is run
+// as a child process that writes its last frame and its frame times, and the results are checked against
+// golden/NAME.ppm and baselines.txt next to the script. Missing goldens and baselines are recorded instead of failing.
+class RegressionHarness {
+public:
+	float deltaE;              /* "set delta-e": color difference a blurred pixel may have before it counts as changed */
+	float changedFraction;     /* "set changed-pixels": share of changed pixels a case may have */
+	float timeTolerance;       /* "set time-tolerance": allowed growth of p50 over the baseline, 0.15 = 15% (p99 gets twice that) */
+	float warmupFraction;      /* "set warmup": share of the first frames left out of the statistics */
+	bool update;               /* store every result as the new golden image and baseline instead of comparing */
+
+	RegressionHarness(std::string executable);
+	// run every case of the script; returns the number of failed cases
+	int run(const std::string& scriptPath);
+private:
+	struct Baseline {
+		std::string name;
+		double p50Ms, p99Ms;
+	};
+	std::string executable;
+	std::string directory;
+	std::vector<Baseline> baselines;
+	bool runCase(const std::string& name, const std::string& options);
+	bool checkImage(const std::string& name);
+	bool checkFrameTimes(const std::string& name);
+	void loadBaselines();
+	void saveBaselines();
+};
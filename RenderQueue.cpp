@@ -0,0 +1,112 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+const int KEY_ID_BITS = 12;
+const int KEY_DEPTH_BITS = 26;
+const int KEY_PASS_SHIFT = 62;
+
+RenderQueue::RenderQueue(ThreadPool& pool) : pool(pool) {
+	parallelThreshold = 1024;
+}
+
+static unsigned long long keyId(unsigned int id) {
+	return id & ((1u << KEY_ID_BITS) - 1);
+}
+
+static unsigned long long keyDepth(float depth) {
+	// in double: a float cannot hold maxDepth, and rounding it up would carry into the bits above
+	const unsigned long long maxDepth = (1u << KEY_DEPTH_BITS) - 1;
+	return std::min<unsigned long long>(maxDepth, (unsigned long long)(std::clamp((double)depth, 0.0, 1.0) * maxDepth));
+}
+
+unsigned long long RenderQueue::opaqueKey(unsigned int program, unsigned int texture, unsigned int vao, float depth) {
+	return ((unsigned long long)RenderPass::Opaque << KEY_PASS_SHIFT)
+		| (keyId(program) << (KEY_DEPTH_BITS + 2 * KEY_ID_BITS))
+		| (keyId(texture) << (KEY_DEPTH_BITS + KEY_ID_BITS))
+		| (keyId(vao) << KEY_DEPTH_BITS)
+		| keyDepth(depth);
+}
+
+unsigned long long RenderQueue::transparentKey(unsigned int program, unsigned int texture, unsigned int vao, float depth) {
+	const unsigned long long maxDepth = (1u << KEY_DEPTH_BITS) - 1;
+	return ((unsigned long long)RenderPass::Transparent << KEY_PASS_SHIFT)
+		| ((maxDepth - keyDepth(depth)) << (3 * KEY_ID_BITS))
+		| (keyId(program) << (2 * KEY_ID_BITS))
+		| (keyId(texture) << KEY_ID_BITS)
+		| keyId(vao);
+}
+
+void RenderQueue::build(int count, const std::function<void(int, std::vector<RenderItem>&)>& emit) {
+	// Fixed chunks rather than one bucket per thread: the merge order, and so the result, does not depend on scheduling
+	int chunkCount = count >= parallelThreshold ? (int)pool.size() * 4 : 1;
+	int chunkSize = std::max(1, (count + chunkCount - 1) / chunkCount);
+	chunkCount = std::max(1, (count + chunkSize - 1) / chunkSize);
+	if ((int)buckets.size() < chunkCount) {
+		buckets.resize(chunkCount);
+	}
+
+	auto traverse = [&](int beginChunk, int endChunk) {
+		for (int chunk = beginChunk; chunk < endChunk; chunk++) {
+			std::vector<RenderItem>& bucket = buckets[chunk];
+			bucket.clear();
+			int end = std::min(count, (chunk + 1) * chunkSize);
+			for (int i = chunk * chunkSize; i < end; i++) {
+				emit(i, bucket);
+			}
+		}
+	};
+	if (chunkCount > 1) {
+		pool.parallelFor(chunkCount, 1, traverse);
+	}
+	else {
+		traverse(0, 1);
+	}
+
+	size_t total = 0;
+	for (int chunk = 0; chunk < chunkCount; chunk++) {
+		total += buckets[chunk].size();
+	}
+	sorted.clear();
+	sorted.reserve(total);
+	for (int chunk = 0; chunk < chunkCount; chunk++) {
+		sorted.insert(sorted.end(), buckets[chunk].begin(), buckets[chunk].end());
+	}
+}
+
+/* Eight 8-bit counting passes, least significant byte first. All histograms come from one read of
+   the keys, and a byte that is the same in every key is skipped, which is common for the pass and id bytes. */
+void RenderQueue::sort() {
+	size_t count = sorted.size();
+	if (count < 2) {
+		return;
+	}
+	size_t histograms[8][256] = {};
+	for (const RenderItem& item : sorted) {
+		for (int byte = 0; byte < 8; byte++) {
+			histograms[byte][(item.key >> (8 * byte)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(count);
+	for (int byte = 0; byte < 8; byte++) {
+		size_t* histogram = histograms[byte];
+		if (histogram[(sorted[0].key >> (8 * byte)) & 0xFF] == count) {
+			continue;
+		}
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (const RenderItem& item : sorted) {
+			scratch[histogram[(item.key >> (8 * byte)) & 0xFF]++] = item;
+		}
+		sorted.swap(scratch);
+	}
+}
+
+const std::vector<RenderItem>& RenderQueue::items() const {
+	return sorted;
+}
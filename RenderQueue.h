@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "ThreadPool.h"
+
+// Highest bits of a sort key; every opaque draw is replayed before any transparent one
+enum class RenderPass {
+	Opaque = 0,
+	Transparent = 1
+};
+
+// One draw: the sort key and the index of the object it came from
+struct RenderItem {
+	unsigned long long key;
+	unsigned int index;
+};
+
+// Draw list sorted by 64-bit keys. Objects are traversed on the thread pool, each chunk emitting
+// into its own bucket, then the buckets are merged, radix sorted and replayed on the GL thread.
+//
+// Key layout, most significant first:
+//   opaque:       pass(2) program(12) texture(12) vao(12) depth(26)   state changes first, then front to back
+//   transparent:  pass(2) depth(26) program(12) texture(12) vao(12)   back to front, depth inverted
+// Ids are truncated to 12 bits; a collision only costs a state change, the draw itself comes from the index.
+class RenderQueue {
+public:
+	int parallelThreshold;                 /* objects below this are traversed on the calling thread */
+
+	RenderQueue(ThreadPool& pool);
+
+	// depth is the normalized distance from the camera, 0 at the near plane and 1 at the far plane
+	static unsigned long long opaqueKey(unsigned int program, unsigned int texture, unsigned int vao, float depth);
+	static unsigned long long transparentKey(unsigned int program, unsigned int texture, unsigned int vao, float depth);
+
+	// Run emit(index, bucket) for every object in [0, count); emit appends zero or more items to the bucket.
+	// emit runs concurrently on the pool, so it may only write state belonging to its own index.
+	void build(int count, const std::function<void(int, std::vector<RenderItem>&)>& emit);
+	// Stable LSD radix sort of the built items by key
+	void sort();
+	const std::vector<RenderItem>& items() const;
+private:
+	ThreadPool& pool;
+	std::vector<std::vector<RenderItem>> buckets;   /* one per traversal chunk, reused between frames */
+	std::vector<RenderItem> sorted;
+	std::vector<RenderItem> scratch;
+};
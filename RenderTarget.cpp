@@ -0,0 +1,89 @@
+#include "RenderTarget.h"
+#include "GLState.h"
+
+RenderTarget::RenderTarget(int width, int height, GLenum colorFormat, bool withDepth, bool withVelocity)
+	: FBO(0), colorTexture(0), depthTexture(0), velocityTexture(0), width(width), height(height), colorFormat(colorFormat),
+	withDepth(withDepth), withVelocity(withVelocity) {
+	create();
+}
+
+void RenderTarget::create() {
+	glGenTextures(1, &colorTexture);
+	glState.bindTexture(0, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+	if (withDepth) {
+		glGenTextures(1, &depthTexture);
+		glState.bindTexture(0, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	}
+
+	if (withVelocity) {
+		glGenTextures(1, &velocityTexture);
+		glState.bindTexture(0, velocityTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, width, height, 0, GL_RG, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, velocityTexture, 0);
+		GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, buffers);
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::RENDER_TARGET::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Recreate the attachments at a new size; the old contents are lost */
+void RenderTarget::resize(int newWidth, int newHeight) {
+	if (newWidth == width && newHeight == height) {
+		return;
+	}
+	deleteBuffers();
+	width = newWidth;
+	height = newHeight;
+	create();
+}
+
+void RenderTarget::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, width, height);
+}
+
+void RenderTarget::generateMipmaps() {
+	glState.bindTexture(0, colorTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void RenderTarget::deleteBuffers() {
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &colorTexture);
+	glState.textureDeleted(colorTexture);
+	if (depthTexture != 0) {
+		glDeleteTextures(1, &depthTexture);
+		glState.textureDeleted(depthTexture);
+		depthTexture = 0;
+	}
+	if (velocityTexture != 0) {
+		glDeleteTextures(1, &velocityTexture);
+		glState.textureDeleted(velocityTexture);
+		velocityTexture = 0;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+
+// Offscreen framebuffer with a sampleable color texture, optional depth texture and optional
+// RG16F screen-space velocity as a second color attachment
+class RenderTarget {
+public:
+	unsigned int FBO;
+	unsigned int colorTexture;
+	unsigned int depthTexture;             /* 0 when created without depth */
+	unsigned int velocityTexture;          /* 0 when created without velocity */
+	int width, height;
+
+	RenderTarget(int width, int height, GLenum colorFormat, bool withDepth, bool withVelocity = false);
+	void resize(int width, int height);
+	void bind() const;                     /* bind as draw target and cover it with the viewport */
+	void generateMipmaps();                /* rebuild the color mip chain from level 0 and sample through it */
+	void deleteBuffers();
+private:
+	GLenum colorFormat;
+	bool withDepth;
+	bool withVelocity;
+	void create();
+};
@@ -0,0 +1,165 @@
+#include "Scene.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+Scene::Scene() {
+	parallelThreshold = 4096;
+	updatedCount = 0;
+}
+
+int Scene::createEntity(int parent, int mesh, const CullBounds& bounds) {
+	int entity = size();
+	if (parent >= entity) {
+		parent = NO_PARENT;
+	}
+	positions.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	scales.push_back(glm::vec3(1.0f));
+	parents.push_back(parent);
+	worldMatrices.push_back(glm::mat4(1.0f));
+	previousWorldMatrices.push_back(glm::mat4(1.0f));
+	worldBounds.push_back(bounds);
+	localBounds.push_back(bounds);
+	meshes.push_back(mesh);
+	dirty.push_back(2);  /* never placed: no motion on the first update */
+	moved.push_back(0);
+
+	int depth = parent == NO_PARENT ? 0 : depths[parent] + 1;
+	depths.push_back(depth);
+	if ((int)levels.size() <= depth) {
+		levels.resize(depth + 1);
+	}
+	levels[depth].push_back(entity);
+	return entity;
+}
+
+void Scene::setPosition(int entity, const glm::vec3& position) {
+	positions[entity] = position;
+	dirty[entity] = std::max(dirty[entity], (unsigned char)1);
+}
+
+void Scene::setRotation(int entity, const glm::vec4& rotation) {
+	rotations[entity] = rotation;
+	dirty[entity] = std::max(dirty[entity], (unsigned char)1);
+}
+
+void Scene::setScale(int entity, const glm::vec3& scale) {
+	scales[entity] = scale;
+	dirty[entity] = std::max(dirty[entity], (unsigned char)1);
+}
+
+int Scene::size() const {
+	return (int)parents.size();
+}
+
+int Scene::lastUpdatedCount() const {
+	return updatedCount;
+}
+
+/* Column-major 4x4 product out = a * b: each column of out is the columns of a weighted by a column of b */
+static inline void multiplyMatrices(const float* a, const float* b, float* out) {
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	for (int column = 0; column < 4; column++) {
+		const float* bc = b + 4 * column;
+		__m128 result = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+		result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+		result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+		result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+		_mm_storeu_ps(out + 4 * column, result);
+	}
+}
+
+/* Translation * rotation * scale, written directly as columns */
+static inline void composeLocal(const glm::vec3& t, const glm::vec4& q, const glm::vec3& s, float* out) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	out[0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+	out[1] = 2.0f * (xy + wz) * s.x;
+	out[2] = 2.0f * (xz - wy) * s.x;
+	out[3] = 0.0f;
+	out[4] = 2.0f * (xy - wz) * s.y;
+	out[5] = (1.0f - 2.0f * (xx + zz)) * s.y;
+	out[6] = 2.0f * (yz + wx) * s.y;
+	out[7] = 0.0f;
+	out[8] = 2.0f * (xz + wy) * s.z;
+	out[9] = 2.0f * (yz - wx) * s.z;
+	out[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+	out[11] = 0.0f;
+	out[12] = t.x;
+	out[13] = t.y;
+	out[14] = t.z;
+	out[15] = 1.0f;
+}
+
+void Scene::updateRange(const int* entities, int begin, int end) {
+	float local[16];
+	for (int k = begin; k < end; k++) {
+		int i = entities[k];
+		int parent = parents[i];
+		// an entity moves when its own transform changed or its parent moved in this update
+		if (!dirty[i] && (parent == NO_PARENT || !moved[parent])) {
+			// it stopped: the previous matrix catches up once
+			if (moved[i]) {
+				previousWorldMatrices[i] = worldMatrices[i];
+			}
+			moved[i] = 0;
+			continue;
+		}
+		previousWorldMatrices[i] = worldMatrices[i];
+		float* world = &worldMatrices[i][0][0];
+		if (parent == NO_PARENT) {
+			composeLocal(positions[i], rotations[i], scales[i], world);
+		}
+		else {
+			composeLocal(positions[i], rotations[i], scales[i], local);
+			multiplyMatrices(&worldMatrices[parent][0][0], local, world);
+		}
+		if (dirty[i] == 2) {
+			previousWorldMatrices[i] = worldMatrices[i];
+		}
+		dirty[i] = 0;
+		moved[i] = 1;
+
+		// bounds follow the largest axis scale so the sphere stays conservative
+		__m128 c0 = _mm_loadu_ps(world);
+		__m128 c1 = _mm_loadu_ps(world + 4);
+		__m128 c2 = _mm_loadu_ps(world + 8);
+		const glm::vec3& center = localBounds[i].center;
+		__m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(center.x)), _mm_mul_ps(c1, _mm_set1_ps(center.y))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(center.z)), _mm_loadu_ps(world + 12)));
+		float transformed[4], lengths[4];
+		_mm_storeu_ps(transformed, p);
+		// squared column lengths: transpose the three columns and sum the squares of x, y and z
+		__m128 c3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(lengths, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, c0), _mm_mul_ps(c1, c1)), _mm_mul_ps(c2, c2)));
+		worldBounds[i].center = glm::vec3(transformed[0], transformed[1], transformed[2]);
+		worldBounds[i].radius = localBounds[i].radius * std::sqrt(std::max(lengths[0], std::max(lengths[1], lengths[2])));
+	}
+}
+
+void Scene::updateTransforms(ThreadPool* pool) {
+	// Entities of one depth only read the level above, so a level can be split across threads
+	for (const std::vector<int>& level : levels) {
+		int count = (int)level.size();
+		if (pool && count >= parallelThreshold) {
+			pool->parallelFor(count, 1024, [this, &level](int begin, int end) {
+				updateRange(level.data(), begin, end);
+			});
+		}
+		else {
+			updateRange(level.data(), 0, count);
+		}
+	}
+	int total = 0;
+	for (unsigned char value : moved) {
+		total += value;
+	}
+	updatedCount = total;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "LightCuller.h"
+#include "ThreadPool.h"
+
+const int NO_PARENT = -1;
+const int NO_MESH = -1;
+
+// Entities stored as structure of arrays: entity i is index i of every array. A parent is always
+// created before its children; updates walk the hierarchy one depth level at a time and only
+// recompute world matrices of entities whose local transform, or an ancestor's, changed.
+class Scene {
+public:
+	// local transform
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec4> rotations;      /* unit quaternion, xyz vector part and w */
+	std::vector<glm::vec3> scales;
+	std::vector<int> parents;              /* NO_PARENT for roots, otherwise a smaller index */
+	// results of updateTransforms
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<glm::mat4> previousWorldMatrices;  /* world matrices one update earlier, for motion vectors */
+	std::vector<CullBounds> worldBounds;
+	// what to draw
+	std::vector<CullBounds> localBounds;   /* object-space bounding sphere */
+	std::vector<int> meshes;               /* handle into the caller's mesh table, NO_MESH for pure transforms */
+
+	int parallelThreshold;                 /* dirty entities in a hierarchy level from which it is split across the pool */
+
+	Scene();
+	int createEntity(int parent, int mesh, const CullBounds& bounds);
+	void setPosition(int entity, const glm::vec3& position);
+	void setRotation(int entity, const glm::vec4& rotation);
+	void setScale(int entity, const glm::vec3& scale);
+	int size() const;
+
+	// Recompute world matrices and bounds of dirty entities; pool may be null to stay on this thread
+	void updateTransforms(ThreadPool* pool);
+	// entities whose world matrix changed in the last updateTransforms
+	int lastUpdatedCount() const;
+private:
+	std::vector<unsigned char> dirty;      /* 1: local transform changed since the last update, 2: never updated */
+	std::vector<unsigned char> moved;      /* world matrix recomputed in the current update */
+	std::vector<int> depths;
+	std::vector<std::vector<int>> levels;  /* entities grouped by hierarchy depth, for the threaded update */
+	int updatedCount;
+	void updateRange(const int* entities, int begin, int end);
+};
@@ -0,0 +1,100 @@
+#include "SceneFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// the falloff of the built-in spots
+static const glm::vec3 SCENE_LIGHT_ATTENUATION = glm::vec3(1.0f, 0.35f * 1e-4f, 0.44f * 1e-4f);
+
+bool SceneFile::load(const std::string& fileName, float rangeThreshold) {
+	std::ifstream fin(fileName);
+	if (!fin) {
+		std::cout << "ERROR::SCENE::FILE_NOT_FOUND: " << fileName << std::endl;
+		return false;
+	}
+	std::filesystem::path directory = std::filesystem::path(fileName).parent_path();
+	objectPaths.clear();
+	texturePaths.clear();
+	instances.clear();
+	spotlights.clear();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(fin, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string kind;
+		if (!(words >> kind)) {
+			continue;
+		}
+		bool valid = true;
+		if (kind == "mesh") {
+			std::string objectPath, texturePath;
+			valid = (bool)(words >> objectPath);
+			words >> texturePath;
+			if (valid) {
+				objectPaths.push_back((directory / objectPath).string());
+				texturePaths.push_back(texturePath.empty() ? "" : (directory / texturePath).string());
+			}
+		}
+		else if (kind == "instance") {
+			SceneInstance instance;
+			valid = (bool)(words >> instance.mesh >> instance.position.x >> instance.position.y >> instance.position.z
+				>> instance.yawDegrees >> instance.scale) && instance.mesh >= 0 && instance.mesh < (int)objectPaths.size();
+			if (valid) {
+				instances.push_back(instance);
+			}
+		}
+		else if (kind == "spotlight") {
+			SpotLight light;
+			float cutoffDegrees;
+			valid = (bool)(words >> light.position.x >> light.position.y >> light.position.z >> light.direction.x >> light.direction.y
+				>> light.direction.z >> light.diffuse.x >> light.diffuse.y >> light.diffuse.z >> cutoffDegrees);
+			if (valid) {
+				if (!(words >> light.ambient.x >> light.ambient.y >> light.ambient.z)) {
+					light.ambient = glm::vec3(0.0f);
+				}
+				light.attenuation = SCENE_LIGHT_ATTENUATION;
+				light.cutoffAngle = glm::cos(glm::radians(cutoffDegrees));
+				light.range = spotLightRange(light, rangeThreshold);
+				spotlights.push_back(light);
+			}
+		}
+		else {
+			valid = false;
+		}
+		if (!valid) {
+			std::cout << "ERROR::SCENE::BAD_LINE: " << fileName << ":" << lineNumber << ": " << line << std::endl;
+			return false;
+		}
+	}
+	if (spotlights.size() > (size_t)MAX_SPOTLIGHTS) {
+		std::cout << "ERROR::SCENE::TOO_MANY_SPOTLIGHTS: " << spotlights.size() << ", the shaders hold " << MAX_SPOTLIGHTS << std::endl;
+		spotlights.resize(MAX_SPOTLIGHTS);
+	}
+	return true;
+}
+
+bool SceneFile::save(const std::string& fileName) const {
+	std::ofstream fout(fileName);
+	if (!fout) {
+		std::cout << "ERROR::SCENE::CANNOT_WRITE: " << fileName << std::endl;
+		return false;
+	}
+	fout << "# " << objectPaths.size() << " meshes, " << instances.size() << " instances, " << spotlights.size() << " spotlights" << std::endl;
+	for (size_t i = 0; i < objectPaths.size(); i++) {
+		fout << "mesh " << objectPaths[i] << (texturePaths[i].empty() ? "" : " " + texturePaths[i]) << std::endl;
+	}
+	for (const SceneInstance& instance : instances) {
+		fout << "instance " << instance.mesh << " " << instance.position.x << " " << instance.position.y << " " << instance.position.z << " "
+			<< instance.yawDegrees << " " << instance.scale << std::endl;
+	}
+	for (const SpotLight& light : spotlights) {
+		fout << "spotlight " << light.position.x << " " << light.position.y << " " << light.position.z << " " << light.direction.x << " "
+			<< light.direction.y << " " << light.direction.z << " " << light.diffuse.x << " " << light.diffuse.y << " " << light.diffuse.z << " "
+			<< glm::degrees(glm::acos(light.cutoffAngle)) << " " << light.ambient.x << " " << light.ambient.y << " " << light.ambient.z << std::endl;
+	}
+	return (bool)fout;
+}
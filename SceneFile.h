@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "SpotLight.h"
+
+// One placement of a mesh: turned about the vertical axis, scaled uniformly, then moved
+struct SceneInstance {
+	int mesh;
+	glm::vec3 position;
+	float yawDegrees;
+	float scale;
+};
+
+// A scene to draw instead of the built-in one, stored as text with one item per line:
+//   mesh OBJ [TEXTURE]                                   paths relative to the scene file
+//   instance MESH X Y Z YAW_DEGREES SCALE                MESH counts the mesh lines from 0
+//   spotlight X Y Z DX DY DZ R G B CUTOFF_DEGREES [AMBIENT_R AMBIENT_G AMBIENT_B]
+// # starts a comment. Spotlights get the attenuation of the built-in spots.
+class SceneFile {
+public:
+	std::vector<std::string> objectPaths;
+	std::vector<std::string> texturePaths;   /* empty for an untextured mesh */
+	std::vector<SceneInstance> instances;
+	std::vector<SpotLight> spotlights;
+
+	// paths come back resolved against the file's directory; rangeThreshold sets the spotlights' range
+	bool load(const std::string& fileName, float rangeThreshold);
+	// paths are written as they are, so they should already be relative to the file
+	bool save(const std::string& fileName) const;
+};
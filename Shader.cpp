@@ -1,6 +1,41 @@
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <filesystem>
+
+std::string Shader::binaryCacheDirectory = "shader_cache";
+int Shader::binaryCacheMaxFiles = 256;
+
+// Header written in front of every cached program binary
+struct ProgramBinaryHeader {
+	unsigned int magic;
+	unsigned int binaryFormat;
+	unsigned long long key;
+	unsigned int length;
+};
+const unsigned int PROGRAM_BINARY_MAGIC = 0x42505344;   // "DSPB"
+
+Shader::Shader() : ID(0), fromBinaryCache(false), linkPending(false), vertexStage(0), fragmentStage(0), binaryKeyValue(0) {
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines) : Shader() {
+	submit(vertexPath, fragmentPath, defines);
+	finish();
+}
+
+bool Shader::submit(const char* vertexPath, const char* fragmentPath, const std::string& defines) {
+	fromBinaryCache = false;
+	linkPending = false;
+	uniformLocations.clear();
+	uniformValues.clear();
+	blockBindings.clear();
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	// 1. Retrieve the vertex & fragment shader source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -11,6 +46,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	vertexShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 	fragmentShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
+	bool sourcesRead = true;
 	try {
 		// Open files
 		vertexShaderFile.open(vertexPath);
@@ -31,104 +67,370 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	}
 	catch (std::ifstream::failure& e) {
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+		sourcesRead = false;
+	}
+
+	if (!defines.empty()) {
+		vertexCode = injectDefines(vertexCode, defines);
+		fragmentCode = injectDefines(fragmentCode, defines);
+	}
+
+	// 2. Reuse the program linked by an earlier run when sources and driver are unchanged
+	binaryPath.clear();
+	if (glExt.programBinary && !binaryCacheDirectory.empty()) {
+		binaryKeyValue = binaryKey(vertexCode, fragmentCode);
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", binaryKeyValue);
+		binaryPath = binaryCacheDirectory + "/" + name;
+		if (loadBinary(binaryPath, binaryKeyValue)) {
+			fromBinaryCache = true;
+			return sourcesRead;
+		}
 	}
 
 	const char* vertexShaderCode = vertexCode.c_str();
 	const char* fragmentShaderCode = fragmentCode.c_str();
 
-	// 2. Compile shaders
-	unsigned int vertexShader, fragmentShader;
-
-	// vertex shader
-	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderCode, NULL);
-	glCompileShader(vertexShader);
-	checkCompileErrors(vertexShader, "VERTEX");
+	// 3. Compile shaders; status is only queried in finish() so the driver can work in the background
+	vertexStage = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertexStage, 1, &vertexShaderCode, NULL);
+	glCompileShader(vertexStage);
 
-	// fragment shader
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderCode, NULL);
-	glCompileShader(fragmentShader);
-	checkCompileErrors(fragmentShader, "FRAGMENT");
+	fragmentStage = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragmentStage, 1, &fragmentShaderCode, NULL);
+	glCompileShader(fragmentStage);
 
 	// shader program
 	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
+	if (!binaryPath.empty()) {
+		glExt.ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(ID, vertexStage);
+	glAttachShader(ID, fragmentStage);
 	glLinkProgram(ID);
-	checkCompileErrors(ID, "PROGRAM");
+	linkPending = true;
+	return sourcesRead;
+}
+
+bool Shader::isReady() const {
+	if (!linkPending || !glExt.parallelShaderCompile) {
+		return true;
+	}
+	int complete = 0;
+	glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != 0;
+}
+
+bool Shader::finish() {
+	if (!linkPending) {
+		return ID != 0;
+	}
+	linkPending = false;
+
+	bool vertexOk = checkCompileErrors(vertexStage, "VERTEX");
+	bool fragmentOk = checkCompileErrors(fragmentStage, "FRAGMENT");
+	bool linked = checkCompileErrors(ID, "PROGRAM");
 
 	// Delete shaders after they're linked
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glDeleteShader(vertexStage);
+	glDeleteShader(fragmentStage);
+	vertexStage = 0;
+	fragmentStage = 0;
+
+	if (linked && !binaryPath.empty()) {
+		saveBinary(binaryPath, binaryKeyValue);
+	}
+	return vertexOk && fragmentOk && linked;
+}
+
+// FNV-1a over both stages and the driver identity, so a driver update invalidates old binaries
+unsigned long long Shader::binaryKey(const std::string& vertexCode, const std::string& fragmentCode) {
+	static std::string driver;
+	if (driver.empty()) {
+		driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+	}
+	unsigned long long hash = 14695981039346656037ull;
+	const std::string* parts[] = { &vertexCode, &fragmentCode, &driver };
+	for (const std::string* part : parts) {
+		for (unsigned char c : *part) {
+			hash = (hash ^ c) * 1099511628211ull;
+		}
+		// separator so moving text between stages changes the key
+		hash = (hash ^ 0xFF) * 1099511628211ull;
+	}
+	return hash;
+}
+
+/* Create the program from a cached binary; false when missing, stale or rejected by the driver */
+bool Shader::loadBinary(const std::string& path, unsigned long long key) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	ProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC || header.key != key) {
+		return false;
+	}
+	// the header is trusted only as far as the file backs it; a damaged length must not turn into a huge allocation
+	std::error_code error;
+	std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error || header.length == 0 || header.length > (unsigned int)INT_MAX || fileSize != sizeof(header) + (std::uintmax_t)header.length) {
+		return false;
+	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), header.length)) {
+		return false;
+	}
+
+	ID = glCreateProgram();
+	glExt.ProgramBinary(ID, header.binaryFormat, binary.data(), (GLsizei)header.length);
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success) {
+		glDeleteProgram(ID);
+		ID = 0;
+		return false;
+	}
+	// mark the binary as used so pruneBinaryCache() keeps it
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return true;
+}
+
+void Shader::saveBinary(const std::string& path, unsigned long long key) {
+	int success, length = 0;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!success || length <= 0) {
+		return;
+	}
+	ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, 0, key, 0 };
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	glExt.GetProgramBinary(ID, length, &written, &header.binaryFormat, binary.data());
+	header.length = (unsigned int)written;
+
+	std::error_code error;
+	std::filesystem::create_directories(binaryCacheDirectory, error);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "WARNING::SHADER::BINARY_CACHE_NOT_WRITABLE: " << path << std::endl;
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), written);
+	file.close();
+	pruneBinaryCache();
+}
+
+void Shader::removeStaleBinary(const Shader& replacement) {
+	if (!binaryPath.empty() && binaryPath != replacement.binaryPath) {
+		std::error_code error;
+		std::filesystem::remove(binaryPath, error);
+	}
+}
+
+/* Remove the least recently used binaries beyond binaryCacheMaxFiles; edited sources leave their old keys behind */
+void Shader::pruneBinaryCache() {
+	std::error_code error;
+	std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+	for (std::filesystem::directory_iterator it(binaryCacheDirectory, error), end; !error && it != end; it.increment(error)) {
+		if (it->path().extension() == ".bin") {
+			files.push_back({ it->last_write_time(error), it->path() });
+		}
+	}
+	if ((int)files.size() <= binaryCacheMaxFiles) {
+		return;
+	}
+	std::sort(files.begin(), files.end());
+	for (size_t i = 0; i < files.size() - (size_t)binaryCacheMaxFiles; i++) {
+		std::filesystem::remove(files[i].second, error);
+	}
+}
+
+std::string Shader::injectDefines(const std::string& source, const std::string& defines) {
+	size_t version = source.find("#version");
+	if (version == std::string::npos) {
+		return defines + source;
+	}
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos) {
+		return source + "\n" + defines;
+	}
+	// #line keeps compiler messages pointing at the lines of the file
+	return source.substr(0, lineEnd + 1) + defines + "#line 2\n" + source.substr(lineEnd + 1);
 }
 
 // activate the shader
 void Shader::use() {
-	glUseProgram(ID);
+	glState.useProgram(ID);
 }
 
 // delete the shader program
 void Shader::deleteProgram() {
 	glDeleteProgram(ID);
+	glState.programDeleted(ID);
+}
+
+size_t Shader::cpuBytes() const {
+	// a hash node per entry plus what it points to
+	size_t bytes = 0;
+	for (const auto& entry : uniformLocations) {
+		bytes += sizeof(entry) + 2 * sizeof(void*) + entry.first.capacity();
+	}
+	for (const auto& entry : uniformValues) {
+		bytes += sizeof(entry) + 2 * sizeof(void*) + entry.second.capacity();
+	}
+	for (const auto& entry : blockBindings) {
+		bytes += sizeof(entry) + 2 * sizeof(void*) + entry.first.capacity();
+	}
+	return bytes;
+}
+
+size_t Shader::gpuBytes() const {
+	if (!glExt.programBinary || ID == 0) {
+		return 0;
+	}
+	int length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	return (size_t)std::max(length, 0);
+}
+
+int Shader::location(const std::string& name) const {
+	auto found = uniformLocations.find(name);
+	if (found != uniformLocations.end()) {
+		return found->second;
+	}
+	int result = glGetUniformLocation(ID, name.c_str());
+	uniformLocations.emplace(name, result);
+	return result;
+}
+
+bool Shader::uniformChanged(int location, const void* value, size_t size) const {
+	if (location < 0) {
+		return false;
+	}
+	if (glState.currentProgram() != ID) {
+		// the upload lands in whichever program is bound, so nothing is known about ours afterwards
+		uniformValues.erase(location);
+		glState.countCall(true);
+		return true;
+	}
+	std::vector<unsigned char>& last = uniformValues[location];
+	if (last.size() == size && std::memcmp(last.data(), value, size) == 0) {
+		glState.countCall(false);
+		return false;
+	}
+	last.assign((const unsigned char*)value, (const unsigned char*)value + size);
+	glState.countCall(true);
+	return true;
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	int data = (int)value;
+	int loc = location(name);
+	if (uniformChanged(loc, &data, sizeof(data))) {
+		glUniform1i(loc, data);
+	}
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	int loc = location(name);
+	if (uniformChanged(loc, &value, sizeof(value))) {
+		glUniform1i(loc, value);
+	}
+}
+
+void Shader::setIntArray(const std::string& name, const int* values, int count) const {
+	int loc = location(name);
+	if (count > 0 && uniformChanged(loc, values, count * sizeof(int))) {
+		glUniform1iv(loc, count, values);
+	}
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	int loc = location(name);
+	if (uniformChanged(loc, &value, sizeof(value))) {
+		glUniform1f(loc, value);
+	}
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const
 {
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &value[0], sizeof(float) * 2)) {
+		glUniform2fv(loc, 1, &value[0]);
+	}
 }
 
 void Shader::setVec2(const std::string& name, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	setVec2(name, glm::vec2(x, y));
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &value[0], sizeof(float) * 3)) {
+		glUniform3fv(loc, 1, &value[0]);
+	}
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	setVec3(name, glm::vec3(x, y, z));
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const
 {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &value[0], sizeof(float) * 4)) {
+		glUniform4fv(loc, 1, &value[0]);
+	}
 }
 void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	setVec4(name, glm::vec4(x, y, z, w));
 }
 
 void Shader::setMat2(const std::string& name, const glm::mat2& mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &mat[0][0], sizeof(float) * 4)) {
+		glUniformMatrix2fv(loc, 1, GL_FALSE, &mat[0][0]);
+	}
 }
 void Shader::setMat3(const std::string& name, const glm::mat3& mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &mat[0][0], sizeof(float) * 9)) {
+		glUniformMatrix3fv(loc, 1, GL_FALSE, &mat[0][0]);
+	}
 }
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	int loc = location(name);
+	if (uniformChanged(loc, &mat[0][0], sizeof(float) * 16)) {
+		glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
+	}
 }
 
+void Shader::setUniformBlock(const std::string& name, unsigned int binding) const
+{
+	// block bindings are program state, so unlike uniforms they hold whether or not the program is bound
+	auto found = blockBindings.find(name);
+	if (found != blockBindings.end() && found->second == binding) {
+		glState.countCall(false);
+		return;
+	}
+	unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+	if (index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(ID, index, binding);
+	}
+	blockBindings[name] = binding;
+	glState.countCall(true);
+}
 
-void Shader::checkCompileErrors(unsigned int shader, std::string type) {
+bool Shader::checkCompileErrors(unsigned int shader, std::string type) {
 	int success;
 	char infoLog[1024];
 	if (type != "PROGRAM") {
@@ -145,6 +447,7 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type) {
 			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
 		}
 	}
+	return success != 0;
 }
 
 
@@ -5,25 +5,46 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
 class Shader
 {
 public:
 	unsigned int ID;
+	bool fromBinaryCache;                  /* linked program was restored from binaryCacheDirectory */
 
-	// constructor generates the shader program
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// directory for linked program binaries reused across runs; empty disables the cache
+	static std::string binaryCacheDirectory;
+	static int binaryCacheMaxFiles;        /* least recently used binaries beyond this are deleted */
+
+	// empty shader, to be compiled later with submit()
+	Shader();
+
+	// constructor generates the shader program; defines are inserted right after the #version line of both stages
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+
+	// Two-phase build: submit() hands the sources to the driver without waiting, finish() collects the
+	// result. isReady() tells whether finish() would stall (always true without GL_KHR_parallel_shader_compile).
+	bool submit(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+	bool isReady() const;
+	bool finish();
 	
 	// activate the shader
 	void use();
 
 	// delete the shader program
 	void deleteProgram();
+	// delete this program's cached binary when replacement was built from other sources (hot reload), since
+	// nothing will ask for the old key again
+	void removeStaleBinary(const Shader& replacement);
 
-	// Functions to pass uniform variables to vertex shader
+	// Functions to pass uniform variables to vertex shader; a value equal to the last one uploaded is skipped
 	void setBool(const std::string& name, bool value) const;
 	void setInt(const std::string& name, int value) const;
+	void setIntArray(const std::string& name, const int* values, int count) const;
 	void setFloat(const std::string& name, float value) const;
 	void setVec2(const std::string& name, const glm::vec2& value) const;
 	void setVec2(const std::string& name, float x, float y) const;
@@ -34,11 +55,40 @@ public:
 	void setMat2(const std::string& name, const glm::mat2& mat) const;
 	void setMat3(const std::string& name, const glm::mat3& mat) const;
 	void setMat4(const std::string& name, const glm::mat4& mat) const;
+	// attach a uniform block to a buffer binding point
+	void setUniformBlock(const std::string& name, unsigned int binding) const;
+
+	// memory estimates: the uniform caches on the CPU and the linked binary the driver holds (0 where program
+	// binaries are not supported)
+	size_t cpuBytes() const;
+	size_t gpuBytes() const;
 
 
 private:
+	bool linkPending;                      /* submitted, status not collected yet */
+	unsigned int vertexStage, fragmentStage;
+	std::string binaryPath;
+	unsigned long long binaryKeyValue;
+
+	// uniform locations by name and the bytes last uploaded to each location
+	mutable std::unordered_map<std::string, int> uniformLocations;
+	mutable std::unordered_map<int, std::vector<unsigned char>> uniformValues;
+	mutable std::unordered_map<std::string, unsigned int> blockBindings;
+	int location(const std::string& name) const;
+	// true when the upload has to happen; the value is only remembered while this program is bound
+	bool uniformChanged(int location, const void* value, size_t size) const;
+
 	// utility function for checking shader and program compilation/linking errors
-	void checkCompileErrors(unsigned int shader, std::string type);
+	bool checkCompileErrors(unsigned int shader, std::string type);
+
+	// insert preprocessor lines after #version, which must stay the first directive
+	static std::string injectDefines(const std::string& source, const std::string& defines);
+
+	// program binary cache, keyed by the final sources and the driver that produced the binary
+	static unsigned long long binaryKey(const std::string& vertexCode, const std::string& fragmentCode);
+	bool loadBinary(const std::string& path, unsigned long long key);
+	void saveBinary(const std::string& path, unsigned long long key);
+	static void pruneBinaryCache();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "ShaderManager.h"
+#include "GLExtensions.h"
+
+ShaderManager::ShaderManager() {
+	hotReload = true;
+}
+
+ShaderHandle ShaderManager::add(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+	programs.emplace_back(new Program());
+	Program& program = *programs.back();
+	program.vertexPath = vertexPath;
+	program.fragmentPath = fragmentPath;
+	program.defines = defines;
+	program.hasLive = false;
+	program.hasPending = false;
+	submit(program);
+	watcher.watch(vertexPath);
+	watcher.watch(fragmentPath);
+	return (ShaderHandle)programs.size() - 1;
+}
+
+void ShaderManager::submit(Program& program) {
+	if (program.hasPending) {
+		// a newer edit supersedes the build still in flight
+		program.pending.deleteProgram();
+	}
+	program.pending = Shader();
+	program.hasPending = program.pending.submit(program.vertexPath.c_str(), program.fragmentPath.c_str(), program.defines);
+	if (!program.hasPending && program.pending.ID != 0) {
+		program.pending.deleteProgram();
+	}
+}
+
+/* Collect a finished build: a good program replaces the live one, a broken one is dropped */
+void ShaderManager::complete(Program& program) {
+	program.hasPending = false;
+	if (program.pending.finish() || !program.hasLive) {
+		if (program.hasLive) {
+			program.live.removeStaleBinary(program.pending);
+			program.live.deleteProgram();
+		}
+		program.live = program.pending;
+		program.hasLive = true;
+	}
+	else {
+		std::cout << "Shader reload failed, keeping previous program: " << program.vertexPath << ", " << program.fragmentPath << std::endl;
+		program.pending.deleteProgram();
+	}
+}
+
+Shader& ShaderManager::get(ShaderHandle handle) {
+	Program& program = *programs[handle];
+	if (!program.hasLive && program.hasPending) {
+		complete(program);
+	}
+	return program.live;
+}
+
+bool ShaderManager::isReady(ShaderHandle handle) const {
+	const Program& program = *programs[handle];
+	return program.hasLive || (program.hasPending && program.pending.isReady());
+}
+
+void ShaderManager::update() {
+	if (hotReload) {
+		for (const std::string& path : watcher.poll()) {
+			for (auto& program : programs) {
+				if (program->vertexPath == path || program->fragmentPath == path) {
+					submit(*program);
+				}
+			}
+			std::cout << "Reloading shaders using " << path << std::endl;
+		}
+	}
+	// Without background compilation collecting a build blocks, so spread them over frames
+	int budget = glExt.parallelShaderCompile ? (int)programs.size() : 1;
+	for (auto& program : programs) {
+		if (budget > 0 && program->hasPending && program->hasLive && program->pending.isReady()) {
+			complete(*program);
+			budget--;
+		}
+	}
+}
+
+int ShaderManager::pendingCount() const {
+	int count = 0;
+	for (const auto& program : programs) {
+		count += program->hasPending ? 1 : 0;
+	}
+	return count;
+}
+
+void ShaderManager::reportMemory(MemoryReport& report) const {
+	for (const auto& program : programs) {
+		if (!program->hasLive) {
+			continue;
+		}
+		// "#define NAME VALUE" lines become NAME=VALUE
+		std::string name = program->fragmentPath;
+		std::istringstream defines(program->defines);
+		std::string directive, macro, value;
+		while (defines >> directive >> macro >> value) {
+			name += " " + macro + "=" + value;
+		}
+		report.add("shader", name, program->live.cpuBytes(), program->live.gpuBytes());
+	}
+}
+
+void ShaderManager::deleteAll() {
+	for (auto& program : programs) {
+		if (program->hasLive) {
+			program->live.deleteProgram();
+		}
+		if (program->hasPending) {
+			program->pending.deleteProgram();
+		}
+	}
+	programs.clear();
+}
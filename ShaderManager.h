@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Shader.h"
+#include "FileWatcher.h"
+#include "MemoryReport.h"
+
+typedef int ShaderHandle;
+
+// Owns every program. Programs are submitted up front and compile in the background where the driver
+// supports GL_KHR_parallel_shader_compile; edited GLSL files are recompiled the same way and swapped in
+// once linked, so drawing continues with the previous program meanwhile.
+class ShaderManager {
+public:
+	bool hotReload;                        /* watch source files and rebuild programs that use them */
+
+	ShaderManager();
+	ShaderHandle add(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+	// live program; the first build is waited for if it has not finished yet
+	Shader& get(ShaderHandle handle);
+	bool isReady(ShaderHandle handle) const;
+	// call once per frame: swap in finished builds and resubmit programs whose files changed
+	void update();
+	int pendingCount() const;
+	// one entry per built program, named by its fragment shader and defines
+	void reportMemory(MemoryReport& report) const;
+	void deleteAll();
+private:
+	struct Program {
+		std::string vertexPath, fragmentPath, defines;
+		Shader live;                       /* program used for drawing */
+		Shader pending;                    /* build in flight */
+		bool hasLive;
+		bool hasPending;
+	};
+	std::vector<std::unique_ptr<Program>> programs;   /* stable addresses for the Shader& handed out */
+	FileWatcher watcher;
+	void submit(Program& program);
+	void complete(Program& program);
+};
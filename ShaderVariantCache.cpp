@@ -0,0 +1,51 @@
+#include "ShaderVariantCache.h"
+
+#include "SpotLight.h"
+
+unsigned int ShaderKey::packed() const {
+	// bits 0-7 light count, 8 shadows, 9 textured, 10-11 shading model
+	return (unsigned int)lightCount | (shadows ? 1u << 8 : 0u) | (textured ? 1u << 9 : 0u) | ((unsigned int)shadingModel << 10);
+}
+
+std::string ShaderKey::defines() const {
+	std::string result;
+	result += "#define MAX_SPOTLIGHTS " + std::to_string(MAX_SPOTLIGHTS) + "\n";
+	result += "#define LIGHT_COUNT " + std::to_string(lightCount) + "\n";
+	result += std::string("#define SHADOWS ") + (shadows ? "1" : "0") + "\n";
+	result += std::string("#define TEXTURED ") + (textured ? "1" : "0") + "\n";
+	result += "#define SHADING_MODEL " + std::to_string((int)shadingModel) + "\n";
+	return result;
+}
+
+ShaderVariantCache::ShaderVariantCache(ShaderManager& manager, const char* vertexPath, const char* fragmentPath)
+	: manager(manager), vertexPath(vertexPath), fragmentPath(fragmentPath), frame(1) {
+}
+
+ShaderVariantCache::Variant& ShaderVariantCache::find(const ShaderKey& key) {
+	unsigned int id = key.packed();
+	auto found = variants.find(id);
+	if (found == variants.end()) {
+		Variant variant = { manager.add(vertexPath, fragmentPath, key.defines()), 0 };
+		found = variants.emplace(id, variant).first;
+	}
+	return found->second;
+}
+
+void ShaderVariantCache::prepare(const ShaderKey& key) {
+	find(key);
+}
+
+Shader& ShaderVariantCache::get(const ShaderKey& key, bool& firstUseThisFrame) {
+	Variant& variant = find(key);
+	firstUseThisFrame = variant.lastFrame != frame;
+	variant.lastFrame = frame;
+	return manager.get(variant.handle);
+}
+
+void ShaderVariantCache::beginFrame() {
+	frame++;
+}
+
+size_t ShaderVariantCache::size() const {
+	return variants.size();
+}
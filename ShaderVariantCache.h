@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "Shader.h"
+#include "ShaderManager.h"
+
+enum class ShadingModel {
+	Lambert,              /* diffuse only, the original look */
+	BlinnPhong            /* diffuse plus Blinn-Phong highlights */
+};
+
+// Compile-time features of the lighting shader; every distinct key is its own program
+struct ShaderKey {
+	int lightCount;                        /* lights the draw loops over (0 to MAX_SPOTLIGHTS) */
+	bool shadows;
+	bool textured;
+	ShadingModel shadingModel;
+
+	unsigned int packed() const;           /* unique integer per key, used for cache lookups */
+	std::string defines() const;           /* preprocessor lines selecting this variant */
+};
+
+// Lighting program variants, built through the ShaderManager the first time a key is requested
+class ShaderVariantCache {
+public:
+	ShaderVariantCache(ShaderManager& manager, const char* vertexPath, const char* fragmentPath);
+
+	// start building a variant ahead of use so it compiles alongside the others
+	void prepare(const ShaderKey& key);
+	// program for the key; firstUseThisFrame is set when per-frame uniforms still have to be uploaded to it
+	Shader& get(const ShaderKey& key, bool& firstUseThisFrame);
+	void beginFrame();
+	size_t size() const;
+private:
+	struct Variant {
+		ShaderHandle handle;
+		unsigned int lastFrame;
+	};
+	ShaderManager& manager;
+	std::string vertexPath, fragmentPath;
+	std::unordered_map<unsigned int, Variant> variants;
+	unsigned int frame;
+	Variant& find(const ShaderKey& key);
+};
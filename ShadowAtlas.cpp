@@ -0,0 +1,350 @@
+#include "ShadowAtlas.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+/* Spread the even bits of a Morton code into an integer coordinate */
+static unsigned int compactBits(unsigned int v) {
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0F0F0F0F;
+	v = (v | (v >> 4)) & 0x00FF00FF;
+	v = (v | (v >> 8)) & 0x0000FFFF;
+	return v;
+}
+
+/* Angle in radians between two unit vectors */
+static float angleBetween(const glm::vec3& a, const glm::vec3& b) {
+	return glm::acos(glm::clamp(glm::dot(a, b), -1.0f, 1.0f));
+}
+
+ShadowAtlas::ShadowAtlas(int atlasSize) : atlasSize(atlasSize) {
+	minResolution = 128;
+	maxResolution = 1024;
+	maxUpdatesPerFrame = 4;
+	budgetMs = 2.0f;
+	fovMargin = glm::radians(10.0f);
+	maxHalfFov = glm::radians(75.0f);
+	shadowNear = 1.0f;
+	shadowFar = 500.0f;
+	enabled = true;
+	renderedCount = 0;
+	reusedCount = 0;
+	hasDynamic = false;
+	dynamicFBO = 0;
+	dynamicDepth = 0;
+	allowedUpdates = maxUpdatesPerFrame;
+	createDepthTarget(staticFBO, staticDepth);
+}
+
+/* Create a depth-only framebuffer whose texture can be sampled with hardware depth comparison */
+void ShadowAtlas::createDepthTarget(unsigned int& fbo, unsigned int& texture) {
+	glGenTextures(1, &texture);
+	glState.bindTexture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::SHADOW_ATLAS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Shadow frusta end where the light stops mattering */
+float ShadowAtlas::farPlaneFor(const SpotLight& light) const {
+	if (light.range > shadowNear) {
+		return glm::min(light.range, shadowFar);
+	}
+	return shadowFar;
+}
+
+/* Fraction of the screen covered by the bounding sphere of the light's cone, used to pick its resolution */
+float ShadowAtlas::computeImportance(const SpotLight& light, const glm::mat4& view, const glm::mat4& projection) const {
+	float cosHalf = glm::clamp(light.cutoffAngle, 0.01f, 1.0f);
+	float length = farPlaneFor(light);
+	glm::vec3 dir = glm::normalize(light.direction);
+	glm::vec3 center;
+	float radius;
+	if (cosHalf > 0.7071f) {
+		// narrow cone: the sphere passes through the apex and the cap rim
+		radius = length / (2.0f * cosHalf * cosHalf);
+		center = light.position + dir * radius;
+	}
+	else {
+		// wide cone: the sphere is centered on the cap
+		radius = length * std::sqrt(1.0f - cosHalf * cosHalf) / cosHalf;
+		center = light.position + dir * length;
+	}
+
+	glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+	float depth = -viewCenter.z;
+	if (depth + radius <= 0.0f) {
+		return 0.0f;
+	}
+	if (depth <= radius) {
+		return 1.0f;
+	}
+	return glm::clamp(radius * projection[1][1] / depth, 0.0f, 1.0f);
+}
+
+/* Grow the cone that bounds every direction seen since the light last moved */
+void ShadowAtlas::updateSweep(ShadowSlot& slot, const SpotLight& light) {
+	glm::vec3 dir = glm::normalize(light.direction);
+	if (slot.sweepAngle < 0.0f || glm::length(light.position - slot.position) > 1e-4f) {
+		slot.sweepAxis = dir;
+		slot.sweepAngle = 0.0f;
+		slot.position = light.position;
+		slot.valid = false;
+		return;
+	}
+
+	float theta = angleBetween(slot.sweepAxis, dir);
+	if (theta <= slot.sweepAngle) {
+		return;
+	}
+	// smallest cone containing the old cone and the new direction
+	float newAngle = 0.5f * (slot.sweepAngle + theta);
+	float t = (newAngle - slot.sweepAngle) / theta;
+	glm::vec3 axis = glm::normalize(slot.sweepAxis * glm::sin((1.0f - t) * theta) + dir * glm::sin(t * theta));
+	slot.sweepAxis = axis;
+	slot.sweepAngle = newAngle;
+}
+
+/* Whether the map in the slot still contains the whole cone of the light */
+bool ShadowAtlas::covers(const ShadowSlot& slot, const SpotLight& light) const {
+	if (!slot.valid || slot.size == 0) {
+		return false;
+	}
+	if (slot.farPlane != farPlaneFor(light)) {
+		return false;
+	}
+	float coneHalf = glm::acos(glm::clamp(light.cutoffAngle, -1.0f, 1.0f));
+	return angleBetween(slot.axis, glm::normalize(light.direction)) + coneHalf <= slot.halfFov;
+}
+
+/* Pack power-of-two tiles, largest first, along a Morton curve so every tile stays aligned */
+void ShadowAtlas::layoutSlots() {
+	std::vector<int> order(slots.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = (int)i;
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		return slots[a].level > slots[b].level;
+	});
+
+	unsigned int cells = (unsigned int)(atlasSize / minResolution);
+	unsigned int totalCells = cells * cells;
+	unsigned int cursor = 0;
+	for (int index : order) {
+		ShadowSlot& slot = slots[index];
+		int size = 1 << (int)slot.level;
+		int x = 0, y = 0;
+		while (size >= minResolution) {
+			unsigned int span = (unsigned int)(size / minResolution);
+			if (cursor + span * span <= totalCells) {
+				x = (int)compactBits(cursor) * minResolution;
+				y = (int)compactBits(cursor >> 1) * minResolution;
+				cursor += span * span;
+				break;
+			}
+			size /= 2;
+		}
+		if (size < minResolution) {
+			size = 0;
+		}
+		if (slot.x != x || slot.y != y || slot.size != size) {
+			slot.x = x;
+			slot.y = y;
+			slot.size = size;
+			slot.valid = false;
+		}
+	}
+}
+
+void ShadowAtlas::renderCasters(const ShadowSlot& slot, Shader& depthShader, const std::vector<ShadowCaster>& casters, bool clear) {
+	glViewport(slot.x, slot.y, slot.size, slot.size);
+	if (clear) {
+		glScissor(slot.x, slot.y, slot.size, slot.size);
+		glEnable(GL_SCISSOR_TEST);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+	depthShader.setMat4("lightMatrix", slot.lightMatrix);
+	for (const ShadowCaster& caster : casters) {
+		depthShader.setMat4("model", caster.model);
+		caster.mesh->render();
+	}
+}
+
+/* Re-render the static casters of one light with a frustum wide enough to survive its current sweep */
+void ShadowAtlas::renderSlot(ShadowSlot& slot, const SpotLight& light, Shader& depthShader, const std::vector<ShadowCaster>& casters) {
+	float coneHalf = glm::acos(glm::clamp(light.cutoffAngle, -1.0f, 1.0f));
+	if (slot.sweepAngle + coneHalf + fovMargin <= maxHalfFov) {
+		slot.axis = slot.sweepAxis;
+		slot.halfFov = slot.sweepAngle + coneHalf + fovMargin;
+	}
+	else {
+		// the light sweeps too wide for one map: follow the current direction instead
+		slot.axis = glm::normalize(light.direction);
+		slot.halfFov = glm::min(coneHalf + fovMargin, maxHalfFov);
+	}
+
+	glm::vec3 up = glm::abs(slot.axis.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(light.position, light.position + slot.axis, up);
+	slot.farPlane = farPlaneFor(light);
+	glm::mat4 lightProjection = glm::perspective(2.0f * slot.halfFov, 1.0f, shadowNear, slot.farPlane);
+	slot.lightMatrix = lightProjection * lightView;
+	slot.position = light.position;
+
+	renderCasters(slot, depthShader, casters, true);
+	slot.valid = true;
+}
+
+/* Refresh the atlas for this frame's lights; only tiles whose cached frustum no longer covers the cone are redrawn */
+void ShadowAtlas::update(const std::vector<SpotLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+	Shader& depthShader, const std::vector<ShadowCaster>& staticCasters, const std::vector<ShadowCaster>& dynamicCasters) {
+	renderedCount = 0;
+	reusedCount = 0;
+	if (!enabled) {
+		return;
+	}
+
+	// Adapt the number of tiles we may redraw from the time the pass took a few frames ago
+	if (timer.lastMs > budgetMs && allowedUpdates > 1) {
+		allowedUpdates--;
+	}
+	else if (timer.lastMs < 0.75f * budgetMs && allowedUpdates < maxUpdatesPerFrame) {
+		allowedUpdates++;
+	}
+	timer.begin();
+
+	if (slots.size() != lights.size()) {
+		ShadowSlot empty = {};
+		empty.sweepAngle = -1.0f;
+		empty.level = -1.0f;
+		slots.resize(lights.size(), empty);
+	}
+
+	// Pick a resolution level per light, only switching when importance moves well past the current level
+	float minLevel = std::log2((float)minResolution);
+	float maxLevel = std::log2((float)maxResolution);
+	for (size_t i = 0; i < lights.size(); i++) {
+		ShadowSlot& slot = slots[i];
+		slot.importance = computeImportance(lights[i], view, projection);
+		float desired = glm::clamp(std::log2(glm::max(slot.importance * maxResolution, 1.0f)), minLevel, maxLevel);
+		if (slot.level < 0.0f || std::fabs(desired - slot.level) > 0.75f) {
+			slot.level = glm::clamp(std::round(desired), minLevel, maxLevel);
+		}
+		updateSweep(slot, lights[i]);
+	}
+	layoutSlots();
+
+	// Redraw stale tiles, maps that never existed first, then by importance
+	std::vector<int> stale;
+	for (size_t i = 0; i < lights.size(); i++) {
+		if (slots[i].size == 0) {
+			continue;
+		}
+		if (covers(slots[i], lights[i])) {
+			reusedCount++;
+		}
+		else {
+			stale.push_back((int)i);
+		}
+	}
+	std::sort(stale.begin(), stale.end(), [this](int a, int b) {
+		if (slots[a].valid != slots[b].valid) {
+			return !slots[a].valid;
+		}
+		return slots[a].importance > slots[b].importance;
+	});
+
+	GLint previousFBO, previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFBO);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	depthShader.use();
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, staticFBO);
+	for (int index : stale) {
+		if (renderedCount >= allowedUpdates) {
+			break;
+		}
+		renderSlot(slots[index], lights[index], depthShader, staticCasters);
+		renderedCount++;
+	}
+
+	// Moving casters are drawn every frame on top of a copy of the cached static depth
+	hasDynamic = !dynamicCasters.empty();
+	if (hasDynamic) {
+		if (dynamicFBO == 0) {
+			createDepthTarget(dynamicFBO, dynamicDepth);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dynamicFBO);
+		for (const ShadowSlot& slot : slots) {
+			if (!slot.valid || slot.size == 0) {
+				continue;
+			}
+			glBlitFramebuffer(slot.x, slot.y, slot.x + slot.size, slot.y + slot.size,
+				slot.x, slot.y, slot.x + slot.size, slot.y + slot.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, dynamicFBO);
+		for (const ShadowSlot& slot : slots) {
+			if (slot.valid && slot.size > 0) {
+				renderCasters(slot, depthShader, dynamicCasters, false);
+			}
+		}
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	timer.end();
+}
+
+/* Pass the atlas and per-light tile data to the lighting shader (which must be in use) */
+void ShadowAtlas::bind(Shader& shader, int textureUnit) {
+	glState.bindTexture(textureUnit, hasDynamic ? dynamicDepth : staticDepth);
+
+	shader.setInt("shadowAtlas", textureUnit);
+	shader.setBool("shadowsEnabled", enabled);
+	shader.setVec2("shadowTexelSize", glm::vec2(1.0f / atlasSize));
+	float scale = 1.0f / atlasSize;
+	for (size_t i = 0; i < slots.size(); i++) {
+		const ShadowSlot& slot = slots[i];
+		std::string index = "[" + std::to_string(i) + "]";
+		glm::vec4 rect(0.0f);
+		if (slot.valid && slot.size > 0) {
+			rect = glm::vec4(slot.x * scale, slot.y * scale, slot.size * scale, slot.size * scale);
+		}
+		shader.setVec4("shadowRects" + index, rect);
+		shader.setMat4("lightMatrices" + index, slot.lightMatrix);
+	}
+}
+
+void ShadowAtlas::deleteBuffers() {
+	glDeleteFramebuffers(1, &staticFBO);
+	glDeleteTextures(1, &staticDepth);
+	glState.textureDeleted(staticDepth);
+	if (dynamicFBO != 0) {
+		glDeleteFramebuffers(1, &dynamicFBO);
+		glDeleteTextures(1, &dynamicDepth);
+		glState.textureDeleted(dynamicDepth);
+	}
+	timer.deleteQueries();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glad/glad.h>
+
+#include "SpotLight.h"
+#include "Shader.h"
+#include "Mesh.h"
+#include "GpuTimer.h"
+
+// A mesh drawn into the shadow maps with its world matrix
+struct ShadowCaster {
+	Mesh* mesh;
+	glm::mat4 model;
+};
+
+struct ShadowSlot {
+	int x, y, size;            /* atlas region in texels, size 0 when the light got no space */
+	float level;               /* resolution level (log2 of size) kept with hysteresis */
+	float importance;          /* approximate fraction of the screen the light can touch */
+	glm::mat4 lightMatrix;     /* projection * view of the frustum the map was rendered with */
+	glm::vec3 position;        /* light position the map was rendered from */
+	glm::vec3 axis;            /* axis of the rendered frustum */
+	float halfFov;             /* half field of view of the rendered frustum (radians) */
+	float farPlane;            /* far plane of the rendered frustum */
+	glm::vec3 sweepAxis;       /* bounding cone of every direction the light pointed at from this position */
+	float sweepAngle;          /* half angle of the sweep cone, negative when empty */
+	bool valid;                /* the tile holds static casters rendered with lightMatrix */
+};
+
+class ShadowAtlas {
+public:
+	int atlasSize;             /* width and height of the depth atlas in texels */
+	int minResolution;         /* smallest per-light tile */
+	int maxResolution;         /* largest per-light tile */
+	int maxUpdatesPerFrame;    /* upper bound on tiles re-rendered per frame */
+	float budgetMs;            /* GPU time the shadow pass aims to stay under */
+	float fovMargin;           /* extra half angle (radians) rendered around a cone so small moves reuse the map */
+	float maxHalfFov;          /* widest frustum a cached map may use before resolution gets too poor */
+	float shadowNear;
+	float shadowFar;           /* far plane limit; lights with a shorter range use their range */
+	bool enabled;
+
+	/* statistics for the last update */
+	int renderedCount;         /* tiles re-rendered with static casters */
+	int reusedCount;           /* tiles served from the cache */
+	GpuTimer timer;            /* GPU time of the whole shadow pass */
+
+	ShadowAtlas(int atlasSize);
+	void update(const std::vector<SpotLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+		Shader& depthShader, const std::vector<ShadowCaster>& staticCasters, const std::vector<ShadowCaster>& dynamicCasters);
+	void bind(Shader& shader, int textureUnit);
+	void deleteBuffers();
+private:
+	std::vector<ShadowSlot> slots;
+	unsigned int staticFBO, staticDepth;   /* cached static casters */
+	unsigned int dynamicFBO, dynamicDepth; /* static copy + dynamic casters, created on first use */
+	bool hasDynamic;
+	int allowedUpdates;                    /* adapted each frame to keep the pass within budgetMs */
+	void createDepthTarget(unsigned int& fbo, unsigned int& texture);
+	float computeImportance(const SpotLight& light, const glm::mat4& view, const glm::mat4& projection) const;
+	void updateSweep(ShadowSlot& slot, const SpotLight& light);
+	float farPlaneFor(const SpotLight& light) const;
+	bool covers(const ShadowSlot& slot, const SpotLight& light) const;
+	void layoutSlots();
+	void renderSlot(ShadowSlot& slot, const SpotLight& light, Shader& depthShader, const std::vector<ShadowCaster>& casters);
+	void renderCasters(const ShadowSlot& slot, Shader& depthShader, const std::vector<ShadowCaster>& casters, bool clear);
+};
@@ -0,0 +1,131 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Lights turn at a fixed rate in radians per second when no light show is loaded
+static const double LIGHT_ROTATION_SPEED = 3.0;
+
+// Falling further behind than this (a debugger break, a suspended laptop) skips time instead of catching up
+static const double MAX_CATCH_UP_SECONDS = 0.25;
+
+Simulation::Simulation(const std::vector<SpotLight>& lights, LightShow* show, float rangeThreshold, double timestep)
+	: restLights(lights), current(lights), show(show), rangeThreshold(rangeThreshold) {
+	this->timestep = timestep;
+	paused = false;
+	totalStepMs = 0.0;
+	steps = 0;
+	animationTime = 0.0;
+	stepTime = 0.0;
+	skippedNanoseconds = 0;
+	running = false;
+
+	// Publish the rest state so interpolate() has something to show before the first step lands
+	if (show) {
+		show->evaluate(0.0);
+		show->apply(current, rangeThreshold);
+	}
+	SimulationSnapshot& first = snapshots.writeBuffer();
+	first.time = 0.0;
+	first.previousLights = current;
+	first.lights = current;
+	first.stepMs = 0.0;
+	snapshots.publish();
+	snapshots.consume();
+}
+
+Simulation::~Simulation() {
+	stop();
+}
+
+void Simulation::start() {
+	if (running) {
+		return;
+	}
+	startTime = Clock::now();
+	skippedNanoseconds = 0;
+	stepTime = 0.0;
+	running = true;
+	thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void Simulation::run() {
+	Clock::duration tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timestep));
+	Clock::time_point nextTick = startTime + tick;
+	while (running) {
+		std::this_thread::sleep_until(nextTick);
+		Clock::time_point now = Clock::now();
+		if (now - nextTick > std::chrono::duration<double>(MAX_CATCH_UP_SECONDS)) {
+			// shift the clock so the renderer's notion of simulation time moves with us; startTime is read by the
+			// render thread, so the shift goes through an atomic instead
+			Clock::duration skipped = now - nextTick;
+			skippedNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(skipped).count();
+			nextTick += skipped;
+		}
+		// run every step that is due; each one publishes, the renderer only sees the newest
+		while (nextTick <= now && running) {
+			stepTime += timestep;
+			step();
+			nextTick += tick;
+		}
+	}
+}
+
+/* Advance the animation by one timestep and publish the result */
+void Simulation::step() {
+	Clock::time_point begin = Clock::now();
+	SimulationSnapshot& snapshot = snapshots.writeBuffer();
+	snapshot.previousLights = current;
+
+	if (!paused) {
+		animationTime += timestep;
+	}
+	if (show) {
+		show->evaluate(animationTime);
+		show->apply(current, rangeThreshold);
+	}
+	else {
+		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), (float)(LIGHT_ROTATION_SPEED * animationTime), glm::vec3(0.0f, 1.0f, 0.0f));
+		for (size_t i = 0; i < current.size(); i++) {
+			current[i].direction = glm::vec3(rotation * glm::vec4(restLights[i].direction, 1.0f));
+		}
+	}
+
+	snapshot.time = stepTime;
+	snapshot.lights = current;
+	snapshot.stepMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+	totalStepMs += snapshot.stepMs;
+	steps++;
+	snapshots.publish();
+}
+
+/* Blend the two newest steps at one timestep behind the wall clock, so a step is always available */
+void Simulation::interpolate(std::vector<SpotLight>& out) {
+	snapshots.consume();
+	const SimulationSnapshot& snapshot = snapshots.readBuffer();
+	Clock::duration elapsed = Clock::now() - startTime - std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(skippedNanoseconds.load()));
+	double renderTime = std::chrono::duration<double>(elapsed).count() - timestep;
+	float alpha = running ? (float)std::min(1.0, std::max(0.0, (renderTime - (snapshot.time - timestep)) / timestep)) : 1.0f;
+
+	out.resize(snapshot.lights.size());
+	for (size_t i = 0; i < out.size(); i++) {
+		const SpotLight& a = snapshot.previousLights[i];
+		const SpotLight& b = snapshot.lights[i];
+		out[i] = b;
+		out[i].ambient = glm::mix(a.ambient, b.ambient, alpha);
+		out[i].diffuse = glm::mix(a.diffuse, b.diffuse, alpha);
+		out[i].position = glm::mix(a.position, b.position, alpha);
+		// directions are only compared by angle, so a plain lerp of consecutive steps is enough
+		out[i].direction = glm::mix(a.direction, b.direction, alpha);
+		out[i].cutoffAngle = glm::mix(a.cutoffAngle, b.cutoffAngle, alpha);
+		// the larger range keeps culling conservative while a light fades
+		out[i].range = std::max(a.range, b.range);
+	}
+}
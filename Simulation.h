@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "SpotLight.h"
+#include "LightShow.h"
+#include "TripleBuffer.h"
+
+// Immutable result of one simulation step; carries the step before it so the renderer can
+// interpolate without keeping history of its own
+struct SimulationSnapshot {
+	double time;                           /* simulation time of lights, in seconds */
+	std::vector<SpotLight> previousLights; /* state one timestep earlier */
+	std::vector<SpotLight> lights;
+	double stepMs;                         /* CPU time the step took */
+};
+
+// Runs light animation on its own thread at a fixed timestep, independent of the frame rate, and
+// publishes a snapshot per step through a triple buffer. The render thread draws the state one
+// timestep in the past, interpolated between the two newest steps, so motion stays smooth and exact
+// however the two threads drift against each other.
+class Simulation {
+public:
+	double timestep;                       /* seconds per step */
+	std::atomic<bool> paused;              /* freezes animation time; set from the input handling */
+	double totalStepMs;                    /* statistics, read after stop() */
+	long long steps;
+
+	// lights are the rest state; show (may be null) replaces the default rotation
+	Simulation(const std::vector<SpotLight>& lights, LightShow* show, float rangeThreshold, double timestep);
+	~Simulation();
+	void start();
+	void stop();
+	// lights as they were one timestep ago, interpolated to the current time
+	void interpolate(std::vector<SpotLight>& out);
+private:
+	typedef std::chrono::steady_clock Clock;
+	std::vector<SpotLight> restLights;
+	std::vector<SpotLight> current;
+	LightShow* show;
+	float rangeThreshold;
+	double animationTime;
+	double stepTime;
+	Clock::time_point startTime;           /* set by start() before the thread runs, read-only afterwards */
+	std::atomic<long long> skippedNanoseconds;  /* wall time dropped by the simulation thread after a stall */
+	TripleBuffer<SimulationSnapshot> snapshots;
+	std::thread thread;
+	std::atomic<bool> running;
+	void run();
+	void step();
+};
@@ -0,0 +1,510 @@
+#include "SoftwareRenderer.h"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// The AVX2 paths are compiled for AVX2 regardless of the build flags and only run when the CPU has it
+#if defined(__GNUC__) || defined(__clang__)
+#define SOFTWARE_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SOFTWARE_AVX2
+#endif
+
+// Triangles one setup job transforms, clips and culls
+static const int TRIANGLES_PER_CHUNK = 1024;
+static const int BLOCKS_PER_ROW = SOFTWARE_TILE_SIZE / SOFTWARE_BLOCK_SIZE;
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return fma && osSavesYmm && (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return false;
+#endif
+}
+
+SoftwareRenderer::SoftwareRenderer(ThreadPool& pool, int width, int height)
+	: width(width), height(height), pool(pool) {
+	pixels.resize((size_t)width * height * 3);
+	clearColor = glm::vec3(0.3f, 0.4f, 0.5f);
+	baseColor = glm::vec3(0.8f);
+	shadingModel = ShadingModel::Lambert;
+	shininess = 32.0f;
+	specularStrength = 0.5f;
+	useAvx2 = cpuHasAvx2();
+	setupMs = binMs = tileMs = 0.0;
+	triangleCount = 0;
+	tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	bins.resize(tilesX * tilesY);
+}
+
+/* Screen-space setup of a triangle whose corners are all in front of the near plane; back faces are dropped
+   like GL_CULL_FACE does with counter-clockwise front faces */
+void SoftwareRenderer::emitTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int draw,
+	std::vector<Triangle>& out) const {
+	const ClipVertex* corners[3] = { &a, &b, &c };
+	float sx[3], sy[3], sz[3];
+	Triangle t;
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4& clip = corners[i]->clip;
+		t.invW[i] = 1.0f / clip.w;
+		sx[i] = (clip.x * t.invW[i] * 0.5f + 0.5f) * width;
+		sy[i] = (clip.y * t.invW[i] * 0.5f + 0.5f) * height;
+		sz[i] = clip.z * t.invW[i];
+	}
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (!(area > 0.0f)) {
+		return;
+	}
+
+	t.minX = std::max(0, (int)std::floor(std::min(sx[0], std::min(sx[1], sx[2]))));
+	t.maxX = std::min(width - 1, (int)std::floor(std::max(sx[0], std::max(sx[1], sx[2]))));
+	t.minY = std::max(0, (int)std::floor(std::min(sy[0], std::min(sy[1], sy[2]))));
+	t.maxY = std::min(height - 1, (int)std::floor(std::max(sy[0], std::max(sy[1], sy[2]))));
+	if (t.minX > t.maxX || t.minY > t.maxY) {
+		return;
+	}
+
+	// edge i is the one opposite corner i, so it reaches 1 at that corner and 0 along the edge. The constant terms
+	// are taken at the corner of the bounds in double precision: near-plane clipping can put corners far off
+	// screen, and the cancellation against them would cost the texture coordinates most of their precision.
+	double inverseArea = 1.0 / ((double)(sx[1] - sx[0]) * (sy[2] - sy[0]) - (double)(sy[1] - sy[0]) * (sx[2] - sx[0]));
+	t.referenceX = (float)t.minX;
+	t.referenceY = (float)t.minY;
+	double depthAtReference = 0.0;
+	t.depthA = t.depthB = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		double a = ((double)sy[j] - sy[k]) * inverseArea;
+		double b = ((double)sx[k] - sx[j]) * inverseArea;
+		double atReference = a * (t.referenceX - (double)sx[j]) + b * (t.referenceY - (double)sy[j]);
+		t.edgeA[i] = (float)a;
+		t.edgeB[i] = (float)b;
+		t.edgeC[i] = (float)atReference;
+		t.depthA += sz[i] * t.edgeA[i];
+		t.depthB += sz[i] * t.edgeB[i];
+		depthAtReference += sz[i] * atReference;
+		t.world[i] = corners[i]->world;
+		t.normal[i] = corners[i]->normal;
+		t.uv[i] = corners[i]->uv;
+	}
+	t.depthC = (float)depthAtReference;
+	t.minDepth = std::min(sz[0], std::min(sz[1], sz[2]));
+	t.draw = draw;
+	out.push_back(t);
+}
+
+/* Reject triangles outside the frustum and clip the ones crossing the near plane (z = -w) */
+void SoftwareRenderer::setupTriangle(const ClipVertex* corners, int draw, std::vector<Triangle>& out) const {
+	int outside[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4& p = corners[i].clip;
+		outside[0] += p.x < -p.w;
+		outside[1] += p.x > p.w;
+		outside[2] += p.y < -p.w;
+		outside[3] += p.y > p.w;
+		outside[4] += p.z < -p.w;
+		outside[5] += p.z > p.w;
+	}
+	for (int plane = 0; plane < 6; plane++) {
+		if (outside[plane] == 3) {
+			return;
+		}
+	}
+	if (outside[4] == 0) {
+		emitTriangle(corners[0], corners[1], corners[2], draw, out);
+		return;
+	}
+
+	// attributes are interpolated in clip space, where they are still linear
+	ClipVertex polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		const ClipVertex& current = corners[i];
+		const ClipVertex& next = corners[(i + 1) % 3];
+		float currentDistance = current.clip.z + current.clip.w;
+		float nextDistance = next.clip.z + next.clip.w;
+		if (currentDistance >= 0.0f) {
+			polygon[count++] = current;
+		}
+		if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+			float s = currentDistance / (currentDistance - nextDistance);
+			ClipVertex& v = polygon[count++];
+			v.clip = glm::mix(current.clip, next.clip, s);
+			v.world = glm::mix(current.world, next.world, s);
+			v.normal = glm::mix(current.normal, next.normal, s);
+			v.uv = glm::mix(current.uv, next.uv, s);
+		}
+	}
+	for (int i = 2; i < count; i++) {
+		emitTriangle(polygon[0], polygon[i - 1], polygon[i], draw, out);
+	}
+}
+
+/* Depth test one 8x8 block of a tile 8 pixels at a time, returning the farthest depth left in the block.
+   px and py are the position of the block's first pixel center relative to the triangle's reference point. */
+SOFTWARE_AVX2 static float rasterBlockAvx2(const float* edgeA, const float* edgeB, const float* edgeC, float depthA,
+	float depthB, float depthC, int id, float px, float py, float* depth, int* ids) {
+	__m256 xs = _mm256_add_ps(_mm256_set1_ps(px), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+	__m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(edgeA[0]), xs, _mm256_set1_ps(edgeB[0] * py + edgeC[0]));
+	__m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(edgeA[1]), xs, _mm256_set1_ps(edgeB[1] * py + edgeC[1]));
+	__m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(edgeA[2]), xs, _mm256_set1_ps(edgeB[2] * py + edgeC[2]));
+	__m256 z = _mm256_fmadd_ps(_mm256_set1_ps(depthA), xs, _mm256_set1_ps(depthB * py + depthC));
+	__m256 step0 = _mm256_set1_ps(edgeB[0]);
+	__m256 step1 = _mm256_set1_ps(edgeB[1]);
+	__m256 step2 = _mm256_set1_ps(edgeB[2]);
+	__m256 stepZ = _mm256_set1_ps(depthB);
+	__m256i idVector = _mm256_set1_epi32(id);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 farthest = zero;
+	for (int row = 0; row < SOFTWARE_BLOCK_SIZE; row++) {
+		float* depthRow = depth + row * SOFTWARE_TILE_SIZE;
+		int* idRow = ids + row * SOFTWARE_TILE_SIZE;
+		__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+			_mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+		__m256 stored = _mm256_load_ps(depthRow);
+		__m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+		stored = _mm256_blendv_ps(stored, z, pass);
+		_mm256_store_ps(depthRow, stored);
+		__m256i storedIds = _mm256_load_si256((const __m256i*)idRow);
+		_mm256_store_si256((__m256i*)idRow, _mm256_blendv_epi8(storedIds, idVector, _mm256_castps_si256(pass)));
+		farthest = row == 0 ? stored : _mm256_max_ps(farthest, stored);
+		e0 = _mm256_add_ps(e0, step0);
+		e1 = _mm256_add_ps(e1, step1);
+		e2 = _mm256_add_ps(e2, step2);
+		z = _mm256_add_ps(z, stepZ);
+	}
+	__m128 half = _mm_max_ps(_mm256_castps256_ps128(farthest), _mm256_extractf128_ps(farthest, 1));
+	half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+	return _mm_cvtss_f32(half);
+}
+
+static float rasterBlockScalar(const float* edgeA, const float* edgeB, const float* edgeC, float depthA, float depthB,
+	float depthC, int id, float px, float py, float* depth, int* ids) {
+	float farthest = -INFINITY;
+	for (int row = 0; row < SOFTWARE_BLOCK_SIZE; row++) {
+		float y = py + row;
+		for (int column = 0; column < SOFTWARE_BLOCK_SIZE; column++) {
+			float x = px + column;
+			int i = row * SOFTWARE_TILE_SIZE + column;
+			float z = depthA * x + depthB * y + depthC;
+			if (edgeA[0] * x + edgeB[0] * y + edgeC[0] >= 0.0f && edgeA[1] * x + edgeB[1] * y + edgeC[1] >= 0.0f
+				&& edgeA[2] * x + edgeB[2] * y + edgeC[2] >= 0.0f && z < depth[i]) {
+				depth[i] = z;
+				ids[i] = id;
+			}
+			farthest = std::max(farthest, depth[i]);
+		}
+	}
+	return farthest;
+}
+
+// Eight fragments in structure-of-arrays form, so the light loop runs on all of them at once
+static const int SHADE_LANES = 8;
+struct alignas(32) FragmentBatch {
+	float posX[SHADE_LANES], posY[SHADE_LANES], posZ[SHADE_LANES];
+	float normalX[SHADE_LANES], normalY[SHADE_LANES], normalZ[SHADE_LANES];
+	float viewX[SHADE_LANES], viewY[SHADE_LANES], viewZ[SHADE_LANES];
+	float colorR[SHADE_LANES], colorG[SHADE_LANES], colorB[SHADE_LANES];   /* object color in, lit color out */
+
+	void set(int lane, const glm::vec3& position, const glm::vec3& normal, const glm::vec3& view, const glm::vec3& color) {
+		posX[lane] = position.x; posY[lane] = position.y; posZ[lane] = position.z;
+		normalX[lane] = normal.x; normalY[lane] = normal.y; normalZ[lane] = normal.z;
+		viewX[lane] = view.x; viewY[lane] = view.y; viewZ[lane] = view.z;
+		colorR[lane] = color.x; colorG[lane] = color.y; colorB[lane] = color.z;
+	}
+	// uncovered lanes still go through the light loop, so they must hold finite values
+	void clear(int lane) {
+		set(lane, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+	}
+};
+
+/* The light loop of fragment_shader.glsl (without shadows) for every lane of the batch */
+static void shadeBatchScalar(FragmentBatch& batch, const SpotLight* lights, const glm::vec3* coneDirections, int lightCount,
+	const glm::vec3& ambientLight, bool blinnPhong, float shininess, float specularStrength) {
+	for (int lane = 0; lane < SHADE_LANES; lane++) {
+		glm::vec3 fragPos(batch.posX[lane], batch.posY[lane], batch.posZ[lane]);
+		glm::vec3 norm(batch.normalX[lane], batch.normalY[lane], batch.normalZ[lane]);
+		glm::vec3 viewDir(batch.viewX[lane], batch.viewY[lane], batch.viewZ[lane]);
+		glm::vec3 objectColor(batch.colorR[lane], batch.colorG[lane], batch.colorB[lane]);
+		glm::vec3 result = ambientLight * objectColor;
+		for (int i = 0; i < lightCount; i++) {
+			const SpotLight& light = lights[i];
+			glm::vec3 toLight = light.position - fragPos;
+			float dist = glm::length(toLight);
+			glm::vec3 lightDir = toLight * (1.0f / dist);
+			float theta = glm::dot(lightDir, coneDirections[i]);
+			if (theta > light.cutoffAngle) {
+				glm::vec3 diffuse = light.diffuse * std::max(glm::dot(norm, lightDir), 0.0f) * objectColor;
+				if (blinnPhong) {
+					glm::vec3 halfway = glm::normalize(lightDir + viewDir);
+					diffuse += light.diffuse * specularStrength * std::pow(std::max(glm::dot(norm, halfway), 0.0f), shininess);
+				}
+				float attenuation = 1.0f / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * dist * dist);
+				result += diffuse * attenuation;
+			}
+		}
+		batch.colorR[lane] = result.x;
+		batch.colorG[lane] = result.y;
+		batch.colorB[lane] = result.z;
+	}
+}
+
+SOFTWARE_AVX2 static void shadeBatchAvx2(FragmentBatch& batch, const SpotLight* lights, const glm::vec3* coneDirections,
+	int lightCount, const glm::vec3& ambientLight, bool blinnPhong, float shininess, float specularStrength) {
+	__m256 posX = _mm256_load_ps(batch.posX), posY = _mm256_load_ps(batch.posY), posZ = _mm256_load_ps(batch.posZ);
+	__m256 normalX = _mm256_load_ps(batch.normalX), normalY = _mm256_load_ps(batch.normalY), normalZ = _mm256_load_ps(batch.normalZ);
+	__m256 objectR = _mm256_load_ps(batch.colorR), objectG = _mm256_load_ps(batch.colorG), objectB = _mm256_load_ps(batch.colorB);
+	__m256 resultR = _mm256_mul_ps(objectR, _mm256_set1_ps(ambientLight.x));
+	__m256 resultG = _mm256_mul_ps(objectG, _mm256_set1_ps(ambientLight.y));
+	__m256 resultB = _mm256_mul_ps(objectB, _mm256_set1_ps(ambientLight.z));
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	alignas(32) float specular[SHADE_LANES];
+	for (int i = 0; i < lightCount; i++) {
+		const SpotLight& light = lights[i];
+		__m256 toX = _mm256_sub_ps(_mm256_set1_ps(light.position.x), posX);
+		__m256 toY = _mm256_sub_ps(_mm256_set1_ps(light.position.y), posY);
+		__m256 toZ = _mm256_sub_ps(_mm256_set1_ps(light.position.z), posZ);
+		__m256 distSquared = _mm256_fmadd_ps(toX, toX, _mm256_fmadd_ps(toY, toY, _mm256_mul_ps(toZ, toZ)));
+		__m256 dist = _mm256_sqrt_ps(distSquared);
+		__m256 inverseDist = _mm256_div_ps(one, dist);
+		__m256 lightX = _mm256_mul_ps(toX, inverseDist);
+		__m256 lightY = _mm256_mul_ps(toY, inverseDist);
+		__m256 lightZ = _mm256_mul_ps(toZ, inverseDist);
+		__m256 theta = _mm256_fmadd_ps(lightX, _mm256_set1_ps(coneDirections[i].x),
+			_mm256_fmadd_ps(lightY, _mm256_set1_ps(coneDirections[i].y), _mm256_mul_ps(lightZ, _mm256_set1_ps(coneDirections[i].z))));
+		__m256 inCone = _mm256_cmp_ps(theta, _mm256_set1_ps(light.cutoffAngle), _CMP_GT_OQ);
+		int coneMask = _mm256_movemask_ps(inCone);
+		if (!coneMask) {
+			continue;
+		}
+
+		__m256 diff = _mm256_max_ps(_mm256_fmadd_ps(normalX, lightX, _mm256_fmadd_ps(normalY, lightY, _mm256_mul_ps(normalZ, lightZ))), zero);
+		__m256 attenuation = _mm256_div_ps(one, _mm256_fmadd_ps(_mm256_set1_ps(light.attenuation.z), distSquared,
+			_mm256_fmadd_ps(_mm256_set1_ps(light.attenuation.y), dist, _mm256_set1_ps(light.attenuation.x))));
+		__m256 diffuseR = _mm256_mul_ps(_mm256_mul_ps(diff, objectR), _mm256_set1_ps(light.diffuse.x));
+		__m256 diffuseG = _mm256_mul_ps(_mm256_mul_ps(diff, objectG), _mm256_set1_ps(light.diffuse.y));
+		__m256 diffuseB = _mm256_mul_ps(_mm256_mul_ps(diff, objectB), _mm256_set1_ps(light.diffuse.z));
+		if (blinnPhong) {
+			__m256 halfX = _mm256_add_ps(lightX, _mm256_load_ps(batch.viewX));
+			__m256 halfY = _mm256_add_ps(lightY, _mm256_load_ps(batch.viewY));
+			__m256 halfZ = _mm256_add_ps(lightZ, _mm256_load_ps(batch.viewZ));
+			__m256 halfLength = _mm256_sqrt_ps(_mm256_fmadd_ps(halfX, halfX, _mm256_fmadd_ps(halfY, halfY, _mm256_mul_ps(halfZ, halfZ))));
+			__m256 cosine = _mm256_div_ps(_mm256_fmadd_ps(normalX, halfX, _mm256_fmadd_ps(normalY, halfY, _mm256_mul_ps(normalZ, halfZ))), halfLength);
+			_mm256_store_ps(specular, _mm256_max_ps(cosine, zero));
+			// no vector pow; only the lanes inside the cone pay for it
+			for (int lane = 0; lane < SHADE_LANES; lane++) {
+				specular[lane] = coneMask & (1 << lane) ? std::pow(specular[lane], shininess) * specularStrength : 0.0f;
+			}
+			__m256 highlight = _mm256_load_ps(specular);
+			diffuseR = _mm256_fmadd_ps(highlight, _mm256_set1_ps(light.diffuse.x), diffuseR);
+			diffuseG = _mm256_fmadd_ps(highlight, _mm256_set1_ps(light.diffuse.y), diffuseG);
+			diffuseB = _mm256_fmadd_ps(highlight, _mm256_set1_ps(light.diffuse.z), diffuseB);
+		}
+		attenuation = _mm256_and_ps(attenuation, inCone);
+		resultR = _mm256_fmadd_ps(diffuseR, attenuation, resultR);
+		resultG = _mm256_fmadd_ps(diffuseG, attenuation, resultG);
+		resultB = _mm256_fmadd_ps(diffuseB, attenuation, resultB);
+	}
+	_mm256_store_ps(batch.colorR, resultR);
+	_mm256_store_ps(batch.colorG, resultG);
+	_mm256_store_ps(batch.colorB, resultB);
+}
+
+/* Rasterize every triangle binned to the tile, then shade each covered pixel once */
+void SoftwareRenderer::renderTile(int tile, const std::vector<SoftwareDraw>& draws, const std::vector<SpotLight>& lights,
+	const glm::vec3& ambientLight, const glm::vec3& viewPos) {
+	alignas(32) float depth[SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE];
+	alignas(32) int ids[SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE];
+	float blockFarthest[BLOCKS_PER_ROW * BLOCKS_PER_ROW];
+	std::fill(depth, depth + SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE, 1.0f);
+	std::fill(ids, ids + SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE, -1);
+	std::fill(blockFarthest, blockFarthest + BLOCKS_PER_ROW * BLOCKS_PER_ROW, 1.0f);
+
+	int originX = (tile % tilesX) * SOFTWARE_TILE_SIZE;
+	int originY = (tile / tilesX) * SOFTWARE_TILE_SIZE;
+	int tileWidth = std::min(SOFTWARE_TILE_SIZE, width - originX);
+	int tileHeight = std::min(SOFTWARE_TILE_SIZE, height - originY);
+
+	for (int id : bins[tile]) {
+		const Triangle& t = triangles[id];
+		int blockX0 = (std::max(t.minX, originX) - originX) / SOFTWARE_BLOCK_SIZE;
+		int blockX1 = (std::min(t.maxX, originX + tileWidth - 1) - originX) / SOFTWARE_BLOCK_SIZE;
+		int blockY0 = (std::max(t.minY, originY) - originY) / SOFTWARE_BLOCK_SIZE;
+		int blockY1 = (std::min(t.maxY, originY + tileHeight - 1) - originY) / SOFTWARE_BLOCK_SIZE;
+		for (int by = blockY0; by <= blockY1; by++) {
+			for (int bx = blockX0; bx <= blockX1; bx++) {
+				// the whole triangle is behind everything already drawn in this block
+				float& farthest = blockFarthest[by * BLOCKS_PER_ROW + bx];
+				if (t.minDepth >= farthest) {
+					continue;
+				}
+				int offset = by * SOFTWARE_BLOCK_SIZE * SOFTWARE_TILE_SIZE + bx * SOFTWARE_BLOCK_SIZE;
+				float px = originX + bx * SOFTWARE_BLOCK_SIZE + 0.5f - t.referenceX;
+				float py = originY + by * SOFTWARE_BLOCK_SIZE + 0.5f - t.referenceY;
+				if (useAvx2) {
+					farthest = rasterBlockAvx2(t.edgeA, t.edgeB, t.edgeC, t.depthA, t.depthB, t.depthC, id, px, py, depth + offset, ids + offset);
+				}
+				else {
+					farthest = rasterBlockScalar(t.edgeA, t.edgeB, t.edgeC, t.depthA, t.depthB, t.depthC, id, px, py, depth + offset, ids + offset);
+				}
+			}
+		}
+	}
+
+	// Interpolate and texture a row of eight pixels, then light all of them together
+	FragmentBatch batch;
+	for (int y = 0; y < tileHeight; y++) {
+		for (int x0 = 0; x0 < tileWidth; x0 += SHADE_LANES) {
+			int covered = 0;
+			for (int lane = 0; lane < SHADE_LANES; lane++) {
+				int x = x0 + lane;
+				int id = x < tileWidth ? ids[y * SOFTWARE_TILE_SIZE + x] : -1;
+				if (id < 0) {
+					batch.clear(lane);
+					continue;
+				}
+				covered |= 1 << lane;
+				const Triangle& t = triangles[id];
+				float px = originX + x + 0.5f - t.referenceX, py = originY + y + 0.5f - t.referenceY;
+				// screen-space weights divided by w give perspective-correct attribute weights
+				float weights[3], sum = 0.0f;
+				for (int i = 0; i < 3; i++) {
+					weights[i] = std::max(t.edgeA[i] * px + t.edgeB[i] * py + t.edgeC[i], 0.0f) * t.invW[i];
+					sum += weights[i];
+				}
+				float inverseSum = sum > 0.0f ? 1.0f / sum : 0.0f;
+				glm::vec3 fragPos(0.0f), normal(0.0f);
+				glm::vec2 uv(0.0f);
+				for (int i = 0; i < 3; i++) {
+					float weight = weights[i] * inverseSum;
+					fragPos += t.world[i] * weight;
+					normal += t.normal[i] * weight;
+					uv += t.uv[i] * weight;
+				}
+				const Mesh& mesh = *draws[t.draw].mesh;
+				batch.set(lane, fragPos, glm::normalize(normal), glm::normalize(viewPos - fragPos),
+					mesh.texData ? mesh.sampleTexture(uv) : baseColor);
+			}
+
+			if (covered) {
+				if (useAvx2) {
+					shadeBatchAvx2(batch, lights.data(), coneDirections.data(), (int)lights.size(), ambientLight,
+						shadingModel == ShadingModel::BlinnPhong, shininess, specularStrength);
+				}
+				else {
+					shadeBatchScalar(batch, lights.data(), coneDirections.data(), (int)lights.size(), ambientLight,
+						shadingModel == ShadingModel::BlinnPhong, shininess, specularStrength);
+				}
+			}
+			for (int lane = 0; lane < SHADE_LANES && x0 + lane < tileWidth; lane++) {
+				glm::vec3 result = covered & (1 << lane) ? glm::vec3(batch.colorR[lane], batch.colorG[lane], batch.colorB[lane]) : clearColor;
+				unsigned char* out = &pixels[((size_t)(originY + y) * width + originX + x0 + lane) * 3];
+				for (int c = 0; c < 3; c++) {
+					out[c] = (unsigned char)(std::min(std::max(result[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::render(const std::vector<SoftwareDraw>& draws, const std::vector<SpotLight>& lights,
+	const glm::vec3& ambientLight, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos) {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// Vertex transform and triangle setup, one job per chunk of a draw's triangles
+	struct Chunk {
+		int draw, first, count;
+	};
+	std::vector<Chunk> chunks;
+	std::vector<glm::mat4> clipMatrices(draws.size());
+	std::vector<glm::mat3> normalMatrices(draws.size());
+	for (int d = 0; d < (int)draws.size(); d++) {
+		clipMatrices[d] = projection * view * draws[d].model;
+		normalMatrices[d] = glm::transpose(glm::inverse(glm::mat3(draws[d].model)));
+		int count = (int)draws[d].mesh->vertices.size() / 3;
+		for (int first = 0; first < count; first += TRIANGLES_PER_CHUNK) {
+			chunks.push_back({ d, first, std::min(TRIANGLES_PER_CHUNK, count - first) });
+		}
+	}
+	if (chunkTriangles.size() < chunks.size()) {
+		chunkTriangles.resize(chunks.size());
+	}
+	pool.parallelFor((int)chunks.size(), 1, [&](int begin, int end) {
+		for (int c = begin; c < end; c++) {
+			const Chunk& chunk = chunks[c];
+			const SoftwareDraw& draw = draws[chunk.draw];
+			const Vertex* vertices = draw.mesh->vertices.data();
+			std::vector<Triangle>& out = chunkTriangles[c];
+			out.clear();
+			ClipVertex corners[3];
+			for (int t = chunk.first; t < chunk.first + chunk.count; t++) {
+				for (int i = 0; i < 3; i++) {
+					const Vertex& vertex = vertices[t * 3 + i];
+					glm::vec4 position(vertex.position, 1.0f);
+					corners[i].clip = clipMatrices[chunk.draw] * position;
+					corners[i].world = glm::vec3(draw.model * position);
+					corners[i].normal = normalMatrices[chunk.draw] * vertex.normal;
+					corners[i].uv = vertex.texture;
+				}
+				setupTriangle(corners, chunk.draw, out);
+			}
+		}
+	});
+	Clock::time_point setupEnd = Clock::now();
+
+	// Binning keeps submission order inside every tile, so equal depths resolve the way the GPU does
+	triangles.clear();
+	for (int c = 0; c < (int)chunks.size(); c++) {
+		triangles.insert(triangles.end(), chunkTriangles[c].begin(), chunkTriangles[c].end());
+	}
+	for (std::vector<int>& bin : bins) {
+		bin.clear();
+	}
+	for (int i = 0; i < (int)triangles.size(); i++) {
+		const Triangle& t = triangles[i];
+		for (int ty = t.minY / SOFTWARE_TILE_SIZE; ty <= t.maxY / SOFTWARE_TILE_SIZE; ty++) {
+			for (int tx = t.minX / SOFTWARE_TILE_SIZE; tx <= t.maxX / SOFTWARE_TILE_SIZE; tx++) {
+				bins[ty * tilesX + tx].push_back(i);
+			}
+		}
+	}
+	triangleCount = (int)triangles.size();
+	Clock::time_point binEnd = Clock::now();
+
+	coneDirections.resize(lights.size());
+	for (int i = 0; i < (int)lights.size(); i++) {
+		coneDirections[i] = glm::normalize(-lights[i].direction);
+	}
+
+	pool.parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+		for (int tile = begin; tile < end; tile++) {
+			renderTile(tile, draws, lights, ambientLight, viewPos);
+		}
+	});
+	Clock::time_point tileEnd = Clock::now();
+
+	setupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+	binMs = std::chrono::duration<double, std::milli>(binEnd - setupEnd).count();
+	tileMs = std::chrono::duration<double, std::milli>(tileEnd - binEnd).count();
+}
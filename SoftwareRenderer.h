@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "SpotLight.h"
+#include "ThreadPool.h"
+#include "ShaderVariantCache.h"
+
+// Side of the square screen tiles triangles are binned into; one thread rasterizes and shades a tile at a time
+const int SOFTWARE_TILE_SIZE = 64;
+// Side of the blocks that keep the farthest depth inside a tile, for rejecting hidden triangles early
+const int SOFTWARE_BLOCK_SIZE = 8;
+
+struct SoftwareDraw {
+	const Mesh* mesh;       /* read through vertices and texData, so it may be a mesh that was never uploaded */
+	glm::mat4 model;
+};
+
+// CPU renderer for machines without a GPU: triangles are set up in parallel, binned into screen tiles and each
+// tile is rasterized into a depth and triangle id buffer before every visible pixel is shaded once with the
+// spotlight model of fragment_shader.glsl. Depth testing and lighting run on 8 pixels at a time with AVX2 when the
+// CPU has it. Shadows and the post-processing passes are not reproduced; the result matches the GPU path run with
+// --post none and no shadow maps.
+class SoftwareRenderer {
+public:
+	int width, height;
+	std::vector<unsigned char> pixels;  /* RGB rows from bottom to top, the layout glReadPixels returns */
+	glm::vec3 clearColor;
+	glm::vec3 baseColor;                /* object color of meshes without a texture */
+	ShadingModel shadingModel;
+	float shininess;
+	float specularStrength;
+	bool useAvx2;                       /* detected at construction; turn off to time the scalar path */
+	double setupMs, binMs, tileMs;      /* CPU time of the stages in the last frame */
+	int triangleCount;                  /* triangles left after clipping and culling in the last frame */
+
+	SoftwareRenderer(ThreadPool& pool, int width, int height);
+	void render(const std::vector<SoftwareDraw>& draws, const std::vector<SpotLight>& lights, const glm::vec3& ambientLight,
+		const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+private:
+	struct ClipVertex {
+		glm::vec4 clip;
+		glm::vec3 world;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+	// Edge functions are scaled by the triangle's area, so at a pixel center they are its barycentric weights.
+	// Both the edges and the depth plane are A * (x - referenceX) + B * (y - referenceY) + C.
+	struct Triangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;     /* NDC depth as a plane in screen space */
+		float referenceX, referenceY;
+		float minDepth;
+		float invW[3];
+		glm::vec3 world[3];
+		glm::vec3 normal[3];
+		glm::vec2 uv[3];
+		int minX, minY, maxX, maxY;       /* pixel bounds, inclusive and clamped to the screen */
+		int draw;
+	};
+	ThreadPool& pool;
+	int tilesX, tilesY;
+	std::vector<std::vector<Triangle>> chunkTriangles;   /* set up triangles per input chunk, in draw order */
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<int>> bins;                  /* triangle indices overlapping each tile, in draw order */
+	std::vector<glm::vec3> coneDirections;               /* normalized axis of every light's cone */
+	void setupTriangle(const ClipVertex* corners, int draw, std::vector<Triangle>& out) const;
+	void emitTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int draw, std::vector<Triangle>& out) const;
+	void renderTile(int tile, const std::vector<SoftwareDraw>& draws, const std::vector<SpotLight>& lights,
+		const glm::vec3& ambientLight, const glm::vec3& viewPos);
+};
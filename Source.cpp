@@ -8,6 +8,9 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -15,28 +18,266 @@
 // Import local files
 #include "Shader.h"
 #include "Mesh.h"
+#include "SpotLight.h"
+#include "ShadowAtlas.h"
+#include "ThreadPool.h"
+#include "LightingPass.h"
+#include "Scene.h"
+#include "Meshlets.h"
+#include "GltfAsset.h"
+#include "LightShow.h"
+#include "Simulation.h"
+#include "RenderTarget.h"
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+#include "FramePacer.h"
+#include "VolumetricPass.h"
+#include "PostProcess.h"
+#include "TemporalAA.h"
+#include "ShaderVariantCache.h"
+#include "ShaderManager.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include "SoftwareRenderer.h"
+#include "PathTracer.h"
+#include "Ppm.h"
+#include "RegressionHarness.h"
+#include "Microbenchmarks.h"
+#include "SceneFile.h"
+#include "StressScene.h"
+#include "MemoryReport.h"
 
 // global variables
 static unsigned int screenshotId = 0;
+static std::string capturePath;             // --capture: where the last frame goes
+static std::string frameTimesPath;          // --frame-times: where the time of every frame goes
 const unsigned int WINDOW_WIDTH = 1024;
 const unsigned int WINDOW_HEIGHT = 768;
 const char* WINDOW_NAME = "COMPSCI 3GC3 Assignment 3 -- Khoa Bui \0";
-
-struct SpotLight {
-	glm::vec3 ambient;
-	glm::vec3 diffuse;
-	glm::vec3 attenuation;
-	glm::vec3 position;
-	glm::vec3 direction;
-	float cutoffAngle;    // The cosine value of cutoff angle
-};
+const float LIGHT_CUTOFF_INTENSITY = 1.0f / 256.0f;   // a light is out of range once it adds less than one 8-bit step
+const glm::vec3 CAMERA_POSITION = glm::vec3(50.0f, 100.0f, 200.0f);
+const glm::vec3 CAMERA_TARGET = glm::vec3(0.0f, 80.0f, 0.0f);
+const glm::vec3 CAMERA_UP = glm::vec3(0.0f, 1.0f, 0.0f);
 
 // Function declarations
-void dump_framebuffer_to_ppm(std::string prefix, unsigned int width, unsigned int height);
-void processInput(GLFWwindow* window);
+std::vector<SpotLight> createSpotlights(int count);
+SceneFile discoScene(int spotlightCount);
+std::vector<std::unique_ptr<Mesh>> loadSceneMeshes(const SceneFile& sceneFile, bool upload);
+void addSceneInstances(Scene& scene, const SceneFile& sceneFile, const std::vector<Mesh*>& meshes);
+std::vector<SoftwareDraw> sceneDraws(const SceneFile& sceneFile, const std::vector<std::unique_ptr<Mesh>>& meshes);
+MemoryReport gatherMemory(const SceneFile& sceneFile, const std::vector<Mesh*>& meshes, const std::string& modelPath,
+	const ShaderManager& shaderManager);
+int renderSoftware(int frames, const SceneFile& sceneFile, ShadingModel shadingModel, double simulationRate, bool paused);
+int renderRaytraced(TraceMode mode, int samples, const SceneFile& sceneFile, ShadingModel shadingModel);
+std::string screenshot_name(std::string prefix);
+void dump_framebuffer_to_ppm(std::string fileName, unsigned int width, unsigned int height);
+void processInput(GLFWwindow* window, Simulation& simulation);
+void addModelNode(Scene& scene, const GltfAsset& asset, int node, int parent, const std::vector<std::vector<int>>& primitiveMeshes,
+	const std::vector<Mesh*>& meshes);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
-int main() {
+int main(int argc, char** argv) {
+	// Command line: --spotlights N sets the number of moving spots (3 to MAX_SPOTLIGHTS),
+	// --benchmark N renders N frames without vsync, prints timings and exits,
+	// --volumetric-scale N marches light shafts at 1/N resolution (2 or 4),
+	// --volumetric-steps N caps the samples per shaft (0 turns shafts off),
+	// --shading lambert|blinn-phong picks the lighting model,
+	// --dynamic-resolution MS scales the scene resolution to hold MS milliseconds of GPU time per frame,
+	// --swap-interval N presents every N vblanks (0 off, -1 adaptive), --fps-limit N caps the frame rate,
+	// --show FILE drives the lights from a cue file (see disco.cue) instead of the fixed rotation,
+	// --sim-rate HZ sets the fixed rate of the simulation thread,
+	// --post LIST enables post effects from bloom,exposure,tonemap,fxaa (default all, none for a plain copy),
+	// --taa SCALE turns on temporal anti-aliasing (replacing FXAA), rendering at SCALE (0.5 to 1) of the output,
+	// --model FILE adds the scene of a binary glTF (.glb) file,
+	// --meshlets on splits the OBJ meshes into clusters that are frustum and back-face culled every frame,
+	// --software N renders N frames on the CPU without a window or OpenGL, prints timings and saves the last frame,
+	// --raytrace direct|path ray traces one still on the CPU: direct matches the rasterized lighting (with ray traced
+	// shadows) for image comparisons, path accumulates --samples N path traced samples per pixel (default 64),
+	// --capture FILE saves the last frame of a benchmark, software or ray traced run, --frame-times FILE saves the time
+	// of each of its frames, --hidden on keeps the window from showing, --paused on starts with the lights frozen,
+	// --regress FILE runs the golden-image and frame-time cases of a script (see regression/cases.txt) and exits
+	// non-zero if any fail, --regress-update on records the results of --regress as the new goldens and baselines,
+	// --microbench FILE times the loading, upload, uniform, capture and submission hot paths, saves the results as
+	// JSON and exits; --microbench-filter TEXT runs only the benchmarks whose name contains TEXT,
+	// --scene FILE draws the meshes, instances and spotlights of a scene file (see SceneFile.h) instead of the disco
+	// scene, --generate-scene DIR writes a procedural stress scene there and draws it, sized by --scene-meshes N,
+	// --scene-instances N, --scene-textures N, --scene-texture-size N, --scene-triangles N (per mesh),
+	// --scene-spotlights N and --seed N; add --benchmark N --hidden on for unattended runs of a fixed length,
+	// --residency gpu|compact|full picks what meshes keep on the CPU after upload (default gpu: nothing; compact:
+	// positions and indices for picking; full: everything, for editing), --memory-report on prints the CPU and GPU
+	// memory of every mesh, texture and shader once the scene is loaded
+	int spotlightCount = 3;
+	ShadingModel shadingModel = ShadingModel::Lambert;
+	int benchmarkFrames = 0;
+	int volumetricScale = 2;
+	int volumetricSteps = 32;
+	float dynamicResolutionMs = 0.0f;
+	std::string showPath;
+	double simulationRate = 120.0;
+	std::string postEffects = "bloom,exposure,tonemap,fxaa";
+	float taaScale = 0.0f;
+	std::string modelPath;
+	bool useMeshlets = false;
+	int softwareFrames = 0;
+	std::string raytraceMode;
+	int raytraceSamples = 64;
+	bool hidden = false;
+	bool startPaused = false;
+	std::string regressPath;
+	bool regressUpdate = false;
+	std::string microbenchPath;
+	std::string microbenchFilter;
+	std::string scenePath;
+	std::string generateDirectory;
+	StressSceneSettings stressSettings;
+	MeshResidency residency = MeshResidency::GpuOnly;
+	bool memoryReport = false;
+	FramePacer framePacer;
+	for (int i = 1; i + 1 < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--spotlights") {
+			spotlightCount = std::atoi(argv[++i]);
+		}
+		else if (arg == "--benchmark") {
+			benchmarkFrames = std::atoi(argv[++i]);
+		}
+		else if (arg == "--volumetric-scale") {
+			volumetricScale = std::atoi(argv[++i]);
+		}
+		else if (arg == "--volumetric-steps") {
+			volumetricSteps = std::atoi(argv[++i]);
+		}
+		else if (arg == "--dynamic-resolution") {
+			dynamicResolutionMs = (float)std::atof(argv[++i]);
+		}
+		else if (arg == "--swap-interval") {
+			framePacer.swapInterval = std::atoi(argv[++i]);
+		}
+		else if (arg == "--fps-limit") {
+			framePacer.targetFps = std::atof(argv[++i]);
+		}
+		else if (arg == "--show") {
+			showPath = argv[++i];
+		}
+		else if (arg == "--software") {
+			softwareFrames = std::atoi(argv[++i]);
+		}
+		else if (arg == "--raytrace") {
+			raytraceMode = argv[++i];
+		}
+		else if (arg == "--samples") {
+			raytraceSamples = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--meshlets") {
+			useMeshlets = std::string(argv[++i]) == "on";
+		}
+		else if (arg == "--model") {
+			modelPath = argv[++i];
+		}
+		else if (arg == "--taa") {
+			taaScale = (float)std::atof(argv[++i]);
+		}
+		else if (arg == "--post") {
+			postEffects = argv[++i];
+		}
+		else if (arg == "--sim-rate") {
+			simulationRate = std::max(1.0, std::atof(argv[++i]));
+		}
+		else if (arg == "--capture") {
+			capturePath = argv[++i];
+		}
+		else if (arg == "--frame-times") {
+			frameTimesPath = argv[++i];
+		}
+		else if (arg == "--hidden") {
+			hidden = std::string(argv[++i]) == "on";
+		}
+		else if (arg == "--paused") {
+			startPaused = std::string(argv[++i]) == "on";
+		}
+		else if (arg == "--regress") {
+			regressPath = argv[++i];
+		}
+		else if (arg == "--regress-update") {
+			regressUpdate = std::string(argv[++i]) == "on";
+		}
+		else if (arg == "--microbench") {
+			microbenchPath = argv[++i];
+		}
+		else if (arg == "--microbench-filter") {
+			microbenchFilter = argv[++i];
+		}
+		else if (arg == "--scene") {
+			scenePath = argv[++i];
+		}
+		else if (arg == "--generate-scene") {
+			generateDirectory = argv[++i];
+		}
+		else if (arg == "--scene-meshes") {
+			stressSettings.meshes = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (arg == "--scene-instances") {
+			stressSettings.instances = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (arg == "--scene-textures") {
+			stressSettings.textures = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (arg == "--scene-texture-size") {
+			stressSettings.textureSize = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--scene-triangles") {
+			stressSettings.trianglesPerMesh = std::max(8, std::atoi(argv[++i]));
+		}
+		else if (arg == "--scene-spotlights") {
+			stressSettings.spotlights = std::atoi(argv[++i]);
+		}
+		else if (arg == "--seed") {
+			stressSettings.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--residency") {
+			std::string mode = argv[++i];
+			residency = mode == "full" ? MeshResidency::Full : mode == "compact" ? MeshResidency::Compact : MeshResidency::GpuOnly;
+		}
+		else if (arg == "--memory-report") {
+			memoryReport = std::string(argv[++i]) == "on";
+		}
+		else if (arg == "--shading") {
+			shadingModel = std::string(argv[++i]) == "blinn-phong" ? ShadingModel::BlinnPhong : ShadingModel::Lambert;
+		}
+	}
+	spotlightCount = glm::clamp(spotlightCount, 3, MAX_SPOTLIGHTS);
+	if (!regressPath.empty()) {
+		RegressionHarness harness(argv[0]);
+		harness.update = regressUpdate;
+		return harness.run(regressPath) > 0 ? 1 : 0;
+	}
+
+	// What to draw: a generated stress scene, a scene file or the disco scene
+	if (!generateDirectory.empty()) {
+		scenePath = generateStressScene(stressSettings, generateDirectory);
+		if (scenePath.empty()) {
+			return -1;
+		}
+		std::cout << "Generated " << scenePath << ": " << stressSettings.meshes << " meshes of " << stressSettings.trianglesPerMesh << " triangles, "
+			<< stressSettings.instances << " instances, " << stressSettings.textures << " textures, seed " << stressSettings.seed << std::endl;
+	}
+	SceneFile sceneFile;
+	if (scenePath.empty()) {
+		sceneFile = discoScene(spotlightCount);
+	}
+	else if (!sceneFile.load(scenePath, LIGHT_CUTOFF_INTENSITY)) {
+		return -1;
+	}
+	spotlightCount = (int)sceneFile.spotlights.size();
+
+	if (softwareFrames > 0) {
+		return renderSoftware(softwareFrames, sceneFile, shadingModel, simulationRate, startPaused);
+	}
+	if (!raytraceMode.empty()) {
+		return renderRaytraced(raytraceMode == "path" ? TraceMode::Path : TraceMode::Direct, raytraceSamples, sceneFile, shadingModel);
+	}
+
 	// Initialize and config glfw
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -46,6 +287,10 @@ int main() {
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+	// the microbenchmarks only need a context, so their window never shows
+	if (hidden || !microbenchPath.empty()) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 	// Create window
 	GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_NAME, NULL, NULL);
@@ -62,31 +307,388 @@ int main() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
-	Mesh timmy("./asset/timmy.obj", "./asset/timmy.png");
-	Mesh bucket("./asset/bucket.obj", "./asset/bucket.jpg");
-	Mesh floor("./asset/floor.obj", "./asset/floor.jpeg");
+	if (!microbenchPath.empty()) {
+		int status = runMicrobenchmarks(sceneFile.spotlights, microbenchPath, microbenchFilter);
+		glfwTerminate();
+		return status;
+	}
+
+	double sceneLoadStart = glfwGetTime();
+	std::vector<std::unique_ptr<Mesh>> sceneMeshes = loadSceneMeshes(sceneFile, true);
+	size_t sceneTriangles = 0;
+	for (const SceneInstance& instance : sceneFile.instances) {
+		sceneTriangles += sceneMeshes[instance.mesh]->triangleCount();
+	}
+	std::cout << "Scene: " << sceneMeshes.size() << " meshes, " << sceneFile.instances.size() << " instances, " << sceneTriangles
+		<< " triangles, " << spotlightCount << " spotlights, loaded in " << (glfwGetTime() - sceneLoadStart) * 1000.0 << " ms" << std::endl;
 
 	// enable face culling
-	glEnable(GL_CULL_FACE);
+	glState.setEnabled(GL_CULL_FACE, true);
 
 	// enable depth testing and set depth comparison function
-	glEnable(GL_DEPTH_TEST);
+	glState.setEnabled(GL_DEPTH_TEST, true);
 	glDepthFunc(GL_LESS);
 
 	// render in wireframe mode
 	// glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	// Compile vertex & fragment shaders and create a shader program
-	Shader shaderProgram("vertex_shader.glsl", "fragment_shader.glsl");
+	// All programs compile in the background and are rebuilt when their GLSL files are saved
+	ShaderManager shaderManager;
+	ShaderHandle depthShader = shaderManager.add("shadow_vertex_shader.glsl", "shadow_fragment_shader.glsl");
+
+	// Lighting programs are specialized per draw (light count, shadows, texture, shading model)
+	ShaderVariantCache lightingShaders(shaderManager, "vertex_shader.glsl", "fragment_shader.glsl");
+
+	// One depth atlas shared by every spotlight
+	ShadowAtlas shadowAtlas(4096);
+
+	// The scene renders offscreen in HDR so later passes can read its depth and bright lights do not clip
+	int bufferWidth, bufferHeight;
+	glfwGetFramebufferSize(window, &bufferWidth, &bufferHeight);
+	RenderTarget sceneTarget(bufferWidth, bufferHeight, GL_RGBA16F, true, true);
+	RenderTarget compositeTarget(bufferWidth, bufferHeight, GL_RGBA16F, false);
+
+	// Optionally trade sharpness for frame time: the scene renders smaller and is upscaled to the window
+	DynamicResolution dynamicResolution;
+	dynamicResolution.enabled = dynamicResolutionMs > 0.0f;
+	dynamicResolution.targetMs = dynamicResolutionMs;
+	GpuTimer lightingTimer;
+
+	// Per-frame shader data (the light block today) is written straight into mapped buffer memory
+	StreamBuffer frameUniforms(GL_UNIFORM_BUFFER, 64 * 1024);
+
+	// Light shafts in haze
+	VolumetricPass volumetricPass(shaderManager, bufferWidth, bufferHeight);
+	volumetricPass.enabled = volumetricSteps > 0;
+	volumetricPass.resolutionDivisor = glm::clamp(volumetricScale, 1, 8);
+	volumetricPass.maxSteps = glm::max(volumetricSteps, 1);
+	volumetricPass.minSteps = glm::min(volumetricPass.minSteps, volumetricPass.maxSteps);
+	volumetricPass.stepCount = glm::min(volumetricPass.stepCount, volumetricPass.maxSteps);
+
+	// Bloom, exposure, tone mapping and anti-aliasing on the way to the window
+	PostProcess postProcess(shaderManager);
+	postProcess.bloomEnabled = postEffects.find("bloom") != std::string::npos;
+	postProcess.autoExposureEnabled = postEffects.find("exposure") != std::string::npos;
+	postProcess.toneMappingEnabled = postEffects.find("tonemap") != std::string::npos;
+	postProcess.fxaaEnabled = postEffects.find("fxaa") != std::string::npos;
+
+	// Jittered rendering accumulated over frames, optionally reconstructing full resolution from a smaller render
+	TemporalAA temporalAA(shaderManager, bufferWidth, bufferHeight);
+	temporalAA.enabled = taaScale > 0.0f;
+	temporalAA.renderScale = glm::clamp(taaScale, 0.5f, 1.0f);
+	if (temporalAA.enabled) {
+		postProcess.fxaaEnabled = false;
+	}
 
 	// Camera settings (position and target vary per task)
-	glm::vec3 cameraPos = glm::vec3(50.0f, 100.0f, 200.0f);
-	glm::vec3 cameraTarget = glm::vec3(0.0f, 80.0f, 0.0f);
-	glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 cameraPos = CAMERA_POSITION;
+	glm::vec3 cameraTarget = CAMERA_TARGET;
+	glm::vec3 cameraUp = CAMERA_UP;
+
+
+	std::vector<SpotLight> spotlights = sceneFile.spotlights;
+	std::vector<SpotLight> frameLights = spotlights;
+
+	// A cue file replaces the fixed rotation; fixtures map onto the spotlights in order
+	LightShow lightShow;
+	bool showLoaded = !showPath.empty() && lightShow.load(showPath);
+
+	// Light animation runs on its own thread at a fixed rate; frames draw interpolated snapshots
+	Simulation simulation(spotlights, showLoaded ? &lightShow : nullptr, LIGHT_CUTOFF_INTENSITY, 1.0 / simulationRate);
+	simulation.paused = startPaused;
+
+	// Every draw only loops over the lights whose cone reaches its bounding sphere
+	ThreadPool threadPool;
+	LightingPass lightingPass(threadPool, lightingShaders);
+	lightingPass.shadingModel = shadingModel;
+
+	// Every object is a scene entity with its own transform; entity meshes index this table
+	std::vector<Mesh*> meshes;
+	for (std::unique_ptr<Mesh>& mesh : sceneMeshes) {
+		meshes.push_back(mesh.get());
+	}
+
+	// Large meshes are drawn cluster by cluster, skipping the ones off screen or facing away
+	if (useMeshlets) {
+		for (Mesh* mesh : meshes) {
+			double buildStart = glfwGetTime();
+			if (mesh->buildMeshlets()) {
+				std::cout << "Meshlets: " << mesh->meshlets.count << " clusters for " << mesh->vertices.size() << " vertices in "
+					<< (glfwGetTime() - buildStart) * 1000.0 << " ms" << std::endl;
+			}
+		}
+	}
+	Scene scene;
+	addSceneInstances(scene, sceneFile, meshes);
+
+	// A glTF model brings its node hierarchy along; each triangle primitive becomes a mesh of its own
+	std::vector<std::unique_ptr<Mesh>> modelMeshes;
+	if (!modelPath.empty()) {
+		double loadStart = glfwGetTime();
+		GltfAsset model(modelPath);
+		std::vector<std::vector<int>> primitiveMeshes(model.meshes.size());
+		for (int m = 0; m < (int)model.meshes.size(); m++) {
+			for (int p = 0; p < (int)model.meshes[m].size(); p++) {
+				if (model.meshes[m][p].mode != GL_TRIANGLES) {
+					continue;
+				}
+				modelMeshes.emplace_back(new Mesh(model, m, p));
+				primitiveMeshes[m].push_back((int)meshes.size());
+				meshes.push_back(modelMeshes.back().get());
+			}
+		}
+		for (int node : model.rootNodes) {
+			addModelNode(scene, model, node, NO_PARENT, primitiveMeshes, meshes);
+		}
+		if (model.loaded) {
+			std::cout << "Loaded " << modelPath << ": " << modelMeshes.size() << " primitives in " << (glfwGetTime() - loadStart) * 1000.0
+				<< " ms" << std::endl;
+		}
+	}
+	scene.updateTransforms(&threadPool);
+
+	// Everything is uploaded and clustered; drop the CPU copies the residency does not keep
+	for (Mesh* mesh : meshes) {
+		mesh->setResidency(residency);
+	}
+	if (memoryReport) {
+		gatherMemory(sceneFile, meshes, modelPath, shaderManager).print(20);
+	}
+
+	// Nothing in the scene moves, so all meshes are static casters
+	std::vector<ShadowCaster> staticCasters, dynamicCasters;
+	for (int i = 0; i < scene.size(); i++) {
+		if (scene.meshes[i] != NO_MESH) {
+			staticCasters.push_back({ meshes[scene.meshes[i]], scene.worldMatrices[i] });
+		}
+	}
+
+	// Setting up transformation matrices
+	glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
+	float nearPlane = 0.1f, farPlane = 1000.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, nearPlane, farPlane);
+	glm::mat4 viewProjection = projection * view;
+	glm::mat4 previousViewProjection = viewProjection;
+
+	// Ambient does not depend on the cone so it is summed once for all lights
+	glm::vec3 ambientLight = glm::vec3(0.0f);
+	for (int i = 0; i < spotlightCount; i++) {
+		ambientLight += spotlights[i].ambient;
+	}
+	lightingPass.ambientLight = ambientLight;
+
+	// Submit every variant the scene can ask for so they all compile together instead of stalling on first use
+	for (int lightCount = 0; lightCount <= spotlightCount; lightCount++) {
+		for (Mesh* mesh : meshes) {
+			lightingShaders.prepare({ lightCount, shadowAtlas.enabled, mesh->hasTexture, shadingModel });
+		}
+	}
+
+	// Benchmark mode measures the uncapped frame rate
+	int frameCount = 0;
+	double cpuFrameMs = 0.0;
+	std::vector<double> frameTimes;
+	long long mapsRendered = 0, mapsReused = 0;
+	double scaleSum = 0.0;
+	long long callsIssued = 0, callsSkipped = 0;
+	if (benchmarkFrames > 0) {
+		framePacer.swapInterval = 0;
+	}
+	framePacer.applySwapInterval();
+	simulation.start();
 
-	
-	SpotLight spotlights[3];
+	while (!glfwWindowShouldClose(window)) {
+		framePacer.beginFrame();
+		glState.beginFrame();
+		frameUniforms.beginFrame();
+		double frameStart = glfwGetTime();
+
+		processInput(window, simulation);
+		shaderManager.update();
+
+		// Follow window resizes; skip drawing while minimized
+		glfwGetFramebufferSize(window, &bufferWidth, &bufferHeight);
+		if (bufferWidth == 0 || bufferHeight == 0) {
+			glfwPollEvents();
+			continue;
+		}
+		int sceneWidth = temporalAA.sceneWidth(dynamicResolution.scaledWidth(bufferWidth));
+		int sceneHeight = temporalAA.sceneHeight(dynamicResolution.scaledHeight(bufferHeight));
+		sceneTarget.resize(sceneWidth, sceneHeight);
+		compositeTarget.resize(sceneWidth, sceneHeight);
+		volumetricPass.resize(sceneWidth, sceneHeight);
+		sceneTarget.bind();
+
+		// Background color
+		glClearColor(0.3f, 0.4f, 0.5f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		const GLfloat noMotion[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearBufferfv(GL_COLOR, 1, noMotion);
+
+		// Only the rasterized scene is jittered; everything else keeps the stable projection
+		viewProjection = projection * view;
+		glm::mat4 jitteredProjection = temporalAA.jitterProjection(projection, sceneWidth, sceneHeight);
+
+		simulation.interpolate(frameLights);
+		StreamAllocation lightBlock = frameUniforms.allocate(sizeof(SpotLightBlock));
+		if (lightBlock.data) {
+			writeSpotLightBlock((SpotLightBlock*)lightBlock.data, frameLights);
+			frameUniforms.commit();
+			frameUniforms.bindRange(SPOTLIGHT_BLOCK_BINDING, lightBlock);
+		}
+
+		// World matrices and bounds of entities that moved
+		scene.updateTransforms(&threadPool);
+
+		// Refresh shadow maps that no longer cover their light's cone
+		Shader& depthProgram = shaderManager.get(depthShader);
+		shadowAtlas.update(frameLights, view, projection, depthProgram, staticCasters, dynamicCasters);
+
+		// Each draw uses the program specialized for the lights that reach it
+		lightingTimer.begin();
+		FrameCamera camera = { view, jitteredProjection, viewProjection, previousViewProjection, cameraPos, nearPlane, farPlane };
+		lightingPass.render(scene, meshes, frameLights, shadowAtlas, camera);
+		lightingTimer.end();
+
+		// Add light shafts, then post-process (and upscale) into the window
+		const RenderTarget* hdrImage = &sceneTarget;
+		if (volumetricPass.enabled) {
+			volumetricPass.render(sceneTarget, view, projection, shadowAtlas);
+			compositeTarget.bind();
+			volumetricPass.composite(sceneTarget);
+			hdrImage = &compositeTarget;
+		}
+		if (temporalAA.enabled) {
+			hdrImage = &temporalAA.resolve(*hdrImage, sceneTarget, bufferWidth, bufferHeight, viewProjection, previousViewProjection);
+		}
+		postProcess.render(*hdrImage, bufferWidth, bufferHeight, framePacer.deltaSeconds);
+		previousViewProjection = viewProjection;
+
+		frameUniforms.endFrame();
+
+		// The passes are timed separately since GL_TIME_ELAPSED queries cannot nest
+		double gpuFrameMs = shadowAtlas.timer.lastMs + lightingTimer.lastMs + (volumetricPass.enabled ? volumetricPass.timer.lastMs : 0.0)
+			+ postProcess.lastMs() + (temporalAA.enabled ? temporalAA.timer.lastMs : 0.0);
+		dynamicResolution.update(gpuFrameMs);
+
+		// The last benchmark frame is read back before it is presented
+		if (benchmarkFrames > 0 && frameCount + 1 >= benchmarkFrames && !capturePath.empty()) {
+			int buffer_width, buffer_height;
+			glfwGetFramebufferSize(window, &buffer_width, &buffer_height);
+			dump_framebuffer_to_ppm(capturePath, buffer_width, buffer_height);
+		}
+
+		// Swap buffers and poll IO events
+		glfwSwapBuffers(window);
+		framePacer.presented();
+		glfwPollEvents();
+
+		if (benchmarkFrames > 0) {
+			double frameMs = (glfwGetTime() - frameStart) * 1000.0;
+			cpuFrameMs += frameMs;
+			frameTimes.push_back(frameMs);
+			mapsRendered += shadowAtlas.renderedCount;
+			mapsReused += shadowAtlas.reusedCount;
+			scaleSum += dynamicResolution.scale;
+			callsIssued += glState.issuedCalls;
+			callsSkipped += glState.skippedCalls;
+			if (++frameCount >= benchmarkFrames) {
+				std::cout << "Benchmark: " << spotlightCount << " spotlights, " << frameCount << " frames" << std::endl;
+				std::cout << "  frame time (CPU):   " << cpuFrameMs / frameCount << " ms" << std::endl;
+				std::cout << "  shadow pass (GPU):  " << shadowAtlas.timer.averageMs() << " ms (budget " << shadowAtlas.budgetMs << " ms)" << std::endl;
+				std::cout << "  shadow maps:        " << mapsRendered << " rendered, " << mapsReused << " reused" << std::endl;
+				if (volumetricPass.enabled) {
+					std::cout << "  light shafts (GPU): " << volumetricPass.timer.averageMs() << " ms at 1/" << volumetricPass.resolutionDivisor
+						<< " resolution, " << volumetricPass.stepCount << " steps (budget " << volumetricPass.budgetMs << " ms)" << std::endl;
+				}
+				double postMs = (postProcess.bloomEnabled ? postProcess.bloomTimer.averageMs() : 0.0)
+					+ (postProcess.autoExposureEnabled ? postProcess.exposureTimer.averageMs() : 0.0) + postProcess.resolveTimer.averageMs();
+				std::cout << "  post (GPU):         " << postMs << " ms (budget " << postProcess.budgetMs << " ms): bloom "
+					<< (postProcess.bloomEnabled ? postProcess.bloomTimer.averageMs() : 0.0) << ", exposure "
+					<< (postProcess.autoExposureEnabled ? postProcess.exposureTimer.averageMs() : 0.0) << ", resolve "
+					<< postProcess.resolveTimer.averageMs() << " ms at " << bufferWidth << "x" << bufferHeight << std::endl;
+				const MeshletCuller& meshletCuller = lightingPass.meshletCuller;
+				if (meshletCuller.testedCount > 0) {
+					std::cout << "  meshlets (CPU):     " << lightingPass.meshletMs / frameCount << " ms culling, " << (double)meshletCuller.visibleCount / frameCount
+						<< " of " << (double)meshletCuller.testedCount / frameCount << " clusters drawn per frame" << std::endl;
+				}
+				if (temporalAA.enabled) {
+					std::cout << "  temporal AA (GPU):  " << temporalAA.timer.averageMs() << " ms, rendering at " << 100.0f * temporalAA.renderScale
+						<< "% of the output" << std::endl;
+				}
+				std::cout << "  GL state calls:     " << (double)callsIssued / frameCount << " issued, " << (double)callsSkipped / frameCount
+					<< " skipped per frame" << std::endl;
+				FramePacingStats pacing = framePacer.stats();
+				std::cout << "  present interval:   " << pacing.meanMs << " ms mean, " << pacing.jitterMs << " ms jitter, p50 " << pacing.p50Ms
+					<< " / p95 " << pacing.p95Ms << " / p99 " << pacing.p99Ms << " / max " << pacing.maxMs << " ms" << std::endl;
+				simulation.stop();
+				std::cout << "  simulation (CPU):   " << (simulation.steps ? simulation.totalStepMs / simulation.steps : 0.0) << " ms per step at "
+					<< simulationRate << " Hz";
+				if (showLoaded) {
+					std::cout << ", light show of " << lightShow.fixtureCount << " fixtures";
+				}
+				std::cout << std::endl;
+				if (dynamicResolution.enabled) {
+					std::cout << "  dynamic resolution: " << 100.0 * scaleSum / frameCount << "% average scale, " << 100.0f * dynamicResolution.scale
+						<< "% at exit (target " << dynamicResolution.targetMs << " ms)" << std::endl;
+				}
+				MemoryReport memory = gatherMemory(sceneFile, meshes, modelPath, shaderManager);
+				std::cout << "  memory:             " << memory.totalCpuBytes() / (1024.0 * 1024.0) << " MiB CPU, " << memory.totalGpuBytes() / (1024.0 * 1024.0)
+					<< " MiB GPU in meshes, textures and shaders" << std::endl;
+				if (!frameTimesPath.empty()) {
+					writeFrameTimes(frameTimesPath, frameTimes);
+				}
+				break;
+			}
+		}
+	}
+
+	simulation.stop();
+	for (std::unique_ptr<Mesh>& mesh : modelMeshes) {
+		mesh->deleteBuffers();
+	}
+	for (std::unique_ptr<Mesh>& mesh : sceneMeshes) {
+		mesh->deleteBuffers();
+	}
+	shadowAtlas.deleteBuffers();
+	volumetricPass.deleteBuffers();
+	sceneTarget.deleteBuffers();
+	compositeTarget.deleteBuffers();
+	postProcess.deleteBuffers();
+	temporalAA.deleteBuffers();
+	frameUniforms.deleteBuffers();
+	lightingTimer.deleteQueries();
+	shaderManager.deleteAll();
+	glfwTerminate();
+	return 0;
+}
+
+/* Recreate a glTF node and its subtree as scene entities; primitives hang below their node. GltfAsset rejects cyclic
+   hierarchies, so the recursion ends. */
+void addModelNode(Scene& scene, const GltfAsset& asset, int node, int parent, const std::vector<std::vector<int>>& primitiveMeshes,
+	const std::vector<Mesh*>& meshes) {
+	const GltfAsset::Node& source = asset.nodes[node];
+	int entity = scene.createEntity(parent, NO_MESH, { glm::vec3(0.0f), 0.0f });
+	scene.setPosition(entity, source.translation);
+	scene.setRotation(entity, source.rotation);
+	scene.setScale(entity, source.scale);
+	if (source.mesh >= 0 && source.mesh < (int)primitiveMeshes.size()) {
+		for (int mesh : primitiveMeshes[source.mesh]) {
+			scene.createEntity(entity, mesh, { meshes[mesh]->boundsCenter, meshes[mesh]->boundsRadius });
+		}
+	}
+	for (int child : source.children) {
+		if (child >= 0 && child < (int)asset.nodes.size()) {
+			addModelNode(scene, asset, child, entity, primitiveMeshes, meshes);
+		}
+	}
+}
+
+/* The three colored spots of the original scene, plus count - 3 spots on a ring */
+std::vector<SpotLight> createSpotlights(int count) {
+	std::vector<SpotLight> spotlights(count);
 
 	// Initialize spotlights (all of them have the same position, ambient, cutoff angle and attenuation)
 	for (int i = 0; i < 3; i++) {
@@ -105,102 +707,227 @@ int main() {
 	spotlights[2].diffuse = glm::vec3(0.0f, 0.0f, 1.0f);
 	spotlights[2].direction = glm::vec3(0.0f, -200.0f, 50.0f);
 
-	// Setting up transformation matrices
-	glm::mat4 model = glm::mat4(1.0f);
-	glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
-	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
-
-	// activate shader program
-	shaderProgram.use();
-
-	// Pass model, view and projection matrices to vertex shader
-	shaderProgram.setMat4("model", model);
-	shaderProgram.setMat4("view", view);
-	shaderProgram.setMat4("projection", projection);
+	// Extra spots hang on a ring above the floor, tilted outwards, with hues spread around the color wheel
+	for (int i = 3; i < count; i++) {
+		float angle = 2.0f * (float)M_PI * (i - 3) / (count - 3);
+		float hue = 6.0f * (i - 3) / (count - 3);
+		spotlights[i].ambient = glm::vec3(0.0f);
+		spotlights[i].diffuse = glm::clamp(glm::vec3(glm::abs(hue - 3.0f) - 1.0f, 2.0f - glm::abs(hue - 2.0f), 2.0f - glm::abs(hue - 4.0f)), 0.0f, 1.0f);
+		spotlights[i].attenuation = glm::vec3(1.0f, 0.35f * 1e-4, 0.44 * 1e-4);
+		spotlights[i].position = glm::vec3(120.0f * glm::cos(angle), 200.0f, 120.0f * glm::sin(angle));
+		spotlights[i].direction = glm::vec3(40.0f * glm::cos(angle), -200.0f, 40.0f * glm::sin(angle));
+		spotlights[i].cutoffAngle = glm::cos(M_PI / 8.0f);
+	}
+	for (int i = 0; i < count; i++) {
+		spotlights[i].range = spotLightRange(spotlights[i], LIGHT_CUTOFF_INTENSITY);
+	}
+	return spotlights;
+}
 
-	// Send spotlights to shader
+/* The original scene: Timmy, the floor and the bucket where they were modeled, under createSpotlights(spotlightCount) */
+SceneFile discoScene(int spotlightCount) {
+	SceneFile sceneFile;
+	sceneFile.objectPaths = { "./asset/timmy.obj", "./asset/floor.obj", "./asset/bucket.obj" };
+	sceneFile.texturePaths = { "./asset/timmy.png", "./asset/floor.jpeg", "./asset/bucket.jpg" };
 	for (int i = 0; i < 3; i++) {
-		std::string prefix = "spotlights[" + std::to_string(i) + "].";
-		shaderProgram.setVec3(prefix + "ambient", spotlights[i].ambient);
-		shaderProgram.setVec3(prefix + "attenuation", spotlights[i].attenuation);
-		shaderProgram.setVec3(prefix + "position", spotlights[i].position);
-		shaderProgram.setVec3(prefix + "diffuse", spotlights[i].diffuse);
-		shaderProgram.setVec3(prefix + "direction", spotlights[i].direction);
-		shaderProgram.setFloat(prefix + "cutoffAngle", spotlights[i].cutoffAngle);
+		sceneFile.instances.push_back({ i, glm::vec3(0.0f), 0.0f, 1.0f });
 	}
+	sceneFile.spotlights = createSpotlights(spotlightCount);
+	return sceneFile;
+}
 
-	float theta = 0.0f;
-
-	while (!glfwWindowShouldClose(window)) {
-		processInput(window);
+/* One mesh per mesh line of the scene; upload = false keeps them on the CPU for the software renderers */
+std::vector<std::unique_ptr<Mesh>> loadSceneMeshes(const SceneFile& sceneFile, bool upload) {
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	for (size_t i = 0; i < sceneFile.objectPaths.size(); i++) {
+		meshes.emplace_back(new Mesh(sceneFile.objectPaths[i], sceneFile.texturePaths[i], upload));
+	}
+	return meshes;
+}
 
-		// Background color
-		glClearColor(0.3f, 0.4f, 0.5f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+/* An entity per instance, turned about the vertical axis */
+void addSceneInstances(Scene& scene, const SceneFile& sceneFile, const std::vector<Mesh*>& meshes) {
+	for (const SceneInstance& instance : sceneFile.instances) {
+		const Mesh* mesh = meshes[instance.mesh];
+		int entity = scene.createEntity(NO_PARENT, instance.mesh, { mesh->boundsCenter, mesh->boundsRadius });
+		float halfYaw = glm::radians(instance.yawDegrees) * 0.5f;
+		scene.setPosition(entity, instance.position);
+		scene.setRotation(entity, glm::vec4(0.0f, glm::sin(halfYaw), 0.0f, glm::cos(halfYaw)));
+		scene.setScale(entity, glm::vec3(instance.scale));
+	}
+}
 
-		// Rotation matrix
-		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), theta, glm::vec3(0.0f, 1.0f, 0.0f));
-		theta += 0.05f;
+/* The instances as draws for the CPU renderers, with the world matrices the windowed path computes */
+std::vector<SoftwareDraw> sceneDraws(const SceneFile& sceneFile, const std::vector<std::unique_ptr<Mesh>>& meshes) {
+	std::vector<Mesh*> meshTable;
+	for (const std::unique_ptr<Mesh>& mesh : meshes) {
+		meshTable.push_back(mesh.get());
+	}
+	Scene scene;
+	addSceneInstances(scene, sceneFile, meshTable);
+	scene.updateTransforms(nullptr);
+	std::vector<SoftwareDraw> draws;
+	for (int i = 0; i < scene.size(); i++) {
+		draws.push_back({ meshTable[scene.meshes[i]], scene.worldMatrices[i] });
+	}
+	return draws;
+}
 
-		glm::vec3 newDirection;
-		for (int i = 0; i < 3; i++) {
-			newDirection = glm::vec3(rotation * glm::vec4(spotlights[i].direction, 1.0f));
-			shaderProgram.setVec3("spotlights[" + std::to_string(i) + "].direction", newDirection);
+/* Memory of the meshes (scene meshes first, then the glTF primitives), their textures and the built programs */
+MemoryReport gatherMemory(const SceneFile& sceneFile, const std::vector<Mesh*>& meshes, const std::string& modelPath,
+	const ShaderManager& shaderManager) {
+	MemoryReport report;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		bool fromScene = i < sceneFile.objectPaths.size();
+		std::string name = fromScene ? sceneFile.objectPaths[i] : modelPath + " primitive " + std::to_string(i - sceneFile.objectPaths.size());
+		report.add("mesh", name, meshes[i]->cpuBytes(), meshes[i]->bufferBytes);
+		if (meshes[i]->hasTexture) {
+			report.add("texture", fromScene ? sceneFile.texturePaths[i] : name, meshes[i]->textureCpuBytes(), meshes[i]->textureBytes);
 		}
+	}
+	shaderManager.reportMemory(report);
+	return report;
+}
 
-		timmy.render();
-		floor.render();
-		bucket.render();
+/* The scene drawn by SoftwareRenderer; the lights follow the same simulation as the windowed path */
+int renderSoftware(int frames, const SceneFile& sceneFile, ShadingModel shadingModel, double simulationRate, bool paused) {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point loadStart = Clock::now();
+	std::vector<std::unique_ptr<Mesh>> meshes = loadSceneMeshes(sceneFile, false);
+	std::cout << "Loaded meshes in " << std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count() << " ms" << std::endl;
+
+	std::vector<SoftwareDraw> draws = sceneDraws(sceneFile, meshes);
+	std::vector<SpotLight> spotlights = sceneFile.spotlights;
+	int spotlightCount = (int)spotlights.size();
+	std::vector<SpotLight> frameLights = spotlights;
+	glm::vec3 ambientLight = glm::vec3(0.0f);
+	for (const SpotLight& light : spotlights) {
+		ambientLight += light.ambient;
+	}
+	glm::mat4 view = glm::lookAt(CAMERA_POSITION, CAMERA_TARGET, CAMERA_UP);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
 
-		// Swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	ThreadPool threadPool;
+	SoftwareRenderer renderer(threadPool, WINDOW_WIDTH, WINDOW_HEIGHT);
+	renderer.shadingModel = shadingModel;
+	Simulation simulation(spotlights, nullptr, LIGHT_CUTOFF_INTENSITY, 1.0 / simulationRate);
+	simulation.paused = paused;
+	simulation.start();
+
+	std::vector<double> frameTimes;
+	double frameMs = 0.0, setupMs = 0.0, binMs = 0.0, tileMs = 0.0;
+	for (int frame = 0; frame < frames; frame++) {
+		Clock::time_point frameStart = Clock::now();
+		simulation.interpolate(frameLights);
+		renderer.render(draws, frameLights, ambientLight, view, projection, CAMERA_POSITION);
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+		frameMs += frameTimes.back();
+		setupMs += renderer.setupMs;
+		binMs += renderer.binMs;
+		tileMs += renderer.tileMs;
 	}
+	simulation.stop();
+
+	std::cout << "Software: " << spotlightCount << " spotlights, " << frames << " frames at " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT
+		<< " on " << threadPool.size() << " threads (" << (renderer.useAvx2 ? "AVX2" : "scalar") << ")" << std::endl;
+	std::cout << "  frame time (CPU):   " << frameMs / frames << " ms" << std::endl;
+	std::cout << "  setup / bin / tiles: " << setupMs / frames << " / " << binMs / frames << " / " << tileMs / frames << " ms, "
+		<< renderer.triangleCount << " triangles" << std::endl;
+	writePpm(capturePath.empty() ? screenshot_name("Software-ss") : capturePath, renderer.pixels.data(), WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (!frameTimesPath.empty()) {
+		writeFrameTimes(frameTimesPath, frameTimes);
+	}
+	for (std::unique_ptr<Mesh>& mesh : meshes) {
+		mesh->deleteBuffers();
+	}
+	return 0;
+}
 
-	timmy.deleteBuffers();
-	bucket.deleteBuffers();
-	floor.deleteBuffers();
-	shaderProgram.deleteProgram();
-	glfwTerminate();
+/* A still of the scene from PathTracer, with the lights where the scene starts */
+int renderRaytraced(TraceMode mode, int samples, const SceneFile& sceneFile, ShadingModel shadingModel) {
+	std::vector<std::unique_ptr<Mesh>> meshes = loadSceneMeshes(sceneFile, false);
+	std::vector<SoftwareDraw> draws = sceneDraws(sceneFile, meshes);
+	std::vector<SpotLight> spotlights = sceneFile.spotlights;
+	glm::vec3 ambientLight = glm::vec3(0.0f);
+	for (const SpotLight& light : spotlights) {
+		ambientLight += light.ambient;
+	}
+
+	ThreadPool threadPool;
+	PathTracer tracer(threadPool, WINDOW_WIDTH, WINDOW_HEIGHT);
+	tracer.mode = mode;
+	tracer.shadingModel = shadingModel;
+	tracer.setScene(draws, spotlights, ambientLight);
+	tracer.setCamera(glm::lookAt(CAMERA_POSITION, CAMERA_TARGET, CAMERA_UP), glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 1000.0f));
+	size_t triangles = 0;
+	for (const SoftwareDraw& draw : draws) {
+		triangles += draw.mesh->vertices.size() / 3;
+	}
+	std::cout << "BVH: " << tracer.buildMs << " ms for " << triangles << " triangles" << std::endl;
+
+	if (mode == TraceMode::Direct) {
+		samples = 1;
+	}
+	double totalMs = 0.0;
+	long long totalRays = 0;
+	std::vector<double> frameTimes;
+	for (int sample = 0; sample < samples; sample++) {
+		tracer.render();
+		frameTimes.push_back(tracer.lastMs);
+		totalMs += tracer.lastMs;
+		totalRays += tracer.raysTraced;
+		if (mode == TraceMode::Path && (sample + 1) % 16 == 0) {
+			std::cout << "  " << sample + 1 << " samples, " << tracer.lastMraysPerSecond() << " Mrays/s" << std::endl;
+		}
+	}
+	std::cout << "Ray traced (" << (mode == TraceMode::Path ? "path" : "direct") << "): " << samples << " samples per pixel at "
+		<< WINDOW_WIDTH << "x" << WINDOW_HEIGHT << " on " << threadPool.size() << " threads in " << totalMs << " ms, "
+		<< totalRays / (totalMs * 1000.0) << " Mrays/s" << std::endl;
+	writePpm(capturePath.empty() ? screenshot_name("Raytrace-ss") : capturePath, tracer.pixels.data(), WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (!frameTimesPath.empty()) {
+		writeFrameTimes(frameTimesPath, frameTimes);
+	}
+	for (std::unique_ptr<Mesh>& mesh : meshes) {
+		mesh->deleteBuffers();
+	}
 	return 0;
 }
 
-void dump_framebuffer_to_ppm(std::string prefix, unsigned int width, unsigned int height) {
-	int pixelChannel = 3;
-	int totalPixelSize = pixelChannel * width * height * sizeof(GLubyte);
+/* Numbered screenshot file name; every call takes the next number */
+std::string screenshot_name(std::string prefix) {
+	return prefix + std::to_string(screenshotId++) + ".ppm";
+}
+
+void dump_framebuffer_to_ppm(std::string fileName, unsigned int width, unsigned int height) {
+	int totalPixelSize = 3 * width * height * sizeof(GLubyte);
 	GLubyte* pixels = new GLubyte[totalPixelSize];
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-	std::string fileName = prefix + std::to_string(screenshotId) + ".ppm";
-	std::ofstream fout(fileName);
-	fout << "P3\n" << width << " " << height << "\n" << 255 << std::endl;
-	for (size_t i = 0; i < height; i++)
-	{
-		for (size_t j = 0; j < width; j++)
-		{
-			size_t cur = pixelChannel * ((height - i - 1) * width + j);
-			fout << (int)pixels[cur] << " " << (int)pixels[cur + 1] << " " << (int)pixels[cur + 2] << " ";
-		}
-		fout << std::endl;
-	}
-	screenshotId++;
+	writePpm(fileName, pixels, width, height);
 	delete[] pixels;
-	fout.flush();
-	fout.close();
 }
 
-void processInput(GLFWwindow* window) {
+void processInput(GLFWwindow* window, Simulation& simulation) {
 	// Press escape to exit
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
 
+	// Press space to pause the lights; GLFW input is only read here, the simulation thread sees the flag
+	static bool spaceWasDown = false;
+	bool spaceDown = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+	if (spaceDown && !spaceWasDown) {
+		simulation.paused = !simulation.paused;
+	}
+	spaceWasDown = spaceDown;
+
 	// Press p to capture screen
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
 	{
 		std::cout << "Capture Window " << screenshotId << std::endl;
 		int buffer_width, buffer_height;
 		glfwGetFramebufferSize(window, &buffer_width, &buffer_height);
-		dump_framebuffer_to_ppm("Assignment1-ss", buffer_width, buffer_height);
+		dump_framebuffer_to_ppm(screenshot_name("Assignment1-ss"), buffer_width, buffer_height);
 		std::cout << "Finish capturing Window " << screenshotId - 1 << std::endl;
 	}
 }
@@ -0,0 +1,19 @@
+#include "SpotLight.h"
+
+static_assert(sizeof(SpotLightStd140) == 96, "SpotLightStd140 must match the std140 struct stride");
+static_assert(sizeof(SpotLightBlock) == 96 * MAX_SPOTLIGHTS + 16, "SpotLightBlock must match the std140 block size");
+
+void writeSpotLightBlock(SpotLightBlock* block, const std::vector<SpotLight>& lights) {
+	int count = (int)std::min(lights.size(), (size_t)MAX_SPOTLIGHTS);
+	for (int i = 0; i < count; i++) {
+		SpotLightStd140& out = block->spotlights[i];
+		out.ambient = lights[i].ambient;
+		out.diffuse = lights[i].diffuse;
+		out.attenuation = lights[i].attenuation;
+		out.position = lights[i].position;
+		out.direction = lights[i].direction;
+		out.cutoffAngle = lights[i].cutoffAngle;
+		out.range = lights[i].range;
+	}
+	block->numSpotlights = count;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+// Upper bound on spotlights the shaders can hold, injected as MAX_SPOTLIGHTS into every program that reads the block
+const int MAX_SPOTLIGHTS = 16;
+
+// Uniform buffer binding point of the SpotLights block shared by the lighting and volumetric shaders
+const unsigned int SPOTLIGHT_BLOCK_BINDING = 0;
+
+struct SpotLight {
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 attenuation;
+	glm::vec3 position;
+	glm::vec3 direction;
+	float cutoffAngle;    // The cosine value of cutoff angle
+	float range;          // Distance beyond which the attenuated light is negligible (see spotLightRange)
+};
+
+/* Distance at which the brightest diffuse channel attenuates below threshold, solving
+   max(diffuse) / (c + l*d + q*d^2) = threshold for d */
+inline float spotLightRange(const SpotLight& light, float threshold) {
+	float intensity = std::max(light.diffuse.x, std::max(light.diffuse.y, light.diffuse.z));
+	float c = light.attenuation.x - intensity / threshold;
+	float l = light.attenuation.y;
+	float q = light.attenuation.z;
+	if (c >= 0.0f) {
+		return 0.0f;
+	}
+	if (q > 0.0f) {
+		return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+	}
+	if (l > 0.0f) {
+		return -c / l;
+	}
+	return INFINITY;
+}
+
+// std140 layout of one SpotLight inside the SpotLights uniform block: vec3s take 16 bytes,
+// except that a float may fill the last 4 bytes of the vec3 before it
+struct SpotLightStd140 {
+	glm::vec3 ambient;
+	float pad0;
+	glm::vec3 diffuse;
+	float pad1;
+	glm::vec3 attenuation;
+	float pad2;
+	glm::vec3 position;
+	float pad3;
+	glm::vec3 direction;
+	float cutoffAngle;
+	float range;
+	float pad4[3];
+};
+
+struct SpotLightBlock {
+	SpotLightStd140 spotlights[MAX_SPOTLIGHTS];
+	int numSpotlights;
+	int pad[3];
+};
+
+/* Fill a SpotLights block; block may point into write-only mapped memory */
+void writeSpotLightBlock(SpotLightBlock* block, const std::vector<SpotLight>& lights);
@@ -0,0 +1,118 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+
+#include <iostream>
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize)
+	: buffer(0), target(target), regionSize(regionSize), persistent(false), usedBytes(0), stalls(0),
+	mapped(nullptr), mappedFrom(0), minAlignment(16), region(STREAM_BUFFER_FRAMES - 1) {
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; i++) {
+		fences[i] = 0;
+	}
+	if (target == GL_UNIFORM_BUFFER) {
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		minAlignment = alignment > 0 ? alignment : 256;
+	}
+
+	// Mapping goes through the copy binding so an element buffer bound to the current VAO is left alone
+	GLsizeiptr totalSize = regionSize * STREAM_BUFFER_FRAMES;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (glExt.bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glExt.BufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+		persistent = mapped != nullptr;
+	}
+	if (!persistent) {
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::beginFrame() {
+	region = (region + 1) % STREAM_BUFFER_FRAMES;
+	usedBytes = 0;
+	GLsync fence = fences[region];
+	if (fence != 0) {
+		// Normally signaled long ago; only a GPU more than STREAM_BUFFER_FRAMES behind makes us wait
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			stalls++;
+			do {
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fences[region] = 0;
+	}
+}
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+	StreamAllocation allocation = { nullptr, 0, size };
+	if (alignment < minAlignment) {
+		alignment = minAlignment;
+	}
+	GLsizeiptr start = (usedBytes + alignment - 1) / alignment * alignment;
+	if (start + size > regionSize) {
+		std::cout << "ERROR::STREAM_BUFFER::REGION_FULL: " << size << " bytes requested, " << regionSize - usedBytes << " left" << std::endl;
+		return allocation;
+	}
+	GLintptr regionStart = (GLintptr)region * regionSize;
+
+	if (!persistent && mapped == nullptr) {
+		// Only the not yet used tail is mapped, so earlier allocations of this frame stay valid for GL
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, regionStart + start, regionSize - start,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mappedFrom = start;
+		if (mapped == nullptr) {
+			std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+			return allocation;
+		}
+	}
+
+	allocation.data = persistent ? mapped + regionStart + start : mapped + (start - mappedFrom);
+	allocation.offset = regionStart + start;
+	usedBytes = start + size;
+	return allocation;
+}
+
+void StreamBuffer::commit() {
+	if (!persistent && mapped != nullptr) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mapped = nullptr;
+	}
+}
+
+void StreamBuffer::endFrame() {
+	commit();
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::bindRange(unsigned int index, const StreamAllocation& allocation) const {
+	glBindBufferRange(target, index, buffer, allocation.offset, allocation.size);
+}
+
+void StreamBuffer::deleteBuffers() {
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; i++) {
+		if (fences[i] != 0) {
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+	if (persistent) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	else {
+		commit();
+	}
+	mapped = nullptr;
+	glDeleteBuffers(1, &buffer);
+}
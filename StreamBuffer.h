@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Frames the CPU may run ahead of the GPU; each owns one region of a StreamBuffer
+const int STREAM_BUFFER_FRAMES = 3;
+
+// Space handed out by StreamBuffer::allocate; data is null when the frame's region is full
+struct StreamAllocation {
+	void* data;                            /* write-only CPU pointer */
+	GLintptr offset;                       /* offset in the GL buffer, for glBindBufferRange or attribute pointers */
+	GLsizeiptr size;
+};
+
+// Ring buffer for data rewritten every frame (uniform blocks, vertices, instances). One buffer is split
+// into a region per frame in flight; allocations bump a pointer through the current region, and a fence
+// keeps the CPU from overwriting a region the GPU may still read.
+//
+// With GL_ARB_buffer_storage the buffer is mapped once, persistently and coherently. On plain GL 3.3 the
+// unused rest of the region is mapped unsynchronized on the first allocation and unmapped by commit(),
+// since a mapped buffer cannot be drawn from; the fences make skipping the driver's synchronization safe.
+class StreamBuffer {
+public:
+	unsigned int buffer;
+	GLenum target;
+	GLsizeiptr regionSize;                 /* bytes available per frame */
+	bool persistent;                       /* mapped once through buffer storage */
+	GLsizeiptr usedBytes;                  /* allocated in the current frame */
+	unsigned int stalls;                   /* frames that had to wait for the GPU to release their region */
+
+	StreamBuffer(GLenum target, GLsizeiptr regionSize);
+	/* move to the next region, waiting for the GPU only if it is still reading it */
+	void beginFrame();
+	/* reserve size bytes aligned to alignment (0 = the target's required alignment) */
+	StreamAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 0);
+	/* make written data visible to GL; call after writing and before drawing from it */
+	void commit();
+	/* fence the region; call once all draws using this frame's data are submitted */
+	void endFrame();
+	void bindRange(unsigned int index, const StreamAllocation& allocation) const;
+	void deleteBuffers();
+private:
+	unsigned char* mapped;                 /* persistent: whole buffer; fallback: region start while mapped */
+	GLsizeiptr mappedFrom;                 /* fallback: region offset where the current mapping starts */
+	GLsizeiptr minAlignment;
+	GLsync fences[STREAM_BUFFER_FRAMES];
+	int region;
+};
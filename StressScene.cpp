@@ -0,0 +1,228 @@
+#include "StressScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "SceneFile.h"
+#include "SpotLight.h"
+
+StressSceneSettings::StressSceneSettings() {
+	meshes = 8;
+	instances = 100;
+	textures = 4;
+	textureSize = 512;
+	trianglesPerMesh = 5000;
+	spotlights = 8;
+	seed = 1;
+}
+
+// xorshift32; the scene must not depend on how a standard library implements its distributions
+static float randomFloat(unsigned int& state, float low, float high) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return low + (high - low) * (float)(state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Radius of a blob in the direction (theta from the top, phi around): a sphere with a few seamless ripples
+struct BlobShape {
+	float radius;
+	float amplitude[3], phiFrequency[3], thetaFrequency[3], phase[3];
+
+	glm::vec3 point(float theta, float phi) const {
+		float r = 1.0f;
+		for (int k = 0; k < 3; k++) {
+			r += amplitude[k] * std::sin(phiFrequency[k] * phi + phase[k]) * std::sin(thetaFrequency[k] * theta);
+		}
+		r *= radius;
+		return glm::vec3(r * std::sin(theta) * std::cos(phi), r * std::cos(theta), r * std::sin(theta) * std::sin(phi));
+	}
+};
+
+/* rings x segments grid over the blob with pole fans; triangles wind counter-clockwise seen from outside */
+static bool writeBlobObj(const std::string& path, const BlobShape& shape, int triangles) {
+	std::ofstream fout(path);
+	if (!fout) {
+		return false;
+	}
+	// 2 * segments * (rings - 1) triangles, with about twice as many segments as rings
+	int segments = std::max(3, (int)std::lround(std::sqrt((float)triangles)));
+	int rings = std::max(2, (int)std::lround((float)triangles / (2.0f * segments)) + 1);
+	const float pi = 3.14159265f;
+	const float epsilon = 1e-3f;
+	for (int r = 0; r <= rings; r++) {
+		float theta = pi * r / rings;
+		for (int s = 0; s <= segments; s++) {
+			float phi = 2.0f * pi * s / segments;
+			glm::vec3 p = shape.point(theta, phi);
+			glm::vec3 normal;
+			if (r == 0 || r == rings) {
+				normal = glm::vec3(0.0f, r == 0 ? 1.0f : -1.0f, 0.0f);
+			}
+			else {
+				glm::vec3 alongPhi = shape.point(theta, phi + epsilon) - shape.point(theta, phi - epsilon);
+				glm::vec3 alongTheta = shape.point(theta + epsilon, phi) - shape.point(theta - epsilon, phi);
+				normal = glm::normalize(glm::cross(alongPhi, alongTheta));
+			}
+			fout << "v " << p.x << " " << p.y << " " << p.z << "\n";
+			fout << "vt " << (float)s / segments << " " << 1.0f - (float)r / rings << "\n";
+			fout << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+		}
+	}
+	// v, vt and vn share indices
+	auto corner = [&fout, segments](int r, int s) {
+		int index = r * (segments + 1) + s + 1;
+		fout << " " << index << "/" << index << "/" << index;
+	};
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			if (r > 0) {
+				fout << "f";
+				corner(r, s);
+				corner(r, s + 1);
+				corner(r + 1, s);
+				fout << "\n";
+			}
+			if (r < rings - 1) {
+				fout << "f";
+				corner(r, s + 1);
+				corner(r + 1, s + 1);
+				corner(r + 1, s);
+				fout << "\n";
+			}
+		}
+	}
+	return (bool)fout;
+}
+
+/* Square facing up, its texture repeated every 50 units */
+static bool writeGroundObj(const std::string& path, float halfSize) {
+	std::ofstream fout(path);
+	if (!fout) {
+		return false;
+	}
+	float repeats = halfSize / 25.0f;
+	fout << "v " << -halfSize << " 0 " << -halfSize << "\nv " << -halfSize << " 0 " << halfSize << "\nv " << halfSize << " 0 " << halfSize
+		<< "\nv " << halfSize << " 0 " << -halfSize << "\n";
+	fout << "vt 0 0\nvt 0 " << repeats << "\nvt " << repeats << " " << repeats << "\nvt " << repeats << " 0\n";
+	fout << "vn 0 1 0\n";
+	fout << "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 4/4/1\n";
+	return (bool)fout;
+}
+
+/* Checkers of two tints of a random hue with noise on top, as a binary PPM (stb_image reads those) */
+static bool writeTexture(const std::string& path, int size, unsigned int& random) {
+	std::ofstream fout(path, std::ios::binary);
+	if (!fout) {
+		return false;
+	}
+	float hue = randomFloat(random, 0.0f, 6.0f);
+	glm::vec3 color = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f), 2.0f - std::abs(hue - 4.0f)), 0.0f, 1.0f);
+	int checker = std::max(1, size / (int)randomFloat(random, 4.0f, 16.0f));
+	fout << "P6\n" << size << " " << size << "\n255\n";
+	std::vector<unsigned char> row(size * 3);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			float shade = ((x / checker + y / checker) & 1) ? 0.9f : 0.5f;
+			shade += randomFloat(random, -0.08f, 0.08f);
+			glm::vec3 texel = glm::clamp(glm::mix(glm::vec3(1.0f), color, 0.6f) * shade, 0.0f, 1.0f) * 255.0f;
+			row[3 * x] = (unsigned char)texel.x;
+			row[3 * x + 1] = (unsigned char)texel.y;
+			row[3 * x + 2] = (unsigned char)texel.z;
+		}
+		fout.write((const char*)row.data(), row.size());
+	}
+	return (bool)fout;
+}
+
+std::string generateStressScene(const StressSceneSettings& settings, const std::string& directory) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	// xorshift never leaves 0, and neighbouring seeds need a few draws to drift apart
+	unsigned int random = settings.seed * 2654435761u + 0x9E3779B9u;
+	random = random == 0 ? 1 : random;
+	for (int i = 0; i < 8; i++) {
+		randomFloat(random, 0.0f, 1.0f);
+	}
+	SceneFile scene;
+
+	std::vector<std::string> textureNames;
+	for (int i = 0; i < settings.textures; i++) {
+		std::string name = "texture" + std::to_string(i) + ".ppm";
+		if (!writeTexture(directory + "/" + name, std::max(settings.textureSize, 1), random)) {
+			std::cout << "ERROR::STRESS_SCENE::CANNOT_WRITE: " << directory << "/" << name << std::endl;
+			return "";
+		}
+		textureNames.push_back(name);
+	}
+
+	std::vector<float> meshRadii;
+	for (int i = 0; i < settings.meshes; i++) {
+		BlobShape shape;
+		shape.radius = randomFloat(random, 6.0f, 16.0f);
+		for (int k = 0; k < 3; k++) {
+			shape.amplitude[k] = randomFloat(random, 0.02f, 0.12f);
+			shape.phiFrequency[k] = std::floor(randomFloat(random, 1.0f, 9.0f));
+			shape.thetaFrequency[k] = std::floor(randomFloat(random, 1.0f, 9.0f));
+			shape.phase[k] = randomFloat(random, 0.0f, 6.2831853f);
+		}
+		std::string name = "mesh" + std::to_string(i) + ".obj";
+		if (!writeBlobObj(directory + "/" + name, shape, std::max(settings.trianglesPerMesh, 8))) {
+			std::cout << "ERROR::STRESS_SCENE::CANNOT_WRITE: " << directory << "/" << name << std::endl;
+			return "";
+		}
+		scene.objectPaths.push_back(name);
+		scene.texturePaths.push_back(textureNames.empty() ? "" : textureNames[i % textureNames.size()]);
+		meshRadii.push_back(shape.radius);
+	}
+
+	// Instances fill a disc that grows with their number, so the density stays about the same
+	float discRadius = 40.0f + 12.0f * std::sqrt((float)std::max(settings.instances, 1));
+	if (!writeGroundObj(directory + "/ground.obj", discRadius + 50.0f)) {
+		std::cout << "ERROR::STRESS_SCENE::CANNOT_WRITE: " << directory << "/ground.obj" << std::endl;
+		return "";
+	}
+	int ground = (int)scene.objectPaths.size();
+	scene.objectPaths.push_back("ground.obj");
+	scene.texturePaths.push_back(textureNames.empty() ? "" : textureNames[0]);
+	scene.instances.push_back({ ground, glm::vec3(0.0f), 0.0f, 1.0f });
+	for (int i = 0; settings.meshes > 0 && i < settings.instances; i++) {
+		SceneInstance instance;
+		instance.mesh = i % settings.meshes;
+		// uniform over the disc
+		float distance = discRadius * std::sqrt(randomFloat(random, 0.0f, 1.0f));
+		float angle = randomFloat(random, 0.0f, 6.2831853f);
+		instance.scale = randomFloat(random, 0.6f, 1.6f);
+		instance.yawDegrees = randomFloat(random, 0.0f, 360.0f);
+		instance.position = glm::vec3(distance * std::cos(angle), meshRadii[instance.mesh] * instance.scale, distance * std::sin(angle));
+		scene.instances.push_back(instance);
+	}
+
+	// Spots hang on a ring over the disc, each aimed at a random point of it
+	int spotlightCount = glm::clamp(settings.spotlights, 1, MAX_SPOTLIGHTS);
+	for (int i = 0; i < spotlightCount; i++) {
+		SpotLight light;
+		float angle = 6.2831853f * i / spotlightCount;
+		light.position = glm::vec3(0.5f * discRadius * std::cos(angle), 200.0f, 0.5f * discRadius * std::sin(angle));
+		float distance = discRadius * std::sqrt(randomFloat(random, 0.0f, 1.0f));
+		float targetAngle = randomFloat(random, 0.0f, 6.2831853f);
+		light.direction = glm::vec3(distance * std::cos(targetAngle), 0.0f, distance * std::sin(targetAngle)) - light.position;
+		float hue = randomFloat(random, 0.0f, 6.0f);
+		light.diffuse = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f, 2.0f - std::abs(hue - 2.0f), 2.0f - std::abs(hue - 4.0f)), 0.0f, 1.0f);
+		light.cutoffAngle = glm::cos(glm::radians(randomFloat(random, 15.0f, 30.0f)));
+		// the scene's ambient light rides on the first spot, as much as the built-in scene has
+		light.ambient = glm::vec3(i == 0 ? 0.6f : 0.0f);
+		scene.spotlights.push_back(light);
+	}
+
+	std::string scenePath = directory + "/scene.txt";
+	if (!scene.save(scenePath)) {
+		return "";
+	}
+	return scenePath;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Size of a generated stress scene along each axis that costs frame time. The same settings and seed always
+// produce the same files, so runs on different machines and versions draw identical scenes.
+struct StressSceneSettings {
+	int meshes;              /* distinct OBJ files, displaced spheres of trianglesPerMesh triangles each */
+	int instances;           /* placements of the meshes, spread over the ground in turn */
+	int textures;            /* distinct images shared round robin by the meshes; 0 leaves them untextured */
+	int textureSize;         /* side of the square images */
+	int trianglesPerMesh;
+	int spotlights;          /* up to MAX_SPOTLIGHTS */
+	unsigned int seed;
+
+	StressSceneSettings();
+};
+
+// Write the meshes, textures and scene.txt (see SceneFile) of a stress scene into directory, which is created if
+// needed. A ground plane is added as one more mesh under the instances. Returns the path of scene.txt, or an empty
+// string when a file could not be written.
+std::string generateStressScene(const StressSceneSettings& settings, const std::string& directory);
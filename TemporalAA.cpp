@@ -0,0 +1,105 @@
+#include "TemporalAA.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Radical inverse of index in the given base, the 1D Halton sequence in [0, 1)
+static float halton(unsigned int index, unsigned int base) {
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0) {
+		result += fraction * (index % base);
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
+
+TemporalAA::TemporalAA(ShaderManager& shaders, int width, int height)
+	: shaders(shaders),
+	resolveShader(shaders.add("fullscreen_vertex_shader.glsl", "temporal_aa_fragment_shader.glsl")),
+	history{ RenderTarget(width, height, GL_RGBA16F, false), RenderTarget(width, height, GL_RGBA16F, false) } {
+	enabled = false;
+	renderScale = 1.0f;
+	blend = 0.1f;
+	clipGamma = 1.25f;
+	jitter = glm::vec2(0.0f);
+	current = 0;
+	historyValid = false;
+	frameIndex = 0;
+}
+
+int TemporalAA::sceneWidth(int outputWidth) const {
+	return enabled ? std::max(1, (int)(outputWidth * renderScale + 0.5f)) : outputWidth;
+}
+
+int TemporalAA::sceneHeight(int outputHeight) const {
+	return enabled ? std::max(1, (int)(outputHeight * renderScale + 0.5f)) : outputHeight;
+}
+
+/* Upscaling needs more distinct offsets to cover every output pixel of a scene pixel */
+int TemporalAA::jitterPhases() const {
+	return std::max(8, (int)std::ceil(8.0f / (renderScale * renderScale)));
+}
+
+glm::mat4 TemporalAA::jitterProjection(const glm::mat4& projection, int sceneWidth, int sceneHeight) {
+	if (!enabled) {
+		jitter = glm::vec2(0.0f);
+		return projection;
+	}
+	// index 0 of the sequence is the corner, start at 1
+	unsigned int index = frameIndex % jitterPhases() + 1;
+	jitter = glm::vec2(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+	frameIndex++;
+
+	// shift the image by jitter pixels; the third column is scaled by z and divided by w = -z
+	glm::mat4 jittered = projection;
+	jittered[2][0] -= 2.0f * jitter.x / sceneWidth;
+	jittered[2][1] -= 2.0f * jitter.y / sceneHeight;
+	return jittered;
+}
+
+const RenderTarget& TemporalAA::resolve(const RenderTarget& color, const RenderTarget& scene, int outputWidth, int outputHeight,
+	const glm::mat4& viewProjection, const glm::mat4& previousViewProjection) {
+	if (history[0].width != outputWidth || history[0].height != outputHeight) {
+		historyValid = false;
+	}
+	history[0].resize(outputWidth, outputHeight);
+	history[1].resize(outputWidth, outputHeight);
+
+	timer.begin();
+	int previous = current;
+	current = 1 - current;
+	history[current].bind();
+	glState.setEnabled(GL_DEPTH_TEST, false);
+
+	Shader& program = shaders.get(resolveShader);
+	program.use();
+	glState.bindTexture(0, color.colorTexture);
+	glState.bindTexture(1, scene.depthTexture);
+	glState.bindTexture(2, scene.velocityTexture);
+	glState.bindTexture(3, history[previous].colorTexture);
+	program.setInt("sceneColor", 0);
+	program.setInt("sceneDepth", 1);
+	program.setInt("velocity", 2);
+	program.setInt("history", 3);
+	program.setBool("historyValid", historyValid);
+	program.setVec2("jitter", jitter);
+	program.setMat4("reprojection", previousViewProjection * glm::inverse(viewProjection));
+	program.setFloat("blend", blend);
+	program.setFloat("clipGamma", clipGamma);
+	quad.draw();
+
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	timer.end();
+	historyValid = true;
+	return history[current];
+}
+
+void TemporalAA::deleteBuffers() {
+	history[0].deleteBuffers();
+	history[1].deleteBuffers();
+	quad.deleteBuffers();
+	timer.deleteQueries();
+}
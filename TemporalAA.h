@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "ShaderManager.h"
+#include "RenderTarget.h"
+#include "FullscreenPass.h"
+#include "GpuTimer.h"
+
+// Temporal anti-aliasing and upscaling. The scene renders with a different sub-pixel offset every frame
+// (a Halton sequence on the projection); each output pixel blends the new sample with its history,
+// reprojected through the velocity buffer and clipped to the new sample's neighbourhood so stale
+// lighting and disocclusions do not ghost. With renderScale below 1 the scene renders smaller and the
+// jitter walks the low resolution samples over the output pixels, rebuilding full resolution over time.
+class TemporalAA {
+public:
+	bool enabled;
+	float renderScale;         /* scene resolution per axis relative to the output, 0.5 to 1 */
+	float blend;               /* weight of a new sample that lands on the output pixel */
+	float clipGamma;           /* neighbourhood box size in standard deviations */
+	glm::vec2 jitter;          /* offset of the current frame in scene pixels */
+	GpuTimer timer;
+
+	TemporalAA(ShaderManager& shaders, int width, int height);
+	// scene size for an output size, applying renderScale
+	int sceneWidth(int outputWidth) const;
+	int sceneHeight(int outputHeight) const;
+	// advance the jitter and offset projection by it for a sceneWidth x sceneHeight render
+	glm::mat4 jitterProjection(const glm::mat4& projection, int sceneWidth, int sceneHeight);
+	// accumulate color into the history at the output size; depth and velocity come from scene
+	const RenderTarget& resolve(const RenderTarget& color, const RenderTarget& scene, int outputWidth, int outputHeight,
+		const glm::mat4& viewProjection, const glm::mat4& previousViewProjection);
+	void deleteBuffers();
+private:
+	ShaderManager& shaders;
+	ShaderHandle resolveShader;
+	RenderTarget history[2];
+	FullscreenPass quad;
+	int current;
+	bool historyValid;
+	unsigned int frameIndex;
+	int jitterPhases() const;
+};
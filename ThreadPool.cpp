@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : task(nullptr), taskCount(0), taskBatch(1), next(0), busy(0), generation(0), stopping(false) {
+	if (threadCount == 0) {
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 0;
+	}
+	for (unsigned int i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::size() const {
+	return (unsigned int)workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(int count, int minBatch, const std::function<void(int, int)>& job) {
+	if (count <= 0) {
+		return;
+	}
+	// a few batches per thread keeps the load balanced without much contention on the counter
+	int batch = std::max(std::max(minBatch, 1), (int)((count + size() * 4 - 1) / (size() * 4)));
+	if (workers.empty() || count <= batch) {
+		job(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(submitMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &job;
+		taskCount = count;
+		taskBatch = batch;
+		next = 0;
+		busy = (unsigned int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	runBatches();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy == 0; });
+	task = nullptr;
+}
+
+void ThreadPool::runBatches() {
+	for (;;) {
+		int begin = next.fetch_add(taskBatch);
+		if (begin >= taskCount) {
+			return;
+		}
+		(*task)(begin, std::min(begin + taskBatch, taskCount));
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned long long seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		runBatches();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0) {
+				done.notify_one();
+			}
+		}
+	}
+}
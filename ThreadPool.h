@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Persistent worker threads for data-parallel loops; the calling thread takes part in the work
+class ThreadPool {
+public:
+	// threadCount = 0 uses one worker per hardware thread besides the caller
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	// total threads that execute a parallelFor, including the caller
+	unsigned int size() const;
+
+	// Run job(begin, end) over [0, count) in batches of at least minBatch items and wait for completion
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& job);
+private:
+	std::vector<std::thread> workers;
+	std::mutex submitMutex;                 /* one parallelFor at a time */
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)>* task;
+	int taskCount, taskBatch;
+	std::atomic<int> next;
+	unsigned int busy;                      /* workers still running the current task */
+	unsigned long long generation;          /* bumped for every task so workers notice new work */
+	bool stopping;
+	void workerLoop();
+	void runBatches();
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free hand-over of whole values from one producer thread to one consumer thread. The producer
+// fills writeBuffer() and publishes it; the consumer picks up the newest published value with consume().
+// Neither side ever waits: the third slot keeps the latest publication ready while both are busy.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : middle(1), writeIndex(0), readIndex(2) {
+	}
+
+	// producer side
+	T& writeBuffer() {
+		return slots[writeIndex];
+	}
+	void publish() {
+		writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// consumer side: true when a newer value replaced readBuffer()
+	bool consume() {
+		if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+			return false;
+		}
+		readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	const T& readBuffer() const {
+		return slots[readIndex];
+	}
+private:
+	static const int FRESH = 4;            /* set on the middle index by publish(), cleared by consume() */
+	static const int INDEX_MASK = 3;
+	T slots[3];
+	std::atomic<int> middle;
+	int writeIndex;
+	int readIndex;
+};
@@ -0,0 +1,126 @@
+#include "VolumetricPass.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <string>
+
+VolumetricPass::VolumetricPass(ShaderManager& shaders, int width, int height)
+	: shaders(shaders),
+	marchShader(shaders.add("fullscreen_vertex_shader.glsl", "volumetric_fragment_shader.glsl",
+		"#define MAX_SPOTLIGHTS " + std::to_string(MAX_SPOTLIGHTS) + "\n")),
+	upsampleShader(shaders.add("fullscreen_vertex_shader.glsl", "volumetric_upsample_fragment_shader.glsl")),
+	history{ RenderTarget((width + 1) / 2, (height + 1) / 2, GL_RGBA16F, false),
+		RenderTarget((width + 1) / 2, (height + 1) / 2, GL_RGBA16F, false) } {
+	enabled = true;
+	resolutionDivisor = 2;
+	maxSteps = 32;
+	minSteps = 4;
+	stepCount = 16;
+	budgetMs = 2.0f;
+	density = 0.008f;
+	anisotropy = 0.3f;
+	temporalBlend = 0.5f;
+	depthSensitivity = 20.0f;
+	current = 0;
+	frameIndex = 0;
+	fullWidth = width;
+	fullHeight = height;
+	currentDivisor = 2;
+	historyValid = false;
+	lastViewProjection = glm::mat4(0.0f);
+}
+
+int VolumetricPass::lowWidth() const {
+	return std::max(1, (fullWidth + resolutionDivisor - 1) / resolutionDivisor);
+}
+
+int VolumetricPass::lowHeight() const {
+	return std::max(1, (fullHeight + resolutionDivisor - 1) / resolutionDivisor);
+}
+
+void VolumetricPass::resize(int width, int height) {
+	fullWidth = width;
+	fullHeight = height;
+}
+
+/* March the beams into the low resolution target, blending with the previous frame */
+void VolumetricPass::render(const RenderTarget& scene, const glm::mat4& view, const glm::mat4& projection, ShadowAtlas& shadows) {
+	if (!enabled) {
+		return;
+	}
+
+	// Trade samples for time: back off quickly when over budget, recover slowly
+	if (timer.lastMs > budgetMs) {
+		stepCount = std::max(minSteps, stepCount * 4 / 5);
+	}
+	else if (timer.lastMs < 0.7f * budgetMs) {
+		stepCount = std::min(maxSteps, stepCount + 1);
+	}
+	timer.begin();
+
+	// History is only reusable while the camera and resolution stay the same
+	glm::mat4 viewProjection = projection * view;
+	if (viewProjection != lastViewProjection || currentDivisor != resolutionDivisor
+		|| history[0].width != lowWidth() || history[0].height != lowHeight()) {
+		historyValid = false;
+	}
+	lastViewProjection = viewProjection;
+	currentDivisor = resolutionDivisor;
+	inverseViewProjection = glm::inverse(viewProjection);
+	cameraPos = glm::vec3(glm::inverse(view)[3]);
+	history[0].resize(lowWidth(), lowHeight());
+	history[1].resize(lowWidth(), lowHeight());
+
+	int previous = current;
+	current = 1 - current;
+	history[current].bind();
+	glState.setEnabled(GL_DEPTH_TEST, false);
+
+	Shader& march = shaders.get(marchShader);
+	march.use();
+	march.setUniformBlock("SpotLights", SPOTLIGHT_BLOCK_BINDING);
+	shadows.bind(march, 1);
+	glState.bindTexture(0, scene.depthTexture);
+	glState.bindTexture(2, history[previous].colorTexture);
+	march.setInt("sceneDepth", 0);
+	march.setInt("history", 2);
+	march.setBool("historyValid", historyValid);
+	march.setFloat("temporalBlend", temporalBlend);
+	march.setMat4("inverseViewProjection", inverseViewProjection);
+	march.setVec3("cameraPos", cameraPos);
+	march.setInt("stepCount", stepCount);
+	march.setInt("frameIndex", frameIndex);
+	march.setFloat("density", density);
+	march.setFloat("anisotropy", anisotropy);
+	quad.draw();
+
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	historyValid = true;
+	frameIndex++;
+}
+
+void VolumetricPass::composite(const RenderTarget& scene) {
+	glState.setEnabled(GL_DEPTH_TEST, false);
+	Shader& upsample = shaders.get(upsampleShader);
+	upsample.use();
+	glState.bindTexture(0, scene.colorTexture);
+	glState.bindTexture(1, scene.depthTexture);
+	glState.bindTexture(2, history[current].colorTexture);
+	upsample.setInt("sceneColor", 0);
+	upsample.setInt("sceneDepth", 1);
+	upsample.setInt("volumetric", 2);
+	upsample.setMat4("inverseViewProjection", inverseViewProjection);
+	upsample.setVec3("cameraPos", cameraPos);
+	upsample.setFloat("depthSensitivity", depthSensitivity);
+	quad.draw();
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	// the timer started in render() covers march and upsample
+	timer.end();
+}
+
+void VolumetricPass::deleteBuffers() {
+	history[0].deleteBuffers();
+	history[1].deleteBuffers();
+	quad.deleteBuffers();
+	timer.deleteQueries();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "SpotLight.h"
+#include "ShadowAtlas.h"
+#include "RenderTarget.h"
+#include "FullscreenPass.h"
+#include "GpuTimer.h"
+
+// Light shafts in haze: ray-marches every spotlight cone at reduced resolution, then upsamples
+// bilaterally against the full resolution depth while compositing over the scene
+class VolumetricPass {
+public:
+	bool enabled;
+	int resolutionDivisor;     /* 2 = half, 4 = quarter resolution */
+	int maxSteps;              /* samples per beam when the budget allows */
+	int minSteps;
+	int stepCount;             /* samples per beam used this frame, adapted to budgetMs */
+	float budgetMs;            /* GPU time the march and upsample aim to stay under */
+	float density;             /* haze scattering coefficient */
+	float anisotropy;          /* Henyey-Greenstein g */
+	float temporalBlend;       /* weight of the previous frame, hides the per-frame jitter */
+	float depthSensitivity;    /* bilateral upsample edge stopping */
+	GpuTimer timer;
+
+	VolumetricPass(ShaderManager& shaders, int width, int height);
+	void resize(int width, int height);
+	/* the lights come from the SpotLights block bound at SPOTLIGHT_BLOCK_BINDING */
+	void render(const RenderTarget& scene, const glm::mat4& view, const glm::mat4& projection, ShadowAtlas& shadows);
+	/* draw scene color plus beams into the bound framebuffer; call after render() */
+	void composite(const RenderTarget& scene);
+	void deleteBuffers();
+private:
+	ShaderManager& shaders;
+	ShaderHandle marchShader;
+	ShaderHandle upsampleShader;
+	RenderTarget history[2];               /* ping-pong low resolution results */
+	FullscreenPass quad;
+	int current;
+	int frameIndex;
+	int fullWidth, fullHeight;
+	int currentDivisor;
+	bool historyValid;
+	glm::mat4 lastViewProjection;
+	glm::mat4 inverseViewProjection;
+	glm::vec3 cameraPos;
+	int lowWidth() const;
+	int lowHeight() const;
+};
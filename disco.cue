@@ -0,0 +1,44 @@
+# Default light show: three colored spots sweeping the stage, the ring of extra spots chasing around it.
+# Load with --show disco.cue; the syntax is described in LightShow.h. Angles are in degrees,
+# and a later key at the same time replaces an earlier one.
+fixtures 16
+length 16
+
+# tilt everything close to the old fixed directions and use the old 30 and 22.5 degree cones
+key * tilt 0 18
+key * cone 0 30
+key 3-15 cone 0 22.5
+
+# the three main spots: red, green, blue, turning around the stage once every 4 seconds
+key 0 green 0 0
+key 0 blue 0 0
+key 0 pan 0 45
+key 0 pan 16 1485
+key 1 red 0 0
+key 1 blue 0 0
+key 1 pan 0 225
+key 1 pan 16 1665
+key 2 red 0 0
+key 2 green 0 0
+key 2 pan 0 90
+key 2 pan 16 1530
+
+# ring spots swing in and out and fade through the colors
+key 3-15 tilt 0 10
+key 3-15 tilt 4 35
+key 3-15 tilt 8 10
+key 3-15 tilt 12 35
+key 3-15 tilt 16 10
+key 3-15 red 0 1
+key 3-15 red 8 0
+key 3-15 red 16 1
+key 3-15 green 0 0
+key 3-15 green 8 1
+key 3-15 green 16 0
+key 3-15 blue 0 0.5
+key 3-15 blue 16 0.5
+
+# a strobe burst on every light for the last two seconds of the loop
+key * strobe 14 0
+key * strobe 14.01 8
+key * strobe 16 8
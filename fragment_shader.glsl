@@ -1,5 +1,24 @@
 #version 330 core
 
+// Variant switches, injected by ShaderVariantCache; the values below are the fallbacks
+#ifndef MAX_SPOTLIGHTS
+#define MAX_SPOTLIGHTS 16
+#endif
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT MAX_SPOTLIGHTS  // lights this draw loops over, a constant so the loop unrolls
+#endif
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+#define SHADING_LAMBERT 0
+#define SHADING_BLINN_PHONG 1
+#ifndef SHADING_MODEL
+#define SHADING_MODEL SHADING_LAMBERT
+#endif
+
 struct SpotLight {
 	vec3 ambient;
 	vec3 diffuse;
@@ -7,26 +26,99 @@ struct SpotLight {
 	vec3 position;
 	vec3 direction;
 	float cutoffAngle;    // The cosine value of cutoff angle
+	float range;          // Distance beyond which the light is negligible
 };
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
-out vec4 FragColor;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec2 Velocity;   // screen-space motion since last frame in texture coordinates
 
-uniform SpotLight spotlights[3];
+// Written once per frame into a stream buffer (SPOTLIGHT_BLOCK_BINDING, std140 to match SpotLightBlock)
+layout(std140) uniform SpotLights {
+	SpotLight spotlights[MAX_SPOTLIGHTS];
+	int numSpotlights;
+};
+#if TEXTURED
 uniform sampler2D ourTexture;
+#else
+uniform vec3 baseColor;
+#endif
+
+// Lights that survived CPU culling for this draw, and the summed ambient of all lights
+#if LIGHT_COUNT > 0
+uniform int lightIndices[LIGHT_COUNT];
+#endif
+uniform vec3 ambientLight;
+
+#if SHADING_MODEL == SHADING_BLINN_PHONG
+uniform vec3 viewPos;
+uniform float shininess;
+uniform float specularStrength;
+#endif
+
+#if SHADOWS
+// Shadow atlas: one tile per spotlight, zero-sized rect when a light has no map
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 lightMatrices[MAX_SPOTLIGHTS];
+uniform vec4 shadowRects[MAX_SPOTLIGHTS];
+uniform vec2 shadowTexelSize;
+uniform bool shadowsEnabled;
+
+// Fraction of light i reaching the fragment, 3x3 PCF on top of hardware bilinear comparison
+float shadowFactor(int i)
+{
+    if (!shadowsEnabled || shadowRects[i].z <= 0.0) {
+        return 1.0;
+    }
+    vec4 lightSpace = lightMatrices[i] * vec4(FragPos, 1.0);
+    if (lightSpace.w <= 0.0) {
+        return 1.0;
+    }
+    vec3 ndc = lightSpace.xyz / lightSpace.w;
+    if (any(greaterThan(abs(ndc), vec3(1.0)))) {
+        return 1.0;
+    }
+
+    vec4 rect = shadowRects[i];
+    vec2 uv = rect.xy + (ndc.xy * 0.5 + 0.5) * rect.zw;
+    // keep the filter footprint inside this light's tile
+    uv = clamp(uv, rect.xy + 1.5 * shadowTexelSize, rect.xy + rect.zw - 1.5 * shadowTexelSize);
+    float depth = ndc.z * 0.5 + 0.5;
+
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            lit += texture(shadowAtlas, vec3(uv + vec2(x, y) * shadowTexelSize, depth));
+        }
+    }
+    return lit / 9.0;
+}
+#else
+float shadowFactor(int i)
+{
+    return 1.0;
+}
+#endif
 
 void main()
 {
+#if TEXTURED
     vec3 objectColor = texture(ourTexture, TexCoord).rgb;
+#else
+    vec3 objectColor = baseColor;
+#endif
     vec3 norm = normalize(Normal);
 
-    vec3 result = vec3(0.0f, 0.0f, 0.0f);
+    // ambient (independent of cones, so it is summed on the CPU for every light)
+    vec3 result = ambientLight * objectColor;
 
-    for (int i = 0; i < 3; i++) {
-        // ambient
-        vec3 ambient = spotlights[i].ambient * objectColor;
+#if LIGHT_COUNT > 0
+    for (int k = 0; k < LIGHT_COUNT; k++) {
+        int i = lightIndices[k];
         vec3 lightDir = normalize(spotlights[i].position - FragPos);
 
         float theta = dot(lightDir, normalize(-spotlights[i].direction));
@@ -35,15 +127,22 @@ void main()
             float diff = max(dot(norm, lightDir), 0.0);
             vec3 diffuse = spotlights[i].diffuse * diff * objectColor;
 
+#if SHADING_MODEL == SHADING_BLINN_PHONG
+            // specular
+            vec3 halfway = normalize(lightDir + normalize(viewPos - FragPos));
+            diffuse += spotlights[i].diffuse * specularStrength * pow(max(dot(norm, halfway), 0.0), shininess);
+#endif
+
             // attenuation
             float dist = length(spotlights[i].position - FragPos);
             float attenuation = 1.0 / (spotlights[i].attenuation.x + spotlights[i].attenuation.y * dist + spotlights[i].attenuation.z * dist * dist);
 
-            diffuse *= attenuation;
+            diffuse *= attenuation * shadowFactor(i);
             result += diffuse;
         }
-        result += ambient;
     }
+#endif
 
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+    Velocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec2 TexCoord;
+
+void main()
+{
+    // one triangle covering the screen: (0,0), (2,0), (0,2) in texture space
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D logLuminance;   // its smallest mip holds the average of the frame
+uniform float averageLevel;
+uniform sampler2D previous;       // 1x1 adapted luminance of the last frame
+uniform bool historyValid;
+uniform float adaptation;         // fraction of the way to move toward this frame's average
+
+void main()
+{
+    float current = exp(textureLod(logLuminance, vec2(0.5), averageLevel).r);
+    float adapted = historyValid ? mix(texelFetch(previous, ivec2(0), 0).r, current, adaptation) : current;
+    FragColor = vec4(adapted, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 texelSize;           // of source
+uniform bool prefilter;           // first level: keep only what is brighter than the threshold
+uniform float threshold;
+uniform float knee;               // soft transition width around the threshold
+
+vec3 brightPass(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-5);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 1e-5);
+    return color * contribution;
+}
+
+void main()
+{
+    // dual Kawase downsample: the center and four diagonal taps between texels, 16 texels in 5 fetches
+    vec3 sum = texture(source, TexCoord).rgb * 4.0;
+    sum += texture(source, TexCoord + vec2(-texelSize.x, -texelSize.y)).rgb;
+    sum += texture(source, TexCoord + vec2(texelSize.x, -texelSize.y)).rgb;
+    sum += texture(source, TexCoord + vec2(-texelSize.x, texelSize.y)).rgb;
+    sum += texture(source, TexCoord + vec2(texelSize.x, texelSize.y)).rgb;
+    vec3 color = sum * 0.125;
+    if (prefilter) {
+        color = brightPass(color);
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D source;         // next smaller level, added onto the bound level by blending
+uniform vec2 halfTexel;           // half a texel of source
+
+void main()
+{
+    // dual Kawase upsample: four edge taps and four diagonal taps forming a wide tent
+    vec3 sum = texture(source, TexCoord + vec2(-2.0 * halfTexel.x, 0.0)).rgb;
+    sum += texture(source, TexCoord + vec2(2.0 * halfTexel.x, 0.0)).rgb;
+    sum += texture(source, TexCoord + vec2(0.0, -2.0 * halfTexel.y)).rgb;
+    sum += texture(source, TexCoord + vec2(0.0, 2.0 * halfTexel.y)).rgb;
+    sum += texture(source, TexCoord + vec2(-halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    sum += texture(source, TexCoord + vec2(halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    sum += texture(source, TexCoord + vec2(-halfTexel.x, halfTexel.y)).rgb * 2.0;
+    sum += texture(source, TexCoord + vec2(halfTexel.x, halfTexel.y)).rgb * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
+}
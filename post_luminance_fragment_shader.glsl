@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D scene;
+
+void main()
+{
+    // log luminance, so the mip chain average is the geometric mean that exposure needs
+    float luminance = dot(texture(scene, TexCoord).rgb, vec3(0.2126, 0.7152, 0.0722));
+    FragColor = vec4(log(max(luminance, 1e-4)), 0.0, 0.0, 1.0);
+}
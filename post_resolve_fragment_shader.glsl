@@ -0,0 +1,85 @@
+#version 330 core
+
+// Bloom composite, exposure, tone mapping and FXAA in one pass; each stage is compiled in only when
+// its BLOOM, AUTO_EXPOSURE, TONEMAP or FXAA define is 1
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D scene;          // HDR scene color
+uniform vec2 texelSize;           // of scene
+uniform sampler2D bloom;
+uniform float bloomStrength;
+uniform sampler2D adaptedLuminance;
+uniform float exposure;           // fixed exposure, or the key value the average maps to with AUTO_EXPOSURE
+uniform float minExposure;
+uniform float maxExposure;
+
+float frameExposure()
+{
+#if AUTO_EXPOSURE
+    return clamp(exposure / max(texelFetch(adaptedLuminance, ivec2(0), 0).r, 1e-4), minExposure, maxExposure);
+#else
+    return exposure;
+#endif
+}
+
+// ACES filmic curve fitted by Narkowicz
+vec3 toneMap(vec3 color)
+{
+#if TONEMAP
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+#else
+    return clamp(color, 0.0, 1.0);
+#endif
+}
+
+// final display color at uv; FXAA calls this for every tap instead of reading a tone mapped target
+vec3 resolve(vec2 uv, float scale)
+{
+    vec3 color = texture(scene, uv).rgb;
+#if BLOOM
+    color += texture(bloom, uv).rgb * bloomStrength;
+#endif
+    return toneMap(color * scale);
+}
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+const float FXAA_EDGE_THRESHOLD = 1.0 / 8.0;
+const float FXAA_EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+const float FXAA_REDUCE_MUL = 1.0 / 8.0;
+const float FXAA_REDUCE_MIN = 1.0 / 128.0;
+const float FXAA_SPAN_MAX = 8.0;
+
+void main()
+{
+    float scale = frameExposure();
+    vec3 center = resolve(TexCoord, scale);
+#if FXAA
+    // edge detection on the four diagonal neighbours, then a blur along the edge direction
+    float lumaNW = luma(resolve(TexCoord + vec2(-1.0, -1.0) * texelSize, scale));
+    float lumaNE = luma(resolve(TexCoord + vec2(1.0, -1.0) * texelSize, scale));
+    float lumaSW = luma(resolve(TexCoord + vec2(-1.0, 1.0) * texelSize, scale));
+    float lumaSE = luma(resolve(TexCoord + vec2(1.0, 1.0) * texelSize, scale));
+    float lumaM = luma(center);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin >= max(FXAA_EDGE_THRESHOLD_MIN, lumaMax * FXAA_EDGE_THRESHOLD)) {
+        vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+        float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * FXAA_REDUCE_MUL, FXAA_REDUCE_MIN);
+        float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+        dir = clamp(dir * rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texelSize;
+
+        vec3 inner = 0.5 * (resolve(TexCoord + dir * (1.0 / 3.0 - 0.5), scale) + resolve(TexCoord + dir * (2.0 / 3.0 - 0.5), scale));
+        vec3 outer = inner * 0.5 + 0.25 * (resolve(TexCoord - dir * 0.5, scale) + resolve(TexCoord + dir * 0.5, scale));
+        float lumaOuter = luma(outer);
+        // the wide blur crossed another edge: keep the narrow one
+        center = (lumaOuter < lumaMin || lumaOuter > lumaMax) ? inner : outer;
+    }
+#endif
+    FragColor = vec4(center, 1.0);
+}
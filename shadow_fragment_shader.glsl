@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth-only pass: the depth buffer is written by the fixed-function stage
+void main()
+{
+}
\ No newline at end of file
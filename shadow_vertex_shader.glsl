@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 inPosition;
+
+uniform mat4 model;
+uniform mat4 lightMatrix; // projection * view of the spotlight's shadow frustum
+
+void main()
+{
+    gl_Position = lightMatrix * model * vec4(inPosition, 1.0f);
+}
@@ -0,0 +1,119 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;     // jittered render, possibly below output resolution
+uniform sampler2D sceneDepth;
+uniform sampler2D velocity;       // current minus previous texture coordinate, 0 where nothing was drawn
+uniform sampler2D history;        // accumulated result at output resolution
+uniform bool historyValid;
+uniform vec2 jitter;              // this frame's offset of the render in input pixels
+uniform mat4 reprojection;        // previous view projection times inverse current one, for the background
+uniform float blend;              // weight of a well placed new sample
+uniform float clipGamma;          // width of the neighbourhood box in standard deviations
+
+vec3 toYCoCg(vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 fromYCoCg(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Catmull-Rom filtered history in five bilinear fetches, which keeps it sharp under motion
+vec3 sampleHistory(vec2 uv)
+{
+    vec2 size = vec2(textureSize(history, 0));
+    vec2 samplePos = uv * size;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 texPos0 = (texPos1 - 1.0) / size;
+    vec2 texPos3 = (texPos1 + 2.0) / size;
+    vec2 texPos12 = (texPos1 + w2 / w12) / size;
+
+    vec3 result = texture(history, vec2(texPos12.x, texPos0.y)).rgb * w12.x * w0.y;
+    result += texture(history, vec2(texPos0.x, texPos12.y)).rgb * w0.x * w12.y;
+    result += texture(history, texPos12).rgb * w12.x * w12.y;
+    result += texture(history, vec2(texPos3.x, texPos12.y)).rgb * w3.x * w12.y;
+    result += texture(history, vec2(texPos12.x, texPos3.y)).rgb * w12.x * w3.y;
+    float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+    return max(result / weight, vec3(0.0));
+}
+
+// pull the history toward the box center until it lies inside the box
+vec3 clipToBox(vec3 value, vec3 boxMin, vec3 boxMax)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extent = 0.5 * (boxMax - boxMin) + 1e-4;
+    vec3 offset = value - center;
+    vec3 units = abs(offset / extent);
+    float maxUnit = max(units.x, max(units.y, units.z));
+    return maxUnit > 1.0 ? center + offset / maxUnit : value;
+}
+
+void main()
+{
+    ivec2 inputSize = textureSize(sceneColor, 0);
+    vec2 outputSize = vec2(textureSize(history, 0));
+    // where this output pixel's scene point landed in the jittered render
+    vec2 inputPos = TexCoord * vec2(inputSize) + jitter;
+    ivec2 center = clamp(ivec2(floor(inputPos)), ivec2(0), inputSize - 1);
+
+    // neighbourhood statistics for the clamp, and the closest surface for the motion vector
+    vec3 moment1 = vec3(0.0);
+    vec3 moment2 = vec3(0.0);
+    float closestDepth = 1.0;
+    ivec2 closestTexel = center;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 texel = clamp(center + ivec2(x, y), ivec2(0), inputSize - 1);
+            vec3 c = toYCoCg(texelFetch(sceneColor, texel, 0).rgb);
+            moment1 += c;
+            moment2 += c * c;
+            float depth = texelFetch(sceneDepth, texel, 0).r;
+            if (depth < closestDepth) {
+                closestDepth = depth;
+                closestTexel = texel;
+            }
+        }
+    }
+    vec3 current = toYCoCg(texelFetch(sceneColor, center, 0).rgb);
+
+    vec2 motion;
+    if (closestDepth < 1.0) {
+        motion = texelFetch(velocity, closestTexel, 0).xy;
+    }
+    else {
+        // nothing drawn here: only the camera moved it
+        vec4 previous = reprojection * vec4(TexCoord * 2.0 - 1.0, 1.0, 1.0);
+        motion = TexCoord - (previous.xy / previous.w * 0.5 + 0.5);
+    }
+    vec2 previousUV = TexCoord - motion;
+
+    if (!historyValid || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0)))) {
+        FragColor = vec4(texture(sceneColor, inputPos / vec2(inputSize)).rgb, 1.0);
+        return;
+    }
+
+    vec3 mean = moment1 / 9.0;
+    vec3 sigma = sqrt(abs(moment2 / 9.0 - mean * mean));
+    vec3 previous = clipToBox(toYCoCg(sampleHistory(previousUV)), mean - clipGamma * sigma, mean + clipGamma * sigma);
+
+    // a new sample counts less the further its pixel center is from this output pixel (upscaling)
+    vec2 offset = (vec2(center) + 0.5 - inputPos) * (outputSize / vec2(inputSize));
+    float alpha = blend * max(exp(-2.0 * dot(offset, offset)), 0.1);
+
+    // blending in a tone mapped space keeps single bright samples from flickering through
+    float currentWeight = alpha / (1.0 + current.x);
+    float previousWeight = (1.0 - alpha) / (1.0 + previous.x);
+    vec3 result = (current * currentWeight + previous * previousWeight) / (currentWeight + previousWeight);
+    FragColor = vec4(max(fromYCoCg(result), vec3(0.0)), 1.0);
+}
@@ -6,15 +6,23 @@ layout (location = 2) in vec2 inTexCoord;
 out vec3 FragPos; // output fragment position to fragment shader
 out vec3 Normal; // output normal vector to fragment shader
 out vec2 TexCoord; // output texture coordinate vector to fragment shader
+out vec4 CurrentClip; // unjittered clip position this frame and last frame, for motion vectors
+out vec4 PreviousClip;
 
 uniform mat4 model;
+uniform mat3 normalMatrix; // inverse transpose of the upper 3x3 of model
 uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 projection; // may carry the temporal anti-aliasing jitter
+uniform mat4 viewProjection; // without jitter
+uniform mat4 previousViewProjection;
+uniform mat4 previousModel;
 
 void main()
 {
     gl_Position = projection * view * model * vec4(inPosition, 1.0f);
-    FragPos = inPosition;
-    Normal = inNormal;
+    FragPos = vec3(model * vec4(inPosition, 1.0f));
+    Normal = normalMatrix * inNormal;
     TexCoord = inTexCoord;
+    CurrentClip = viewProjection * vec4(FragPos, 1.0f);
+    PreviousClip = previousViewProjection * previousModel * vec4(inPosition, 1.0f);
 }
\ No newline at end of file
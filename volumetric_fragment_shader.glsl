@@ -0,0 +1,180 @@
+#version 330 core
+
+// Injected by VolumetricPass from SpotLight.h; the value below is the fallback
+#ifndef MAX_SPOTLIGHTS
+#define MAX_SPOTLIGHTS 16
+#endif
+
+struct SpotLight {
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 attenuation;
+	vec3 position;
+	vec3 direction;
+	float cutoffAngle;    // The cosine value of cutoff angle
+	float range;          // Distance beyond which the light is negligible
+};
+
+in vec2 TexCoord;
+out vec4 FragColor;       // rgb: light scattered towards the camera, a: distance to the surface behind it
+
+// Written once per frame into a stream buffer (SPOTLIGHT_BLOCK_BINDING, std140 to match SpotLightBlock)
+layout(std140) uniform SpotLights {
+	SpotLight spotlights[MAX_SPOTLIGHTS];
+	int numSpotlights;
+};
+
+uniform sampler2D sceneDepth;
+uniform sampler2D history;        // previous frame of this pass
+uniform bool historyValid;
+uniform float temporalBlend;      // weight of the history
+uniform mat4 inverseViewProjection;
+uniform vec3 cameraPos;
+uniform int stepCount;            // samples per beam crossed by the ray
+uniform int frameIndex;
+uniform float density;            // haze scattering coefficient
+uniform float anisotropy;         // Henyey-Greenstein g, > 0 scatters forward
+
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 lightMatrices[MAX_SPOTLIGHTS];
+uniform vec4 shadowRects[MAX_SPOTLIGHTS];
+uniform bool shadowsEnabled;
+
+vec3 worldPosition(vec2 uv, float depth)
+{
+    vec4 p = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return p.xyz / p.w;
+}
+
+// Single comparison tap; beams average many samples so PCF is not needed here
+float shadowVisibility(int i, vec3 p)
+{
+    if (!shadowsEnabled || shadowRects[i].z <= 0.0) {
+        return 1.0;
+    }
+    vec4 lightSpace = lightMatrices[i] * vec4(p, 1.0);
+    if (lightSpace.w <= 0.0) {
+        return 1.0;
+    }
+    vec3 ndc = lightSpace.xyz / lightSpace.w;
+    if (any(greaterThan(abs(ndc), vec3(1.0)))) {
+        return 1.0;
+    }
+    vec2 uv = shadowRects[i].xy + (ndc.xy * 0.5 + 0.5) * shadowRects[i].zw;
+    return texture(shadowAtlas, vec3(uv, ndc.z * 0.5 + 0.5));
+}
+
+// Part [near, far] of the ray inside the cone of light i, cut at the light's range; empty when near >= far
+vec2 coneInterval(int i, vec3 origin, vec3 dir)
+{
+    vec3 axis = normalize(spotlights[i].direction);
+    float cos2 = spotlights[i].cutoffAngle * spotlights[i].cutoffAngle;
+    vec3 co = origin - spotlights[i].position;
+    float dv = dot(dir, axis);
+    float cv = dot(co, axis);
+
+    // inside the double cone where a t^2 + b t + c >= 0
+    float a = dv * dv - cos2;
+    float b = 2.0 * (dv * cv - cos2 * dot(dir, co));
+    float c = cv * cv - cos2 * dot(co, co);
+    float tNear = -1e30;
+    float tFar = 1e30;
+    float det = b * b - 4.0 * a * c;
+    if (abs(a) < 1e-6) {
+        if (abs(b) < 1e-6) {
+            return vec2(1.0, 0.0);
+        }
+        if (b > 0.0) {
+            tNear = -c / b;
+        }
+        else {
+            tFar = -c / b;
+        }
+    }
+    else if (det >= 0.0) {
+        float root = sqrt(det);
+        float t1 = min((-b - root) / (2.0 * a), (-b + root) / (2.0 * a));
+        float t2 = max((-b - root) / (2.0 * a), (-b + root) / (2.0 * a));
+        if (a < 0.0) {
+            tNear = t1;
+            tFar = t2;
+        }
+        else if (cv + dv * t1 >= 0.0) {
+            // the ray leaves the lit nappe at t1
+            tFar = t1;
+        }
+        else {
+            // the ray enters the lit nappe at t2
+            tNear = t2;
+        }
+    }
+    else if (a < 0.0) {
+        return vec2(1.0, 0.0);
+    }
+
+    // keep the slab in front of the apex and within range
+    if (abs(dv) > 1e-6) {
+        float tApex = -cv / dv;
+        float tRange = (spotlights[i].range - cv) / dv;
+        tNear = max(tNear, min(tApex, tRange));
+        tFar = min(tFar, max(tApex, tRange));
+    }
+    else if (cv < 0.0 || cv > spotlights[i].range) {
+        return vec2(1.0, 0.0);
+    }
+    return vec2(tNear, tFar);
+}
+
+float phase(float cosTheta)
+{
+    float g2 = anisotropy * anisotropy;
+    return (1.0 - g2) / (4.0 * 3.14159265 * pow(1.0 + g2 - 2.0 * anisotropy * cosTheta, 1.5));
+}
+
+// Per-pixel offset in [0, 1) that changes every frame, so the history averages away banding
+float interleavedGradientNoise(vec2 pixel)
+{
+    pixel += 5.588238 * float(frameIndex % 64);
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    vec3 surface = worldPosition(TexCoord, texture(sceneDepth, TexCoord).r);
+    float sceneDist = length(surface - cameraPos);
+    vec3 rayDir = (surface - cameraPos) / sceneDist;
+    float jitter = interleavedGradientNoise(gl_FragCoord.xy);
+
+    vec3 scattered = vec3(0.0);
+    for (int i = 0; i < numSpotlights; i++) {
+        // only march the part of the ray inside the beam
+        vec2 segment = coneInterval(i, cameraPos, rayDir);
+        segment.x = max(segment.x, 0.0);
+        segment.y = min(segment.y, sceneDist);
+        if (segment.x >= segment.y) {
+            continue;
+        }
+
+        float stepLength = (segment.y - segment.x) / float(stepCount);
+        vec3 axis = normalize(spotlights[i].direction);
+        float edge = mix(spotlights[i].cutoffAngle, 1.0, 0.1);
+        float beam = 0.0;
+        for (int s = 0; s < stepCount; s++) {
+            vec3 p = cameraPos + rayDir * (segment.x + (float(s) + jitter) * stepLength);
+            vec3 toPoint = p - spotlights[i].position;
+            float dist = length(toPoint);
+            vec3 lightDir = toPoint / dist;
+            // soft beam edge instead of the hard cutoff used on surfaces
+            float cone = smoothstep(spotlights[i].cutoffAngle, edge, dot(lightDir, axis));
+            float attenuation = 1.0 / (spotlights[i].attenuation.x + spotlights[i].attenuation.y * dist + spotlights[i].attenuation.z * dist * dist);
+            beam += cone * attenuation * shadowVisibility(i, p) * phase(dot(lightDir, -rayDir));
+        }
+        scattered += spotlights[i].diffuse * beam * stepLength;
+    }
+
+    vec3 result = scattered * density;
+    if (historyValid) {
+        result = mix(result, texture(history, TexCoord).rgb, temporalBlend);
+    }
+    FragColor = vec4(result, sceneDist);
+}
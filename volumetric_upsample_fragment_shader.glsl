@@ -0,0 +1,48 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+uniform sampler2D sceneDepth;
+uniform sampler2D volumetric;     // low resolution: rgb in-scattered light, a distance of the sample
+uniform mat4 inverseViewProjection;
+uniform vec3 cameraPos;
+uniform float depthSensitivity;   // how fast weights fall off with relative distance difference
+
+void main()
+{
+    float depth = texture(sceneDepth, TexCoord).r;
+    vec4 surface = inverseViewProjection * vec4(vec3(TexCoord, depth) * 2.0 - 1.0, 1.0);
+    float dist = length(surface.xyz / surface.w - cameraPos);
+
+    // bilateral filter over the four nearest low resolution samples
+    ivec2 lowSize = textureSize(volumetric, 0);
+    vec2 coord = TexCoord * vec2(lowSize) - 0.5;
+    vec2 base = floor(coord);
+    vec2 f = coord - base;
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    vec3 nearest = vec3(0.0);
+    float nearestDiff = 1e30;
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            ivec2 texel = clamp(ivec2(base) + ivec2(x, y), ivec2(0), lowSize - 1);
+            vec4 s = texelFetch(volumetric, texel, 0);
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            float diff = abs(s.a - dist);
+            float weight = bilinear * exp(-depthSensitivity * diff / max(dist, 1e-3));
+            sum += s.rgb * weight;
+            weightSum += weight;
+            if (diff < nearestDiff) {
+                nearestDiff = diff;
+                nearest = s.rgb;
+            }
+        }
+    }
+    // no sample on the same surface: fall back to the closest in depth
+    vec3 beams = weightSum > 1e-4 ? sum / weightSum : nearest;
+
+    FragColor = vec4(texture(sceneColor, TexCoord).rgb + beams, 1.0);
+}